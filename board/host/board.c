@@ -60,27 +60,70 @@ BUILD_ASSERT(ARRAY_SIZE(buttons) == CONFIG_BUTTON_COUNT);
 const struct accel_orientation acc_orient = {
 	/* Lid and base sensor are already aligned. */
 	.rot_align = {
-		{ 1,  0,  0},
-		{ 0,  1,  0},
-		{ 0,  0,  1}
+		{ INT_TO_FP(1), INT_TO_FP(0), INT_TO_FP(0)},
+		{ INT_TO_FP(0), INT_TO_FP(1), INT_TO_FP(0)},
+		{ INT_TO_FP(0), INT_TO_FP(0), INT_TO_FP(1)}
 	},
 
 	/* Hinge aligns with y axis. */
 	.rot_hinge_90 = {
-		{ 0,  0,  1},
-		{ 0,  1,  0},
-		{ -1, 0,  0}
+		{ INT_TO_FP(0), INT_TO_FP(0), INT_TO_FP(1)},
+		{ INT_TO_FP(0), INT_TO_FP(1), INT_TO_FP(0)},
+		{ INT_TO_FP(-1), INT_TO_FP(0), INT_TO_FP(0)}
 	},
 	.rot_hinge_180 = {
-		{-1,  0,  0},
-		{ 0,  1,  0},
-		{ 0,  0, -1}
+		{ INT_TO_FP(-1), INT_TO_FP(0), INT_TO_FP(0)},
+		{ INT_TO_FP(0), INT_TO_FP(1), INT_TO_FP(0)},
+		{ INT_TO_FP(0), INT_TO_FP(0), INT_TO_FP(-1)}
 	},
 	.rot_standard_ref = {
-		{ 1,  0,  0},
-		{ 0,  1,  0},
-		{ 0,  0,  1}
+		{ INT_TO_FP(1), INT_TO_FP(0), INT_TO_FP(0)},
+		{ INT_TO_FP(0), INT_TO_FP(1), INT_TO_FP(0)},
+		{ INT_TO_FP(0), INT_TO_FP(0), INT_TO_FP(1)}
 	},
 	.hinge_axis = {0, 1, 0},
 };
 
+#ifdef HAS_TASK_MOTIONSENSE
+/* Each test that runs the motion sense task provides the driver. */
+extern const struct accelgyro_drv test_motion_sense;
+static struct mutex g_base_mutex;
+static struct mutex g_lid_mutex;
+
+struct motion_sensor_t motion_sensors[] = {
+	{.name = "Base",
+	 .chip = MOTIONSENSE_CHIP_KXCJ9,
+	 .type = MOTIONSENSE_TYPE_ACCEL,
+	 .location = MOTIONSENSE_LOC_BASE,
+	 .drv = &test_motion_sense,
+	 .mutex = &g_base_mutex,
+	 .default_range = 2,
+	 .default_odr = 100000,
+	},
+	{.name = "Lid",
+	 .chip = MOTIONSENSE_CHIP_KXCJ9,
+	 .type = MOTIONSENSE_TYPE_ACCEL,
+	 .location = MOTIONSENSE_LOC_LID,
+	 .drv = &test_motion_sense,
+	 .mutex = &g_lid_mutex,
+	 .rot = &acc_orient.rot_align,
+	 .default_range = 2,
+	 .default_odr = 100000,
+#ifdef CONFIG_ACCEL_HW_FIFO
+	 .hw_fifo_watermark = 4,
+	 .int_signal = GPIO_ACCEL_INT_LID,
+#endif
+	},
+	{.name = "Base Gyro",
+	 .chip = MOTIONSENSE_CHIP_LSM6DS0,
+	 .type = MOTIONSENSE_TYPE_GYRO,
+	 .location = MOTIONSENSE_LOC_BASE,
+	 .drv = &test_motion_sense,
+	 .mutex = &g_base_mutex,
+	 .default_range = 2000,
+	 .default_odr = 119000,
+	},
+};
+const unsigned int motion_sensor_count = ARRAY_SIZE(motion_sensors);
+BUILD_ASSERT(ARRAY_SIZE(motion_sensors) == MOTION_SENSOR_COUNT);
+#endif
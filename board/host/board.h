@@ -39,13 +39,14 @@ enum adc_channel {
 	ADC_CH_COUNT
 };
 
-/* Identifiers for each accelerometer used. */
-enum accel_id {
+/* Motion sensors, in the order of motion_sensors[]. */
+enum sensor_id {
 	ACCEL_BASE,
 	ACCEL_LID,
+	GYRO_BASE,
 
-	/* Number of accelerometers. */
-	ACCEL_COUNT
+	/* Number of motion sensors. */
+	MOTION_SENSOR_COUNT
 };
 
 #endif /* __BOARD_H */
@@ -10,4 +10,6 @@ CORE:=host
 
 chip-y=system.o gpio.o uart.o persistence.o flash.o lpc.o reboot.o i2c.o \
 	clock.o
+chip-y+=i2c_emul_battery.o i2c_emul_bq24715.o i2c_emul_kxcj9.o \
+	i2c_emul_tmp006.o
 chip-$(HAS_TASK_KEYSCAN)+=keyboard_raw.o
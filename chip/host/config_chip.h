@@ -38,6 +38,9 @@ extern char __host_flash[CONFIG_FLASH_PHYSICAL_SIZE];
 #define CONFIG_FW_PSTATE_OFF    CONFIG_FW_RO_SIZE
 #define CONFIG_FW_PSTATE_SIZE   CONFIG_FLASH_BANK_SIZE
 
+/* Number of emulated I2C ports */
+#define I2C_PORT_COUNT 2
+
 /* Maximum number of deferrable functions */
 #define DEFERRABLE_MAX_COUNT 8
 
@@ -7,8 +7,12 @@
 
 #include "hooks.h"
 #include "i2c.h"
+#include "i2c_emul.h"
 #include "link_defs.h"
+#include "task.h"
 #include "test_util.h"
+#include "timer.h"
+#include "util.h"
 
 #define MAX_DETACHED_DEV_COUNT 3
 
@@ -20,6 +24,8 @@ struct i2c_dev {
 
 static struct i2c_dev detached_devs[MAX_DETACHED_DEV_COUNT];
 
+static struct mutex port_mutex[I2C_PORT_COUNT];
+
 static void detach_init(void)
 {
 	int i;
@@ -75,13 +81,151 @@ static int test_check_detached(int port, int slave_addr)
 	return 0;
 }
 
+void i2c_lock(int port, int lock)
+{
+	if (lock) {
+		uint32_t begin = i2c_stats_lock_begin();
+
+		mutex_lock(port_mutex + port);
+		i2c_stats_locked(port, begin);
+	} else {
+		i2c_stats_unlocking(port);
+		mutex_unlock(port_mutex + port);
+	}
+}
+
+/*****************************************************************************/
+/* Emulated devices */
+
+static struct i2c_emul *emul_list;
+
+void i2c_emul_attach(struct i2c_emul *emul)
+{
+	emul->offset = 0;
+	emul->next = emul_list;
+	emul_list = emul;
+}
+
+void i2c_emul_detach(struct i2c_emul *emul)
+{
+	struct i2c_emul **p;
+
+	for (p = &emul_list; *p; p = &(*p)->next) {
+		if (*p == emul) {
+			*p = emul->next;
+			return;
+		}
+	}
+}
+
+static struct i2c_emul *find_emul(int port, int slave_addr)
+{
+	struct i2c_emul *emul;
+
+	for (emul = emul_list; emul; emul = emul->next)
+		if (emul->port == port &&
+		    emul->slave_addr == (slave_addr & 0xff))
+			return emul;
+	return NULL;
+}
+
+/*
+ * Account for a transfer of <bytes> bytes, not counting the address, and
+ * hold the bus for as long as it would take.
+ */
+static int emul_finish(struct i2c_emul *emul, int bytes, int rv)
+{
+	int us = emul->latency_us + bytes * emul->byte_us;
+
+	if (us)
+		usleep(us);
+	i2c_stats_xfer(emul->port, bytes, rv);
+	return rv;
+}
+
+/* Register access through i2c_read8() and friends */
+static int emul_reg(struct i2c_emul *emul, int offset, int *data, int bits,
+		    int write)
+{
+	int rv;
+
+	i2c_lock(emul->port, 1);
+	if (write)
+		rv = emul->drv->write(emul, offset, *data, bits);
+	else
+		rv = emul->drv->read(emul, offset, data, bits);
+	rv = emul_finish(emul, 1 + bits / 8, rv);
+	i2c_lock(emul->port, 0);
+
+	return rv;
+}
+
+static int emul_read_string(struct i2c_emul *emul, int offset, uint8_t *data,
+			    int len)
+{
+	uint8_t block[32];
+	int size = sizeof(block);
+	int rv;
+
+	/* There must be room for at least the terminator */
+	if (len <= 0)
+		return EC_ERROR_INVAL;
+
+	if (!emul->drv->read_block)
+		return EC_ERROR_UNKNOWN;
+
+	i2c_lock(emul->port, 1);
+	rv = emul->drv->read_block(emul, offset, block, &size);
+	rv = emul_finish(emul, 2 + size, rv);
+	i2c_lock(emul->port, 0);
+
+	if (rv)
+		return rv;
+
+	if (size > len - 1)
+		size = len - 1;
+	memcpy(data, block, size);
+	data[size] = 0;
+
+	return EC_SUCCESS;
+}
+
+/*
+ * Transfers reach emulated devices; anything else is not acknowledged. Tests
+ * which need other behavior mock this.
+ */
+test_mockable int i2c_xfer(int port, int slave_addr, const uint8_t *out,
+			   int out_size, uint8_t *in, int in_size, int flags)
+{
+	struct i2c_emul *emul = find_emul(port, slave_addr);
+	int i, data, rv = EC_SUCCESS;
+
+	if (!emul || test_check_detached(port, slave_addr))
+		return EC_ERROR_UNKNOWN;
+
+	if (out_size)
+		emul->offset = out[0];
+	for (i = 1; i < out_size && rv == EC_SUCCESS; i++)
+		rv = emul->drv->write(emul, emul->offset++, out[i], 8);
+	for (i = 0; i < in_size && rv == EC_SUCCESS; i++) {
+		rv = emul->drv->read(emul, emul->offset++, &data, 8);
+		in[i] = data;
+	}
+
+	return emul_finish(emul, out_size + in_size, rv);
+}
+
 int i2c_read16(int port, int slave_addr, int offset, int *data)
 {
 	const struct test_i2c_read_dev *p;
+	struct i2c_emul *emul;
 	int rv;
 
 	if (test_check_detached(port, slave_addr))
 		return EC_ERROR_UNKNOWN;
+	emul = find_emul(port, slave_addr);
+	if (emul)
+		return emul_reg(emul, offset, data, 16, 0);
 	for (p = __test_i2c_read16; p < __test_i2c_read16_end; ++p) {
 		rv = p->routine(port, slave_addr, offset, data);
 		if (rv != EC_ERROR_INVAL)
@@ -93,10 +237,14 @@ int i2c_read16(int port, int slave_addr, int offset, int *data)
 int i2c_write16(int port, int slave_addr, int offset, int data)
 {
 	const struct test_i2c_write_dev *p;
+	struct i2c_emul *emul;
 	int rv;
 
 	if (test_check_detached(port, slave_addr))
 		return EC_ERROR_UNKNOWN;
+	emul = find_emul(port, slave_addr);
+	if (emul)
+		return emul_reg(emul, offset, &data, 16, 1);
 	for (p = __test_i2c_write16; p < __test_i2c_write16_end; ++p) {
 		rv = p->routine(port, slave_addr, offset, data);
 		if (rv != EC_ERROR_INVAL)
@@ -108,10 +256,14 @@ int i2c_write16(int port, int slave_addr, int offset, int data)
 int i2c_read8(int port, int slave_addr, int offset, int *data)
 {
 	const struct test_i2c_read_dev *p;
+	struct i2c_emul *emul;
 	int rv;
 
 	if (test_check_detached(port, slave_addr))
 		return EC_ERROR_UNKNOWN;
+	emul = find_emul(port, slave_addr);
+	if (emul)
+		return emul_reg(emul, offset, data, 8, 0);
 	for (p = __test_i2c_read8; p < __test_i2c_read8_end; ++p) {
 		rv = p->routine(port, slave_addr, offset, data);
 		if (rv != EC_ERROR_INVAL)
@@ -123,10 +275,14 @@ int i2c_read8(int port, int slave_addr, int offset, int *data)
 int i2c_write8(int port, int slave_addr, int offset, int data)
 {
 	const struct test_i2c_write_dev *p;
+	struct i2c_emul *emul;
 	int rv;
 
 	if (test_check_detached(port, slave_addr))
 		return EC_ERROR_UNKNOWN;
+	emul = find_emul(port, slave_addr);
+	if (emul)
+		return emul_reg(emul, offset, &data, 8, 1);
 	for (p = __test_i2c_write8; p < __test_i2c_write8_end; ++p) {
 		rv = p->routine(port, slave_addr, offset, data);
 		if (rv != EC_ERROR_INVAL)
@@ -139,10 +295,14 @@ int i2c_read_string(int port, int slave_addr, int offset, uint8_t *data,
 			int len)
 {
 	const struct test_i2c_read_string_dev *p;
+	struct i2c_emul *emul;
 	int rv;
 
 	if (test_check_detached(port, slave_addr))
 		return EC_ERROR_UNKNOWN;
+	emul = find_emul(port, slave_addr);
+	if (emul)
+		return emul_read_string(emul, offset, data, len);
 	for (p = __test_i2c_read_string; p < __test_i2c_read_string_end; ++p) {
 		rv = p->routine(port, slave_addr, offset, data, len);
 		if (rv != EC_ERROR_INVAL)
@@ -0,0 +1,117 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Emulated I2C devices for the host chip.
+ */
+
+#ifndef __CROS_EC_HOST_I2C_EMUL_H
+#define __CROS_EC_HOST_I2C_EMUL_H
+
+#include "battery_smart.h"
+#include "common.h"
+
+struct i2c_emul;
+
+/* Register-level model of a device */
+struct i2c_emul_drv {
+	/*
+	 * Read or write one register. <bits> is 8 or 16. Return EC_SUCCESS,
+	 * or an error to NAK the transfer.
+	 */
+	int (*read)(struct i2c_emul *emul, int offset, int *data, int bits);
+	int (*write)(struct i2c_emul *emul, int offset, int data, int bits);
+
+	/*
+	 * SMBus block read, for i2c_read_string(). <len> is the buffer size
+	 * on entry and the block length on return. Optional.
+	 */
+	int (*read_block)(struct i2c_emul *emul, int offset, uint8_t *data,
+			  int *len);
+};
+
+/*
+ * One emulated device on the bus. Models embed this as their first member
+ * and fill it in from their init function; tests may then adjust the
+ * timing before attaching it.
+ *
+ * i2c_read8/16, i2c_write8/16 and i2c_read_string reach the device's
+ * registers directly. i2c_xfer() treats the first byte written as a
+ * register offset which auto-increments across the bytes that follow, as
+ * most 8-bit register devices do.
+ */
+struct i2c_emul {
+	int port;
+	int slave_addr;		/* 8-bit address, without flags */
+	const struct i2c_emul_drv *drv;
+
+	/* Time each transfer holds the bus, plus time per byte */
+	int latency_us;
+	int byte_us;
+
+	/* Private to the bus */
+	int offset;
+	struct i2c_emul *next;
+};
+
+/* Put a device on the bus. It takes priority over DECLARE_TEST_I2C_* mocks */
+void i2c_emul_attach(struct i2c_emul *emul);
+
+/* Take a device off the bus */
+void i2c_emul_detach(struct i2c_emul *emul);
+
+/*****************************************************************************/
+/* Device models */
+
+/* Smart battery, as read by driver/battery/smart.c */
+struct i2c_emul_battery {
+	struct i2c_emul emul;
+	uint16_t regs[SB_MANUFACTURER_DATA + 1];
+	const char *manufacturer;
+	const char *device_name;
+	const char *chemistry;
+};
+
+/* Initialize as a half-charged 2S battery at rest */
+void i2c_emul_battery_init(struct i2c_emul_battery *bat, int port,
+			   int slave_addr);
+
+/* TI TMP006 infrared thermopile sensor */
+struct i2c_emul_tmp006 {
+	struct i2c_emul emul;
+	int config;
+	int vobj;		/* Sensor voltage register; 156.25 nV/LSB */
+	int tamb;		/* Die temperature register; 1/128 C/LSB */
+};
+
+void i2c_emul_tmp006_init(struct i2c_emul_tmp006 *t, int port,
+			  int slave_addr);
+
+/* Set the die temperature in 1/100 degree C and the sensor voltage in nV */
+void i2c_emul_tmp006_set(struct i2c_emul_tmp006 *t, int die_centi_c,
+			 int vobj_nv);
+
+/* TI bq24715 charger */
+struct i2c_emul_bq24715 {
+	struct i2c_emul emul;
+	int option;
+	int current;
+	int voltage;
+	int min_sys_voltage;
+	int input_current;
+};
+
+void i2c_emul_bq24715_init(struct i2c_emul_bq24715 *chg, int port,
+			   int slave_addr);
+
+/* Kionix KXCJ9 accelerometer */
+struct i2c_emul_kxcj9 {
+	struct i2c_emul emul;
+	uint8_t regs[0x80];
+	int accel[3];		/* Acceleration; 1024 counts per g */
+};
+
+void i2c_emul_kxcj9_init(struct i2c_emul_kxcj9 *acc, int port,
+			 int slave_addr);
+
+#endif  /* __CROS_EC_HOST_I2C_EMUL_H */
@@ -0,0 +1,120 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Emulated smart battery.
+ */
+
+#include "battery_smart.h"
+#include "common.h"
+#include "i2c_emul.h"
+#include "util.h"
+
+/* Registers the host may write; the rest are the gauge's measurements */
+static int is_writable(int offset)
+{
+	switch (offset) {
+	case SB_MANUFACTURER_ACCESS:
+	case SB_REMAINING_CAPACITY_ALARM:
+	case SB_REMAINING_TIME_ALARM:
+	case SB_BATTERY_MODE:
+	case SB_AT_RATE:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static int battery_read(struct i2c_emul *emul, int offset, int *data,
+			int bits)
+{
+	struct i2c_emul_battery *bat = (struct i2c_emul_battery *)emul;
+
+	if (bits != 16 || offset >= ARRAY_SIZE(bat->regs))
+		return EC_ERROR_UNKNOWN;
+
+	*data = bat->regs[offset];
+	return EC_SUCCESS;
+}
+
+static int battery_write(struct i2c_emul *emul, int offset, int data,
+			 int bits)
+{
+	struct i2c_emul_battery *bat = (struct i2c_emul_battery *)emul;
+
+	if (bits != 16 || !is_writable(offset))
+		return EC_ERROR_UNKNOWN;
+
+	bat->regs[offset] = data;
+	return EC_SUCCESS;
+}
+
+static int battery_read_block(struct i2c_emul *emul, int offset,
+			      uint8_t *data, int *len)
+{
+	struct i2c_emul_battery *bat = (struct i2c_emul_battery *)emul;
+	const char *str;
+	int size;
+
+	switch (offset) {
+	case SB_MANUFACTURER_NAME:
+		str = bat->manufacturer;
+		break;
+	case SB_DEVICE_NAME:
+		str = bat->device_name;
+		break;
+	case SB_DEVICE_CHEMISTRY:
+		str = bat->chemistry;
+		break;
+	default:
+		return EC_ERROR_UNKNOWN;
+	}
+
+	size = MIN(strlen(str), *len);
+	memcpy(data, str, size);
+	*len = size;
+	return EC_SUCCESS;
+}
+
+static const struct i2c_emul_drv emul_drv = {
+	.read = battery_read,
+	.write = battery_write,
+	.read_block = battery_read_block,
+};
+
+void i2c_emul_battery_init(struct i2c_emul_battery *bat, int port,
+			   int slave_addr)
+{
+	memset(bat, 0, sizeof(*bat));
+	bat->emul.port = port;
+	bat->emul.slave_addr = slave_addr;
+	bat->emul.drv = &emul_drv;
+
+	bat->manufacturer = "EMUL";
+	bat->device_name = "EMUL-2S";
+	bat->chemistry = "LION";
+
+	bat->regs[SB_BATTERY_MODE] = MODE_INTERNAL_CHARGE_CONTROLLER;
+	bat->regs[SB_AT_RATE_TIME_TO_FULL] = 0xffff;
+	bat->regs[SB_AT_RATE_TIME_TO_EMPTY] = 0xffff;
+	bat->regs[SB_AT_RATE_OK] = 1;
+	bat->regs[SB_TEMPERATURE] = 2982;	/* 25 C, in 0.1 K */
+	bat->regs[SB_VOLTAGE] = 7600;
+	bat->regs[SB_MAX_ERROR] = 1;
+	bat->regs[SB_RELATIVE_STATE_OF_CHARGE] = 50;
+	bat->regs[SB_ABSOLUTE_STATE_OF_CHARGE] = 48;
+	bat->regs[SB_REMAINING_CAPACITY] = 3000;
+	bat->regs[SB_FULL_CHARGE_CAPACITY] = 6000;
+	bat->regs[SB_RUN_TIME_TO_EMPTY] = 0xffff;
+	bat->regs[SB_AVERAGE_TIME_TO_EMPTY] = 0xffff;
+	bat->regs[SB_AVERAGE_TIME_TO_FULL] = 0xffff;
+	bat->regs[SB_CHARGING_CURRENT] = 3000;
+	bat->regs[SB_CHARGING_VOLTAGE] = 8400;
+	bat->regs[SB_BATTERY_STATUS] = STATUS_INITIALIZED;
+	bat->regs[SB_CYCLE_COUNT] = 10;
+	bat->regs[SB_DESIGN_CAPACITY] = 6200;
+	bat->regs[SB_DESIGN_VOLTAGE] = 7400;
+	bat->regs[SB_SPECIFICATION_INFO] = 0x0031;	/* SBS 1.1 with PEC */
+	bat->regs[SB_MANUFACTURER_DATE] = (34 << 9) | (1 << 5) | 1;
+	bat->regs[SB_SERIAL_NUMBER] = 0x1234;
+}
@@ -0,0 +1,104 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Emulated TI bq24715 charger.
+ */
+
+#include "bq24715.h"
+#include "common.h"
+#include "i2c_emul.h"
+#include "util.h"
+
+/* Bits of each DAC register which are implemented */
+#define CURRENT_MASK		0x1fc0
+#define VOLTAGE_MASK		0x3ff0
+#define MIN_SYS_VOLTAGE_MASK	0x3f00
+
+static int *find_reg(struct i2c_emul_bq24715 *chg, int offset, int *mask)
+{
+	switch (offset) {
+	case BQ24715_CHARGE_OPTION:
+		*mask = 0xffff;
+		return &chg->option;
+	case BQ24715_CHARGE_CURRENT:
+		*mask = CURRENT_MASK;
+		return &chg->current;
+	case BQ24715_MAX_CHARGE_VOLTAGE:
+		*mask = VOLTAGE_MASK;
+		return &chg->voltage;
+	case BQ24715_MIN_SYSTEM_VOLTAGE:
+		*mask = MIN_SYS_VOLTAGE_MASK;
+		return &chg->min_sys_voltage;
+	case BQ24715_INPUT_CURRENT:
+		*mask = CURRENT_MASK;
+		return &chg->input_current;
+	default:
+		return NULL;
+	}
+}
+
+static int bq24715_read(struct i2c_emul *emul, int offset, int *data,
+			int bits)
+{
+	struct i2c_emul_bq24715 *chg = (struct i2c_emul_bq24715 *)emul;
+	int mask;
+	int *reg;
+
+	if (bits != 16)
+		return EC_ERROR_UNKNOWN;
+
+	if (offset == BQ24715_MANUFACTURER_ID) {
+		*data = 0x0040;
+		return EC_SUCCESS;
+	}
+	if (offset == BQ24715_DEVICE_ID) {
+		*data = 0x0010;
+		return EC_SUCCESS;
+	}
+
+	reg = find_reg(chg, offset, &mask);
+	if (!reg)
+		return EC_ERROR_UNKNOWN;
+
+	*data = *reg;
+	return EC_SUCCESS;
+}
+
+static int bq24715_write(struct i2c_emul *emul, int offset, int data,
+			 int bits)
+{
+	struct i2c_emul_bq24715 *chg = (struct i2c_emul_bq24715 *)emul;
+	int mask;
+	int *reg;
+
+	if (bits != 16)
+		return EC_ERROR_UNKNOWN;
+
+	reg = find_reg(chg, offset, &mask);
+	if (!reg)
+		return EC_ERROR_UNKNOWN;
+
+	*reg = data & mask;
+	return EC_SUCCESS;
+}
+
+static const struct i2c_emul_drv emul_drv = {
+	.read = bq24715_read,
+	.write = bq24715_write,
+};
+
+void i2c_emul_bq24715_init(struct i2c_emul_bq24715 *chg, int port,
+			   int slave_addr)
+{
+	memset(chg, 0, sizeof(*chg));
+	chg->emul.port = port;
+	chg->emul.slave_addr = slave_addr;
+	chg->emul.drv = &emul_drv;
+
+	/* Power-on defaults: charging inhibited, 175 s watchdog */
+	chg->option = OPT_WATCHDOG_175SEC | OPT_SWITCH_FREQ_800KHZ |
+		      OPT_IDPM_ENABLE | OPT_CHARGE_DISABLE;
+	chg->min_sys_voltage = 0x1800;
+	chg->input_current = 0x1000;
+}
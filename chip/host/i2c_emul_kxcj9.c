@@ -0,0 +1,114 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Emulated Kionix KXCJ9 accelerometer.
+ */
+
+#include "common.h"
+#include "driver/accel_kxcj9.h"
+#include "i2c_emul.h"
+#include "util.h"
+
+static void kxcj9_reset(struct i2c_emul_kxcj9 *acc)
+{
+	memset(acc->regs, 0, sizeof(acc->regs));
+	acc->regs[KXCJ9_DCST_RESP] = 0x55;
+	acc->regs[KXCJ9_WHOAMI] = 0x0a;
+	acc->regs[KXCJ9_INT_CTRL1] = KXCJ9_INT_CTRL1_IEA;
+	acc->regs[KXCJ9_DATA_CTRL] = KXCJ9_OSA_50_00HZ;
+	acc->regs[KXCJ9_WAKEUP_THRESHOLD] = 0x08;
+}
+
+/* Latch a new sample into the output registers */
+static void kxcj9_sample(struct i2c_emul_kxcj9 *acc)
+{
+	/* 1024 counts per g at +/-2g, halving for each range step */
+	int shift = (acc->regs[KXCJ9_CTRL1] & KXCJ9_GSEL_ALL) >> 3;
+	int i, v;
+
+	if (shift > 2)
+		shift = 2;
+
+	for (i = 0; i < 3; i++) {
+		v = acc->accel[i] >> shift;
+		v = MAX(MIN(v, 2047), -2048);
+		/* 12-bit result, left-justified in two registers */
+		acc->regs[KXCJ9_XOUT_L + 2 * i] = (v << 4) & 0xf0;
+		acc->regs[KXCJ9_XOUT_H + 2 * i] = (v >> 4) & 0xff;
+	}
+}
+
+static int kxcj9_read(struct i2c_emul *emul, int offset, int *data, int bits)
+{
+	struct i2c_emul_kxcj9 *acc = (struct i2c_emul_kxcj9 *)emul;
+
+	if (bits != 8 || offset >= ARRAY_SIZE(acc->regs))
+		return EC_ERROR_UNKNOWN;
+
+	/* Output registers only update while operating */
+	if (offset == KXCJ9_XOUT_L &&
+	    (acc->regs[KXCJ9_CTRL1] & KXCJ9_CTRL1_PC1))
+		kxcj9_sample(acc);
+
+	*data = acc->regs[offset];
+
+	/* Reading INT_REL releases the latched interrupt */
+	if (offset == KXCJ9_INT_REL) {
+		acc->regs[KXCJ9_INT_SRC1] = 0;
+		acc->regs[KXCJ9_INT_SRC2] = 0;
+		acc->regs[KXCJ9_STATUS] &= ~KXCJ9_STATUS_INT;
+	}
+
+	return EC_SUCCESS;
+}
+
+static int kxcj9_write(struct i2c_emul *emul, int offset, int data, int bits)
+{
+	struct i2c_emul_kxcj9 *acc = (struct i2c_emul_kxcj9 *)emul;
+
+	if (bits != 8 || offset >= ARRAY_SIZE(acc->regs))
+		return EC_ERROR_UNKNOWN;
+
+	switch (offset) {
+	case KXCJ9_CTRL1:
+		acc->regs[offset] = data;
+		break;
+	case KXCJ9_CTRL2:
+		/* Software reset completes immediately */
+		if (data & KXCJ9_CTRL2_SRST)
+			kxcj9_reset(acc);
+		else
+			acc->regs[offset] = data & ~KXCJ9_CTRL2_DCST;
+		break;
+	case KXCJ9_INT_CTRL1:
+	case KXCJ9_INT_CTRL2:
+	case KXCJ9_DATA_CTRL:
+	case KXCJ9_WAKEUP_TIMER:
+	case KXCJ9_WAKEUP_THRESHOLD:
+		/* These only take effect from standby */
+		if (!(acc->regs[KXCJ9_CTRL1] & KXCJ9_CTRL1_PC1))
+			acc->regs[offset] = data;
+		break;
+	default:
+		/* Read-only registers ignore writes */
+		break;
+	}
+
+	return EC_SUCCESS;
+}
+
+static const struct i2c_emul_drv emul_drv = {
+	.read = kxcj9_read,
+	.write = kxcj9_write,
+};
+
+void i2c_emul_kxcj9_init(struct i2c_emul_kxcj9 *acc, int port,
+			 int slave_addr)
+{
+	memset(acc, 0, sizeof(*acc));
+	acc->emul.port = port;
+	acc->emul.slave_addr = slave_addr;
+	acc->emul.drv = &emul_drv;
+	kxcj9_reset(acc);
+}
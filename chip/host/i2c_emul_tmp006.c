@@ -0,0 +1,92 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Emulated TMP006 infrared thermopile sensor.
+ */
+
+#include "common.h"
+#include "i2c_emul.h"
+#include "util.h"
+
+#define TMP006_REG_VOBJ		0x00
+#define TMP006_REG_TAMB		0x01
+#define TMP006_REG_CONFIG	0x02
+#define TMP006_REG_MANUF_ID	0xfe
+#define TMP006_REG_DEVICE_ID	0xff
+
+#define TMP006_CONFIG_RESET	(1 << 15)
+#define TMP006_CONFIG_MOD	(7 << 12)
+#define TMP006_CONFIG_DRDY	(1 << 7)
+#define TMP006_CONFIG_DEFAULT	0x7400
+
+static int tmp006_read(struct i2c_emul *emul, int offset, int *data, int bits)
+{
+	struct i2c_emul_tmp006 *t = (struct i2c_emul_tmp006 *)emul;
+
+	if (bits != 16)
+		return EC_ERROR_UNKNOWN;
+
+	switch (offset) {
+	case TMP006_REG_VOBJ:
+		*data = t->vobj & 0xffff;
+		break;
+	case TMP006_REG_TAMB:
+		*data = t->tamb & 0xfffc;
+		break;
+	case TMP006_REG_CONFIG:
+		/* Conversions are always complete while not powered down */
+		*data = t->config;
+		if (t->config & TMP006_CONFIG_MOD)
+			*data |= TMP006_CONFIG_DRDY;
+		break;
+	case TMP006_REG_MANUF_ID:
+		*data = 0x5449;
+		break;
+	case TMP006_REG_DEVICE_ID:
+		*data = 0x0067;
+		break;
+	default:
+		return EC_ERROR_UNKNOWN;
+	}
+
+	return EC_SUCCESS;
+}
+
+static int tmp006_write(struct i2c_emul *emul, int offset, int data, int bits)
+{
+	struct i2c_emul_tmp006 *t = (struct i2c_emul_tmp006 *)emul;
+
+	if (bits != 16 || offset != TMP006_REG_CONFIG)
+		return EC_ERROR_UNKNOWN;
+
+	if (data & TMP006_CONFIG_RESET)
+		t->config = TMP006_CONFIG_DEFAULT;
+	else
+		t->config = data & ~TMP006_CONFIG_DRDY;
+	return EC_SUCCESS;
+}
+
+static const struct i2c_emul_drv emul_drv = {
+	.read = tmp006_read,
+	.write = tmp006_write,
+};
+
+void i2c_emul_tmp006_init(struct i2c_emul_tmp006 *t, int port,
+			  int slave_addr)
+{
+	memset(t, 0, sizeof(*t));
+	t->emul.port = port;
+	t->emul.slave_addr = slave_addr;
+	t->emul.drv = &emul_drv;
+	t->config = TMP006_CONFIG_DEFAULT;
+	i2c_emul_tmp006_set(t, 2500, 0);
+}
+
+void i2c_emul_tmp006_set(struct i2c_emul_tmp006 *t, int die_centi_c,
+			 int vobj_nv)
+{
+	/* 1/32 C per LSB in bits 15:2, and 156.25 nV per LSB */
+	t->tamb = (die_centi_c * 32 / 100) << 2;
+	t->vobj = vobj_nv * 100 / 15625;
+}
@@ -239,6 +239,7 @@ int i2c_xfer(int port, int slave_addr, const uint8_t *out, int out_size,
 		usleep(I2C_IDLE_US);
 	}
 
+	i2c_stats_xfer(port, out_size + in_size, pd->err);
 	return pd->err;
 }
 
@@ -170,7 +170,10 @@ static int wait_byte_done(int port)
 	 */
 	task_set_event(task_get_current(), event, 0);
 
-	return sts & STS_LRB;
+	/* The slave didn't acknowledge */
+	if (sts & STS_LRB)
+		return EC_ERROR_UNKNOWN;
+	return EC_SUCCESS;
 }
 
 static inline void fill_in_buf(uint8_t *in, int id, uint8_t val)
@@ -186,7 +189,7 @@ static inline void fill_in_buf(uint8_t *in, int id, uint8_t val)
 int i2c_xfer(int port, int slave_addr, const uint8_t *out, int out_size,
 	     uint8_t *in, int in_size, int flags)
 {
-	int i;
+	int i, rv;
 	int started = (flags & I2C_XFER_START) ? 0 : 1;
 	uint8_t reg_sts;
 
@@ -230,11 +233,13 @@ int i2c_xfer(int port, int slave_addr, const uint8_t *out, int out_size,
 			started = 1;
 
 		for (i = 0; i < out_size; ++i) {
-			if (wait_byte_done(port))
+			rv = wait_byte_done(port);
+			if (rv)
 				goto err_i2c_xfer;
 			MEC1322_I2C_DATA(port) = out[i];
 		}
-		if (wait_byte_done(port))
+		rv = wait_byte_done(port);
+		if (rv)
 			goto err_i2c_xfer;
 
 		/*
@@ -267,11 +272,13 @@ int i2c_xfer(int port, int slave_addr, const uint8_t *out, int out_size,
 		in_size++;
 
 		for (i = 0; i < in_size - 2; ++i) {
-			if (wait_byte_done(port))
+			rv = wait_byte_done(port);
+			if (rv)
 				goto err_i2c_xfer;
 			fill_in_buf(in, i, MEC1322_I2C_DATA(port));
 		}
-		if (wait_byte_done(port))
+		rv = wait_byte_done(port);
+		if (rv)
 			goto err_i2c_xfer;
 
 		/*
@@ -280,7 +287,8 @@ int i2c_xfer(int port, int slave_addr, const uint8_t *out, int out_size,
 		 */
 		MEC1322_I2C_CTRL(port) = CTRL_ESO | CTRL_ENI;
 		fill_in_buf(in, in_size - 2, MEC1322_I2C_DATA(port));
-		if (wait_byte_done(port))
+		rv = wait_byte_done(port);
+		if (rv)
 			goto err_i2c_xfer;
 
 		/* Send STOP if stop flag is set */
@@ -293,14 +301,18 @@ int i2c_xfer(int port, int slave_addr, const uint8_t *out, int out_size,
 	}
 
 	/* Check for error conditions */
-	if (MEC1322_I2C_STATUS(port) & (STS_LAB | STS_BER))
+	if (MEC1322_I2C_STATUS(port) & (STS_LAB | STS_BER)) {
+		i2c_stats_xfer(port, out_size + in_size, EC_ERROR_UNKNOWN);
 		return EC_ERROR_UNKNOWN;
+	}
 
+	i2c_stats_xfer(port, out_size + in_size, EC_SUCCESS);
 	return EC_SUCCESS;
 err_i2c_xfer:
 	/* Send STOP and return error */
 	MEC1322_I2C_CTRL(port) = CTRL_PIN | CTRL_ESO | CTRL_STO | CTRL_ACK;
-	return EC_ERROR_UNKNOWN;
+	i2c_stats_xfer(port, out_size + in_size, rv);
+	return rv;
 }
 
 int i2c_raw_get_scl(int port)
@@ -736,6 +736,7 @@ int i2c_xfer(int port, int slave_addr, const uint8_t *out, int out_bytes,
 
 	i2c_release(port);
 
+	i2c_stats_xfer(port, out_bytes + in_bytes, rv);
 	return rv;
 }
 
@@ -350,6 +350,7 @@ xfer_exit:
 		STM32_I2C_CR1(port) |= STM32_I2C_CR1_PE;
 	}
 
+	i2c_stats_xfer(port, out_bytes + in_bytes, rv);
 	return rv;
 }
 
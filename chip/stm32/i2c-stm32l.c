@@ -336,6 +336,7 @@ int i2c_xfer(int port, int slave_addr, const uint8_t *out, int out_bytes,
 		udelay(10);
 	}
 
+	i2c_stats_xfer(port, out_bytes + in_bytes, rv);
 	return rv;
 }
 
@@ -41,10 +41,15 @@ common-$(CONFIG_EXTPOWER_GPIO)+=extpower_gpio.o
 common-$(CONFIG_EXTPOWER_SNOW)+=extpower_snow.o
 common-$(CONFIG_EXTPOWER_SPRING)+=extpower_spring.o
 common-$(CONFIG_FANS)+=fan.o
+common-$(CONFIG_FAN_PID)+=fan_pid.o
 common-$(CONFIG_FLASH)+=flash.o
 common-$(CONFIG_FMAP)+=fmap.o
 common-$(CONFIG_I2C)+=i2c.o
 common-$(CONFIG_I2C_ARBITRATION)+=i2c_arbitration.o
+common-$(CONFIG_I2C_ASYNC)+=i2c_async.o
+common-$(CONFIG_I2C_REGCACHE)+=i2c_regcache.o
+common-$(CONFIG_I2C_STATS)+=i2c_stats.o
+common-$(CONFIG_KEYBOARD_LATENCY)+=keyboard_latency.o
 common-$(CONFIG_KEYBOARD_PROTOCOL_8042)+=keyboard_8042.o
 common-$(CONFIG_KEYBOARD_PROTOCOL_MKBP)+=keyboard_mkbp.o
 common-$(CONFIG_KEYBOARD_TEST)+=keyboard_test.o
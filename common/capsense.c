@@ -62,7 +62,7 @@ static void capsense_change_deferred(void)
 			CPRINTF("%s", n ? " X " : " _ ");
 			if (n == c)
 				continue;
-#ifdef HAS_TASK_KEYPROTO
+#if defined(HAS_TASK_KEYPROTO) || defined(CONFIG_KEYBOARD_PROTOCOL_MKBP)
 			/* Treat it as a keyboard event. */
 			keyboard_update_button(i + KEYBOARD_BUTTON_CAPSENSE_1,
 					       n);
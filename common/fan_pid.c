@@ -0,0 +1,217 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Closed-loop PID fan control for Chrome EC */
+
+#include "common.h"
+#include "console.h"
+#include "fan.h"
+#include "hooks.h"
+#include "host_command.h"
+#include "temp_sensor.h"
+#include "thermal.h"
+#include "timer.h"
+#include "util.h"
+
+/* Console output macros */
+#define CPRINTS(format, args...) cprints(CC_THERMAL, format, ## args)
+
+BUILD_ASSERT(TEMP_SENSOR_COUNT <= EC_FAN_PID_SENSORS);
+
+/* Controller state for each fan */
+static struct {
+	timestamp_t next_run;
+	timestamp_t last_run;
+	int on;			/* Reached the target and not yet cooled off */
+	int prev_error;		/* Error at the last run, in K */
+	int integral;		/* Error integrated over time, in K*ms */
+	int temp;		/* Last weighted temperature, or 0 if none */
+	int percent;		/* Last output */
+} pid[CONFIG_FANS];
+
+int fan_pid_enabled(int fan)
+{
+	return fan_pid_params[fan].temp_target != 0;
+}
+
+static void reset_pid(int fan)
+{
+	memset(pid + fan, 0, sizeof(pid[0]));
+}
+
+/**
+ * Average the readable sensors with non-zero weights.
+ *
+ * @return EC_SUCCESS, or EC_ERROR_UNKNOWN if none of them could be read.
+ */
+static int weighted_temp(const struct ec_fan_pid_config *cfg, int *temp_ptr)
+{
+	int sum = 0, weights = 0;
+	int i, t;
+
+	for (i = 0; i < TEMP_SENSOR_COUNT; i++) {
+		if (!cfg->weight[i] || temp_sensor_read(i, &t) != EC_SUCCESS)
+			continue;
+
+		sum += cfg->weight[i] * t;
+		weights += cfg->weight[i];
+	}
+
+	if (!weights)
+		return EC_ERROR_UNKNOWN;
+
+	*temp_ptr = (sum + weights / 2) / weights;
+	return EC_SUCCESS;
+}
+
+static void run_pid(int fan, int dt_ms)
+{
+	const struct ec_fan_pid_config *cfg = fan_pid_params + fan;
+	int error, integral, deriv, out;
+
+	/* Without any readings, hold the last output rather than guess */
+	if (weighted_temp(cfg, &pid[fan].temp) != EC_SUCCESS) {
+		pid[fan].temp = 0;
+		return;
+	}
+
+	error = pid[fan].temp - cfg->temp_target;
+
+	/* Start at the target, but don't stop until well below it */
+	if (!pid[fan].on && error >= 0) {
+		pid[fan].on = 1;
+		pid[fan].prev_error = error;
+		pid[fan].integral = 0;
+	} else if (pid[fan].on && error < -cfg->hysteresis) {
+		pid[fan].on = 0;
+	}
+
+	if (!pid[fan].on) {
+		pid[fan].percent = 0;
+		fan_set_percent_needed(fan, 0);
+		return;
+	}
+
+	deriv = (error - pid[fan].prev_error) * 1000 / dt_ms;
+	pid[fan].prev_error = error;
+
+	/* Without an integral term, don't let it grow without bound */
+	integral = cfg->ki ? pid[fan].integral + error * dt_ms : 0;
+	out = (cfg->kp * error + cfg->ki * (integral / 1000) +
+	       cfg->kd * deriv) / 100;
+
+	/* Don't wind the integral up any further while the output is pinned */
+	if (!((out > 100 && error > 0) || (out < 1 && error < 0)))
+		pid[fan].integral = integral;
+
+	/* Keep the fan turning for as long as it's on */
+	pid[fan].percent = MAX(1, MIN(out, 100));
+	fan_set_percent_needed(fan, pid[fan].percent);
+}
+
+static void fan_pid_tick(void)
+{
+	timestamp_t now = get_time();
+	int fan, dt_ms;
+
+	for (fan = 0; fan < CONFIG_FANS; fan++) {
+		if (!fan_pid_enabled(fan) ||
+		    !timestamp_expired(pid[fan].next_run, &now))
+			continue;
+
+		dt_ms = pid[fan].last_run.val ?
+			(now.val - pid[fan].last_run.val) / MSEC :
+			fan_pid_params[fan].period_ms;
+
+		/* A board table may leave the period 0, to run every tick */
+		run_pid(fan, MAX(dt_ms, 1));
+
+		/*
+		 * Schedule the next run half a tick early, so hook jitter
+		 * can't delay it by a whole tick.
+		 */
+		pid[fan].last_run = now;
+		pid[fan].next_run.val = now.val +
+			fan_pid_params[fan].period_ms * MSEC -
+			HOOK_TICK_INTERVAL / 2;
+	}
+}
+/* Run after the temperature sensors have been read */
+DECLARE_HOOK(HOOK_TICK, fan_pid_tick, HOOK_PRIO_TEMP_SENSOR_DONE);
+
+/*****************************************************************************/
+/* Console commands */
+
+static int command_fanpid(int argc, char **argv)
+{
+	int fan, i;
+
+	for (fan = 0; fan < CONFIG_FANS; fan++) {
+		const struct ec_fan_pid_config *cfg = fan_pid_params + fan;
+
+		if (!fan_pid_enabled(fan)) {
+			ccprintf("Fan %d: thermal ramp\n", fan);
+			continue;
+		}
+
+		ccprintf("Fan %d: target %d K, hysteresis %d K, period %d ms\n",
+			 fan, cfg->temp_target, cfg->hysteresis,
+			 cfg->period_ms);
+		ccprintf("  kp %d ki %d kd %d\n  weights", cfg->kp, cfg->ki,
+			 cfg->kd);
+		for (i = 0; i < TEMP_SENSOR_COUNT; i++)
+			ccprintf(" %d", cfg->weight[i]);
+		ccprintf("\n  temp %d K, %s, %d%%\n", pid[fan].temp,
+			 pid[fan].on ? "on" : "off", pid[fan].percent);
+		cflush();
+	}
+
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(fanpid, command_fanpid,
+			NULL,
+			"Print PID fan control profiles and state",
+			NULL);
+
+/*****************************************************************************/
+/* Host commands */
+
+static int fan_pid_command_get_config(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_fan_pid_get_config *p = args->params;
+	struct ec_response_fan_pid_get_config *r = args->response;
+
+	if (p->fan >= CONFIG_FANS)
+		return EC_RES_INVALID_PARAM;
+
+	r->cfg = fan_pid_params[p->fan];
+	r->temp = pid[p->fan].temp;
+	r->percent = pid[p->fan].percent;
+	r->flags = pid[p->fan].on ? EC_FAN_PID_FLAG_ON : 0;
+
+	args->response_size = sizeof(*r);
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_FAN_PID_GET_CONFIG,
+		     fan_pid_command_get_config,
+		     EC_VER_MASK(0));
+
+static int fan_pid_command_set_config(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_fan_pid_set_config *p = args->params;
+
+	if (p->fan >= CONFIG_FANS || !p->cfg.period_ms)
+		return EC_RES_INVALID_PARAM;
+
+	CPRINTS("Fan %d PID target %d K", p->fan, p->cfg.temp_target);
+
+	fan_pid_params[p->fan] = p->cfg;
+	reset_pid(p->fan);
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_FAN_PID_SET_CONFIG,
+		     fan_pid_command_set_config,
+		     EC_VER_MASK(0));
@@ -9,12 +9,18 @@
 #include "console.h"
 #include "flash.h"
 #include "gpio.h"
+#include "hooks.h"
 #include "host_command.h"
 #include "shared_mem.h"
 #include "system.h"
+#include "task.h"
+#include "timer.h"
 #include "util.h"
 #include "vboot_hash.h"
 
+/* Console output macros */
+#define CPRINTS(format, args...) cprints(CC_SYSTEM, format, ## args)
+
 /*
  * Contents of erased flash, as a 32-bit value.  Most platforms erase flash
  * bits to 1.
@@ -36,6 +42,28 @@ struct persist_state {
 /* Protect persist state and RO firmware at boot */
 #define PERSIST_FLAG_PROTECT_RO 0x02
 
+/* Erase blocks erased / skipped because they were already erased */
+static uint32_t erase_blocks_erased;
+static uint32_t erase_blocks_skipped;
+
+#ifdef CONFIG_FLASH_WRITE_COMBINE
+/*
+ * Write-combining buffer.  Holds one contiguous run of data which lies within
+ * a single CONFIG_FLASH_WRITE_IDEAL_SIZE-aligned block of flash.  Writes which
+ * append to the run are merged into it; anything else flushes it first.
+ */
+#define WRITE_COMBINE_TIMEOUT_US (50 * MSEC)
+
+static uint8_t wc_buf[CONFIG_FLASH_WRITE_IDEAL_SIZE] __aligned(4);
+static int wc_offset;		/* Flash offset of wc_buf[0] */
+static int wc_size;		/* Bytes buffered; 0 if buffer is empty */
+static struct mutex wc_mutex;
+
+/* Statistics */
+static uint32_t wc_writes;	/* Calls to flash_write() */
+static uint32_t wc_commits;	/* Physical writes issued by flash_write() */
+#endif
+
 /**
  * Get the physical memory address of a flash offset
  *
@@ -52,6 +80,38 @@ static const char *flash_physical_dataptr(int offset)
 	return (char *)((uintptr_t)CONFIG_FLASH_BASE + offset);
 }
 
+/**
+ * Check if words of flash hold the erased value.
+ *
+ * Compares ERASED_CHECK_STRIDE words per iteration, folding their
+ * differences from the erased value together so there is only one branch
+ * per stride.
+ *
+ * @param ptr		Pointer to first word to check
+ * @param words		Number of words to check
+ * @return 1 if erased, 0 if not erased
+ */
+#define ERASED_CHECK_STRIDE 8
+
+static int flash_words_erased(const uint32_t *ptr, int words)
+{
+	const uint32_t e = CONFIG_FLASH_ERASED_VALUE32;
+
+	for (; words >= ERASED_CHECK_STRIDE;
+	     words -= ERASED_CHECK_STRIDE, ptr += ERASED_CHECK_STRIDE) {
+		if ((ptr[0] ^ e) | (ptr[1] ^ e) | (ptr[2] ^ e) |
+		    (ptr[3] ^ e) | (ptr[4] ^ e) | (ptr[5] ^ e) |
+		    (ptr[6] ^ e) | (ptr[7] ^ e))
+			return 0;
+	}
+
+	for (; words > 0; words--, ptr++)
+		if (*ptr != e)
+			return 0;
+
+	return 1;
+}
+
 /**
  * Read persistent state into pstate.
  *
@@ -100,18 +160,137 @@ static int flash_write_pstate(const struct persist_state *pstate)
 				    (const char *)pstate);
 }
 
+#ifdef CONFIG_FLASH_WRITE_COMBINE
+/**
+ * Commit the write-combining buffer.  Caller must hold wc_mutex.
+ *
+ * @return EC_SUCCESS, or nonzero if error.
+ */
+static int flash_write_flush_locked(void)
+{
+	int rv;
+
+	if (!wc_size)
+		return EC_SUCCESS;
+
+	rv = flash_physical_write(wc_offset, wc_size, (const char *)wc_buf);
+	wc_commits++;
+	wc_size = 0;
+
+	return rv;
+}
+
+int flash_write_flush(void)
+{
+	int rv;
+
+	mutex_lock(&wc_mutex);
+	rv = flash_write_flush_locked();
+	mutex_unlock(&wc_mutex);
+
+	return rv;
+}
+
+static void flash_write_flush_deferred(void)
+{
+	if (flash_write_flush())
+		CPRINTS("flash write-combine flush failed");
+}
+DECLARE_DEFERRED(flash_write_flush_deferred);
+
+/**
+ * Write through the write-combining buffer.
+ *
+ * Data is split at CONFIG_FLASH_WRITE_IDEAL_SIZE block boundaries.  Whole
+ * aligned blocks go straight to flash; partial blocks are buffered and
+ * committed once the block fills or the buffer times out.
+ *
+ * @param offset	Flash offset to write.
+ * @param size		Number of bytes to write.
+ * @param data		Data to write to flash.
+ * @return EC_SUCCESS, or nonzero if error.
+ */
+static int flash_write_combine(int offset, int size, const char *data)
+{
+	int rv = EC_SUCCESS;
+
+	mutex_lock(&wc_mutex);
+	wc_writes++;
+
+	while (size > 0) {
+		int block_end = (offset | (CONFIG_FLASH_WRITE_IDEAL_SIZE - 1))
+			+ 1;
+		int chunk = MIN(size, block_end - offset);
+
+		/* Flush buffered data we can't append to */
+		if (wc_size && offset != wc_offset + wc_size) {
+			rv = flash_write_flush_locked();
+			if (rv)
+				break;
+		}
+
+		if (!wc_size && chunk == CONFIG_FLASH_WRITE_IDEAL_SIZE) {
+			/* Whole aligned blocks gain nothing from buffering */
+			chunk = size & ~(CONFIG_FLASH_WRITE_IDEAL_SIZE - 1);
+			rv = flash_physical_write(offset, chunk, data);
+			wc_commits++;
+		} else {
+			if (!wc_size)
+				wc_offset = offset;
+			memcpy(wc_buf + wc_size, data, chunk);
+			wc_size += chunk;
+
+			/* Commit as soon as the block is complete */
+			if (offset + chunk == block_end)
+				rv = flash_write_flush_locked();
+		}
+		if (rv)
+			break;
+
+		offset += chunk;
+		data += chunk;
+		size -= chunk;
+	}
+
+	/* Don't leave a partial block sitting in RAM forever */
+	if (wc_size)
+		hook_call_deferred(flash_write_flush_deferred,
+				   WRITE_COMBINE_TIMEOUT_US);
+
+	mutex_unlock(&wc_mutex);
+
+	return rv;
+}
+#endif
+
 int flash_dataptr(int offset, int size_req, int align, const char **ptrp)
 {
 	if (offset < 0 || size_req < 0 ||
 			offset + size_req > CONFIG_FLASH_SIZE ||
 			(offset | size_req) & (align - 1))
 		return -1;  /* Invalid range */
-	if (ptrp)
+	if (ptrp) {
+		/* Caller is going to read flash, so it must be up to date */
+		flash_write_flush();
 		*ptrp = flash_physical_dataptr(offset);
+	}
 
 	return CONFIG_FLASH_SIZE - offset;
 }
 
+/**
+ * Check if an erase block is erased, bypassing the write-combining buffer.
+ *
+ * @param offset	Flash offset of block; must be erase-block aligned
+ * @return 1 if erased, 0 if not erased
+ */
+static int flash_erase_block_is_erased(int offset)
+{
+	return flash_words_erased(
+		(const uint32_t *)flash_physical_dataptr(offset),
+		CONFIG_FLASH_ERASE_SIZE / sizeof(uint32_t));
+}
+
 int flash_is_erased(uint32_t offset, int size)
 {
 	const uint32_t *ptr;
@@ -120,11 +299,28 @@ int flash_is_erased(uint32_t offset, int size)
 			  (const char **)&ptr) < 0)
 		return 0;
 
-	for (size /= sizeof(uint32_t); size > 0; size -= 4, ptr++)
-		if (*ptr != CONFIG_FLASH_ERASED_VALUE32)
-			return 0;
+	return flash_words_erased(ptr, size / sizeof(uint32_t));
+}
 
-	return 1;
+/**
+ * Check if any bank in a range of flash is write protected.
+ *
+ * @param offset	Flash offset of range
+ * @param size		Size of range in bytes
+ * @return 1 if any part of the range is protected, 0 if not.
+ */
+static int flash_range_is_protected(int offset, int size)
+{
+	int bank;
+
+	for (bank = offset / CONFIG_FLASH_BANK_SIZE;
+	     bank < DIV_ROUND_UP(offset + size, CONFIG_FLASH_BANK_SIZE);
+	     bank++) {
+		if (flash_physical_get_protect(bank))
+			return 1;
+	}
+
+	return 0;
 }
 
 int flash_write(int offset, int size, const char *data)
@@ -136,7 +332,18 @@ int flash_write(int offset, int size, const char *data)
 	vboot_hash_invalidate(offset, size);
 #endif
 
+#ifdef CONFIG_FLASH_WRITE_COMBINE
+	/*
+	 * Buffered writes are committed later, so check write protect now
+	 * to report failure to the caller instead of dropping the data.
+	 */
+	if (flash_range_is_protected(offset, size))
+		return EC_ERROR_ACCESS_DENIED;
+
+	return flash_write_combine(offset, size, data);
+#else
 	return flash_physical_write(offset, size, data);
+#endif
 }
 
 int flash_erase(int offset, int size)
@@ -148,7 +355,56 @@ int flash_erase(int offset, int size)
 	vboot_hash_invalidate(offset, size);
 #endif
 
-	return flash_physical_erase(offset, size);
+#ifdef CONFIG_FLASH_WRITE_COMBINE
+	mutex_lock(&wc_mutex);
+	if (wc_size) {
+		/* Data buffered inside the erased range need not be written */
+		if (wc_offset >= offset &&
+		    wc_offset + wc_size <= offset + size)
+			wc_size = 0;
+		else
+			flash_write_flush_locked();
+	}
+	mutex_unlock(&wc_mutex);
+#endif
+
+	/*
+	 * Skipping erased blocks mustn't turn an erase of protected flash into
+	 * a success, so check protection for the whole range up front.
+	 */
+	if (flash_range_is_protected(offset, size))
+		return EC_ERROR_ACCESS_DENIED;
+
+	/*
+	 * Only erase blocks which aren't already erased, combining runs of
+	 * adjacent dirty blocks into a single physical erase.
+	 */
+	while (size > 0) {
+		int run;
+		int rv;
+
+		if (flash_erase_block_is_erased(offset)) {
+			erase_blocks_skipped++;
+			offset += CONFIG_FLASH_ERASE_SIZE;
+			size -= CONFIG_FLASH_ERASE_SIZE;
+			continue;
+		}
+
+		for (run = CONFIG_FLASH_ERASE_SIZE; run < size;
+		     run += CONFIG_FLASH_ERASE_SIZE)
+			if (flash_erase_block_is_erased(offset + run))
+				break;
+
+		rv = flash_physical_erase(offset, run);
+		if (rv)
+			return rv;
+
+		erase_blocks_erased += run / CONFIG_FLASH_ERASE_SIZE;
+		offset += run;
+		size -= run;
+	}
+
+	return EC_SUCCESS;
 }
 
 int flash_protect_ro_at_boot(int enable)
@@ -281,6 +537,14 @@ int flash_set_protect(uint32_t mask, uint32_t flags)
 				      EC_FLASH_PROTECT_RO_AT_BOOT))
 		return retval;
 
+	/* Land buffered writes before the banks become read-only */
+	if ((mask & flags) &
+	    (EC_FLASH_PROTECT_RO_NOW | EC_FLASH_PROTECT_ALL_NOW)) {
+		rv = flash_write_flush();
+		if (rv)
+			retval = rv;
+	}
+
 	if ((mask & EC_FLASH_PROTECT_RO_NOW) &&
 	    (flags & EC_FLASH_PROTECT_RO_NOW)) {
 		rv = flash_physical_protect_now(0);
@@ -342,6 +606,14 @@ static int command_flash_info(int argc, char **argv)
 	}
 	ccputs("\n");
 
+	ccprintf("Erased:  %d blocks (%d skipped)\n", erase_blocks_erased,
+		 erase_blocks_skipped);
+
+#ifdef CONFIG_FLASH_WRITE_COMBINE
+	ccprintf("Combine: %d writes -> %d physical, %d B buffered\n",
+		 wc_writes, wc_commits, wc_size);
+#endif
+
 	return EC_SUCCESS;
 }
 DECLARE_CONSOLE_COMMAND(flashinfo, command_flash_info,
@@ -31,11 +31,16 @@ static struct mutex port_mutex[I2C_PORT_COUNT];
 void i2c_lock(int port, int lock)
 {
 	if (lock) {
+		uint32_t begin;
+
 		/* Don't allow deep sleep when I2C port is locked */
 		disable_sleep(SLEEP_MASK_I2C);
 
+		begin = i2c_stats_lock_begin();
 		mutex_lock(port_mutex + port);
+		i2c_stats_locked(port, begin);
 	} else {
+		i2c_stats_unlocking(port);
 		mutex_unlock(port_mutex + port);
 
 		/* Allow deep sleep again after I2C port is unlocked */
@@ -519,8 +524,13 @@ static int i2c_command_passthru(struct host_cmd_handler_args *args)
 		else
 			write_len = msg->len;
 
-		/* Set stop bit for last message */
-		if (resp->num_msgs == params->num_msgs - 1)
+		/*
+		 * Set stop bit for last message, and for any message which
+		 * ends a transaction within a batch.
+		 */
+		if (resp->num_msgs == params->num_msgs - 1 ||
+		    (args->version >= 1 &&
+		     (msg->addr_flags & EC_I2C_FLAG_STOP)))
 			xferflags |= I2C_XFER_STOP;
 
 		/* Transfer next message */
@@ -553,7 +563,8 @@ static int i2c_command_passthru(struct host_cmd_handler_args *args)
 	 */
 	return EC_RES_SUCCESS;
 }
-DECLARE_HOST_COMMAND(EC_CMD_I2C_PASSTHRU, i2c_command_passthru, EC_VER_MASK(0));
+DECLARE_HOST_COMMAND(EC_CMD_I2C_PASSTHRU, i2c_command_passthru,
+		     EC_VER_MASK(0) | EC_VER_MASK(1));
 
 /*****************************************************************************/
 /* Console commands */
@@ -0,0 +1,125 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Queued I2C transactions for Chrome EC */
+
+#include "common.h"
+#include "i2c.h"
+#include "task.h"
+#include "util.h"
+
+/* Requests waiting on each port, oldest first. */
+static struct i2c_request *queue_head[I2C_PORT_COUNT];
+static struct i2c_request *queue_tail[I2C_PORT_COUNT];
+
+int i2c_transfer(int port, const struct i2c_msg *msgs, int count)
+{
+	int i, rv = EC_SUCCESS;
+
+	i2c_lock(port, 1);
+	for (i = 0; i < count && rv == EC_SUCCESS; i++)
+		rv = i2c_xfer(port, msgs[i].slave_addr, msgs[i].out,
+			      msgs[i].out_size, msgs[i].in, msgs[i].in_size,
+			      msgs[i].flags);
+	i2c_lock(port, 0);
+
+	return rv;
+}
+
+/**
+ * Take the oldest request off a port's queue.
+ *
+ * @return the request, or NULL if there is none.
+ */
+static struct i2c_request *dequeue(int port)
+{
+	struct i2c_request *req;
+
+	interrupt_disable();
+	req = queue_head[port];
+	if (req) {
+		queue_head[port] = req->next;
+		if (!queue_head[port])
+			queue_tail[port] = NULL;
+	}
+	interrupt_enable();
+
+	return req;
+}
+
+/**
+ * Run queued requests, taking one from each port in turn so a long queue on
+ * one port does not hold up the others.
+ */
+static void i2c_run_queues(void)
+{
+	struct i2c_request *req;
+	void (*done)(struct i2c_request *req);
+	uint32_t event;
+	int port, task, ran;
+
+	do {
+		ran = 0;
+		for (port = 0; port < I2C_PORT_COUNT; port++) {
+			req = dequeue(port);
+			if (!req)
+				continue;
+
+			req->rv = i2c_transfer(port, req->msgs,
+					       req->msg_count);
+
+			/*
+			 * The owner may reuse the request as soon as busy is
+			 * clear, even to submit it again from done().
+			 */
+			done = req->done;
+			task = req->task;
+			event = req->event;
+			req->busy = 0;
+			if (done)
+				done(req);
+			if (event)
+				task_set_event(task, event, 0);
+			ran = 1;
+		}
+	} while (ran);
+}
+
+/*
+ * Transfers block, so run them from their own task rather than the hook
+ * task, which would hold up every other hook and deferred function.
+ */
+void i2c_async_task(void)
+{
+	while (1) {
+		i2c_run_queues();
+		task_wait_event(-1);
+	}
+}
+
+int i2c_submit(struct i2c_request *req)
+{
+	int port = req->port;
+
+	if (port < 0 || port >= I2C_PORT_COUNT)
+		return EC_ERROR_INVAL;
+
+	interrupt_disable();
+	if (req->busy) {
+		interrupt_enable();
+		return EC_ERROR_BUSY;
+	}
+	req->busy = 1;
+	req->next = NULL;
+	if (queue_tail[port])
+		queue_tail[port]->next = req;
+	else
+		queue_head[port] = req;
+	queue_tail[port] = req;
+	interrupt_enable();
+
+	task_wake(TASK_ID_I2CASYNC);
+	return EC_SUCCESS;
+}
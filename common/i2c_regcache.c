@@ -0,0 +1,125 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Cache of I2C device configuration registers for Chrome EC */
+
+#include "common.h"
+#include "i2c.h"
+#include "util.h"
+
+void i2c_regcache_init(struct i2c_regcache *cache, const uint8_t *regs,
+		       int count)
+{
+	ASSERT(count <= I2C_REGCACHE_MAX);
+
+	cache->regs = regs;
+	cache->count = count;
+	cache->valid = 0;
+}
+
+/**
+ * Find a register in the cache.
+ *
+ * @return its index in cache->val[], or -1 if the register is not cacheable.
+ */
+static int find_reg(const struct i2c_regcache *cache, int offset)
+{
+	int i;
+
+	for (i = 0; i < cache->count; i++)
+		if (cache->regs[i] == offset)
+			return i;
+
+	return -1;
+}
+
+static int cached_read(struct i2c_regcache *cache, int port, int slave_addr,
+		       int offset, int *data, int bits)
+{
+	int i = find_reg(cache, offset);
+	int rv;
+
+	if (i >= 0 && (cache->valid & (1 << i))) {
+		*data = cache->val[i];
+		return EC_SUCCESS;
+	}
+
+	if (bits == 16)
+		rv = i2c_read16(port, slave_addr, offset, data);
+	else
+		rv = i2c_read8(port, slave_addr, offset, data);
+
+	if (rv == EC_SUCCESS && i >= 0) {
+		cache->val[i] = *data;
+		cache->valid |= 1 << i;
+	}
+
+	return rv;
+}
+
+static int cached_write(struct i2c_regcache *cache, int port, int slave_addr,
+			int offset, int data, int bits)
+{
+	int i = find_reg(cache, offset);
+	int rv;
+
+	if (bits == 16)
+		rv = i2c_write16(port, slave_addr, offset, data);
+	else
+		rv = i2c_write8(port, slave_addr, offset, data);
+
+	if (i < 0)
+		return rv;
+
+	/* A failed write may or may not have reached the device. */
+	if (rv == EC_SUCCESS) {
+		cache->val[i] = bits == 16 ? data & 0xffff : data & 0xff;
+		cache->valid |= 1 << i;
+	} else {
+		cache->valid &= ~(1 << i);
+	}
+
+	return rv;
+}
+
+int i2c_regcache_read8(struct i2c_regcache *cache, int port, int slave_addr,
+		       int offset, int *data)
+{
+	return cached_read(cache, port, slave_addr, offset, data, 8);
+}
+
+int i2c_regcache_write8(struct i2c_regcache *cache, int port, int slave_addr,
+			int offset, int data)
+{
+	return cached_write(cache, port, slave_addr, offset, data, 8);
+}
+
+int i2c_regcache_read16(struct i2c_regcache *cache, int port, int slave_addr,
+			int offset, int *data)
+{
+	return cached_read(cache, port, slave_addr, offset, data, 16);
+}
+
+int i2c_regcache_write16(struct i2c_regcache *cache, int port, int slave_addr,
+			 int offset, int data)
+{
+	return cached_write(cache, port, slave_addr, offset, data, 16);
+}
+
+int i2c_regcache_update8(struct i2c_regcache *cache, int port, int slave_addr,
+			 int offset, int mask, int data)
+{
+	int old, rv;
+
+	rv = cached_read(cache, port, slave_addr, offset, &old, 8);
+	if (rv != EC_SUCCESS)
+		return rv;
+
+	data = (old & ~mask) | (data & mask);
+	if (data == old)
+		return EC_SUCCESS;
+
+	return cached_write(cache, port, slave_addr, offset, data, 8);
+}
@@ -0,0 +1,167 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* I2C bus and lock statistics for Chrome EC */
+
+#include "common.h"
+#include "console.h"
+#include "ec_commands.h"
+#include "host_command.h"
+#include "i2c.h"
+#include "task.h"
+#include "timer.h"
+#include "util.h"
+
+static struct ec_response_i2c_stats_port port_stats[I2C_PORT_COUNT];
+static struct ec_response_i2c_stats_task task_stats[TASK_ID_COUNT];
+
+/* Time each port was locked, and the task which locked it */
+static uint32_t lock_time[I2C_PORT_COUNT];
+static task_id_t lock_owner[I2C_PORT_COUNT];
+
+static uint32_t add_saturate(uint32_t total, uint32_t us)
+{
+	return total + us < total ? -1U : total + us;
+}
+
+uint32_t i2c_stats_lock_begin(void)
+{
+	return get_time().le.lo;
+}
+
+void i2c_stats_locked(int port, uint32_t begin)
+{
+	uint32_t now = get_time().le.lo;
+	uint32_t us = now - begin;
+	task_id_t task = task_get_current();
+	int bucket;
+
+	/* Port statistics are guarded by the port lock we now hold */
+	port_stats[port].locks++;
+	lock_time[port] = now;
+	lock_owner[port] = task;
+
+	if (task >= TASK_ID_COUNT)
+		return;
+
+	/* Each task only updates its own statistics */
+	task_stats[task].locks++;
+	task_stats[task].wait_us = add_saturate(task_stats[task].wait_us, us);
+	if (us > task_stats[task].wait_max_us)
+		task_stats[task].wait_max_us = us;
+	bucket = histogram_log2_bucket(us, EC_I2C_STATS_BUCKETS);
+	if (task_stats[task].buckets[bucket] != 0xffff)
+		task_stats[task].buckets[bucket]++;
+}
+
+void i2c_stats_unlocking(int port)
+{
+	struct ec_response_i2c_stats_port *p = port_stats + port;
+	task_id_t task = lock_owner[port];
+	uint32_t us = get_time().le.lo - lock_time[port];
+
+	p->busy_us = add_saturate(p->busy_us, us);
+	if (us > p->hold_max_us)
+		p->hold_max_us = us;
+
+	if (task < TASK_ID_COUNT)
+		task_stats[task].hold_us =
+			add_saturate(task_stats[task].hold_us, us);
+}
+
+void i2c_stats_xfer(int port, int bytes, int rv)
+{
+	struct ec_response_i2c_stats_port *p = port_stats + port;
+
+	p->xfers++;
+	p->bytes += bytes;
+	if (rv == EC_ERROR_TIMEOUT)
+		p->timeouts++;
+	else if (rv)
+		p->naks++;
+}
+
+/*****************************************************************************/
+/* Console commands */
+
+static int command_i2cstats(int argc, char **argv)
+{
+	int i, j;
+
+	if (argc > 1) {
+		if (strcasecmp(argv[1], "clear"))
+			return EC_ERROR_PARAM1;
+		memset(port_stats, 0, sizeof(port_stats));
+		memset(task_stats, 0, sizeof(task_stats));
+		return EC_SUCCESS;
+	}
+
+	ccputs("Port  xfers  bytes  naks  timeouts  locks  busy_us  hold_max\n");
+	for (i = 0; i < I2C_PORT_COUNT; i++) {
+		const struct ec_response_i2c_stats_port *p = port_stats + i;
+
+		ccprintf("%4d %6u %6u %5u %9u %6u %8u %9u\n", i, p->xfers,
+			 p->bytes, p->naks, p->timeouts, p->locks, p->busy_us,
+			 p->hold_max_us);
+	}
+	cflush();
+
+	ccputs("Task  locks  wait_us  wait_max  hold_us\n");
+	for (i = 0; i < TASK_ID_COUNT; i++) {
+		const struct ec_response_i2c_stats_task *t = task_stats + i;
+
+		if (!t->locks)
+			continue;
+
+		ccprintf("%4d %6u %8u %9u %8u\n", i, t->locks, t->wait_us,
+			 t->wait_max_us, t->hold_us);
+		for (j = 0; j < EC_I2C_STATS_BUCKETS; j++) {
+			if (!t->buckets[j])
+				continue;
+			ccprintf("  %s %6d us: %u\n",
+				 j == EC_I2C_STATS_BUCKETS - 1 ? ">=" : "< ",
+				 j == EC_I2C_STATS_BUCKETS - 1 ? 1 << j : 2 << j,
+				 t->buckets[j]);
+		}
+		cflush();
+	}
+
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(i2cstats, command_i2cstats,
+			"[clear]",
+			"Print or clear I2C bus and lock statistics",
+			NULL);
+
+/*****************************************************************************/
+/* Host commands */
+
+static int i2c_stats(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_i2c_stats *p = args->params;
+	void *stats;
+	int size;
+
+	if (p->type == EC_I2C_STATS_PORT && p->index < I2C_PORT_COUNT) {
+		stats = port_stats + p->index;
+		size = sizeof(port_stats[0]);
+	} else if (p->type == EC_I2C_STATS_TASK && p->index < TASK_ID_COUNT) {
+		stats = task_stats + p->index;
+		size = sizeof(task_stats[0]);
+	} else {
+		return EC_RES_INVALID_PARAM;
+	}
+
+	memcpy(args->response, stats, size);
+	args->response_size = size;
+
+	if (p->flags & EC_I2C_STATS_FLAG_CLEAR)
+		memset(stats, 0, size);
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_I2C_STATS,
+		     i2c_stats,
+		     EC_VER_MASK(0));
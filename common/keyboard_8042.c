@@ -13,6 +13,7 @@
 #include "host_command.h"
 #include "i8042_protocol.h"
 #include "keyboard_config.h"
+#include "keyboard_latency.h"
 #include "keyboard_protocol.h"
 #include "lightbar.h"
 #include "lpc.h"
@@ -75,6 +76,12 @@ static struct queue to_host = {
 	.buf        = to_host_buffer,
 };
 
+#ifdef CONFIG_KEYBOARD_LATENCY
+/* to_host position of the key event being traced, or -1 if none */
+static int keylat_pos = -1;
+static uint32_t keylat_time;		/* Time that event was queued */
+#endif
+
 /* Queue command/data from the host */
 enum {
 	HOST_COMMAND = 0,
@@ -103,6 +110,20 @@ static struct queue from_host = {
 	.buf        = from_host_buffer,
 };
 
+/*
+ * Replies to host bytes which haven't been sent yet.  The protocol task
+ * handles all pending host bytes before queueing the replies together.
+ */
+static uint8_t host_reply[sizeof(to_host_buffer)];
+static int host_reply_len;
+
+/*
+ * Bumped by keyboard_clear_buffer(), so the protocol task can drop replies
+ * it has batched up but not yet sent.  Only the protocol task touches
+ * host_reply[] itself.
+ */
+static uint32_t clear_count;
+
 static int i8042_irq_enabled;
 
 /* i8042 global settings */
@@ -240,19 +261,21 @@ struct kblog_t {
 	uint8_t byte;
 };
 
-static struct kblog_t *kblog_buf;	/* Log buffer; NULL if not logging */
-static int kblog_len;			/* Current log length */
+/* Log buffer comes from shared memory; buf is NULL if not logging */
+static struct queue kblog = {
+	.buf_bytes  = (MAX_KBLOG + 1) * sizeof(struct kblog_t),
+	.unit_bytes = sizeof(struct kblog_t),
+};
 
 /**
  * Add event to keyboard log.
  */
 static void kblog_put(char type, uint8_t byte)
 {
-	if (kblog_buf && kblog_len < MAX_KBLOG) {
-		kblog_buf[kblog_len].type = type;
-		kblog_buf[kblog_len].byte = byte;
-		kblog_len++;
-	}
+	struct kblog_t e = {type, byte};
+
+	if (kblog.buf && queue_has_space(&kblog, 1))
+		queue_add_units(&kblog, &e, 1);
 }
 
 /*****************************************************************************/
@@ -290,10 +313,13 @@ static void keyboard_enable_irq(int enable)
  *
  * @param len		Number of bytes to send to the host
  * @param to_host	Data to send
+ * @return EC_SUCCESS, or EC_ERROR_OVERFLOW if the bytes were dropped because
+ * the queue didn't have room for all of them.
  */
-static void i8042_send_to_host(int len, const uint8_t *bytes)
+static int i8042_send_to_host(int len, const uint8_t *bytes)
 {
 	int i;
+	int rv = EC_ERROR_OVERFLOW;
 
 	for (i = 0; i < len; i++)
 		kblog_put('s', bytes[i]);
@@ -303,11 +329,14 @@ static void i8042_send_to_host(int len, const uint8_t *bytes)
 	if (queue_has_space(&to_host, len)) {
 		kblog_put('t', to_host.tail);
 		queue_add_units(&to_host, bytes, len);
+		rv = EC_SUCCESS;
 	}
 	mutex_unlock(&to_host_mutex);
 
 	/* Wake up the task to move from queue to host */
 	task_wake(TASK_ID_KEYPROTO);
+
+	return rv;
 }
 
 /* Change to set 1 if the I8042_XLATE flag is set. */
@@ -320,55 +349,56 @@ static enum scancode_set_list acting_code_set(enum scancode_set_list set)
 	return set;
 }
 
+/*
+ * Per-set translation tables.  Set 1 breaks a key by setting the top bit of
+ * the last make code byte; set 2 puts 0xf0 in front of that byte.
+ */
+struct scancode_set_desc {
+	const uint16_t (*matrix)[KEYBOARD_COLS];	/* Make codes */
+	uint8_t break_prefix;	/* Byte before the last byte, or 0 */
+	uint8_t break_mask;	/* ORed into the last byte */
+};
+
+static const struct scancode_set_desc scancode_sets[SCANCODE_MAX + 1] = {
+	[SCANCODE_SET_1] = {scancode_set1, 0, 0x80},
+	[SCANCODE_SET_2] = {scancode_set2, 0xf0, 0},
+};
+
+/**
+ * Return the translation table for a scancode set, or NULL if unsupported.
+ */
+static const struct scancode_set_desc *get_set_desc(
+					enum scancode_set_list code_set)
+{
+	if (code_set > SCANCODE_MAX || !scancode_sets[code_set].matrix)
+		return NULL;
+
+	return &scancode_sets[code_set];
+}
+
 /**
- * Return the make or break code bytes for the active scancode set.
+ * Return the make or break code bytes for a scancode set.
  *
  * @param make_code	The make code to generate the make or break code from
  * @param pressed	Whether the key or button was pressed
- * @param code_set	The scancode set being used
+ * @param desc		The scancode set being used
  * @param scan_code	An array of bytes to store the make or break code in
- * @param len		The number of valid bytes to send in scan_code
+ * @return The number of valid bytes in scan_code
  */
-static void scancode_bytes(uint16_t make_code, int8_t pressed,
-			   enum scancode_set_list code_set, uint8_t *scan_code,
-			   int32_t *len)
+static int scancode_bytes(uint16_t make_code, int8_t pressed,
+			  const struct scancode_set_desc *desc,
+			  uint8_t *scan_code)
 {
-	*len = 0;
+	int len = 0;
 
-	/* Output the make code (from table) */
-	if (make_code >= 0x0100) {
-		*len += 2;
-		scan_code[0] = make_code >> 8;
-		scan_code[1] = make_code & 0xff;
-	} else {
-		*len += 1;
-		scan_code[0] = make_code & 0xff;
-	}
+	if (make_code >> 8)
+		scan_code[len++] = make_code >> 8;
+	if (!pressed && desc->break_prefix)
+		scan_code[len++] = desc->break_prefix;
+	scan_code[len++] = (make_code & 0xff) |
+		(pressed ? 0 : desc->break_mask);
 
-	switch (code_set) {
-	case SCANCODE_SET_1:
-		/* OR 0x80 for the last byte. */
-		if (!pressed) {
-			ASSERT(*len >= 1);
-			scan_code[*len - 1] |= 0x80;
-		}
-		break;
-
-	case SCANCODE_SET_2:
-		/*
-		 * Insert the break byte, move back the last byte and insert a
-		 * 0xf0 byte before that.
-		 */
-		if (!pressed) {
-			ASSERT(*len >= 1);
-			scan_code[*len] = scan_code[*len - 1];
-			scan_code[*len - 1] = 0xf0;
-			*len += 1;
-		}
-		break;
-	default:
-		break;
-	}
+	return len;
 }
 
 static enum ec_error_list matrix_callback(int8_t row, int8_t col,
@@ -376,39 +406,31 @@ static enum ec_error_list matrix_callback(int8_t row, int8_t col,
 					  enum scancode_set_list code_set,
 					  uint8_t *scan_code, int32_t *len)
 {
+	const struct scancode_set_desc *desc;
 	uint16_t make_code;
 
 	ASSERT(scan_code);
 	ASSERT(len);
 
-	if (row > KEYBOARD_ROWS || col > KEYBOARD_COLS)
+	if (row >= KEYBOARD_ROWS || col >= KEYBOARD_COLS)
 		return EC_ERROR_INVAL;
 
 	if (pressed)
 		keyboard_special(scancode_set1[row][col]);
 
-	code_set = acting_code_set(code_set);
-
-	switch (code_set) {
-	case SCANCODE_SET_1:
-		make_code = scancode_set1[row][col];
-		break;
-
-	case SCANCODE_SET_2:
-		make_code = scancode_set2[row][col];
-		break;
-
-	default:
+	desc = get_set_desc(acting_code_set(code_set));
+	if (!desc) {
 		CPRINTS("KB scancode set %d unsupported", code_set);
 		return EC_ERROR_UNIMPLEMENTED;
 	}
 
+	make_code = desc->matrix[row][col];
 	if (!make_code) {
 		CPRINTS("KB scancode %d:%d missing", row, col);
 		return EC_ERROR_UNIMPLEMENTED;
 	}
 
-	scancode_bytes(make_code, pressed, code_set, scan_code, len);
+	*len = scancode_bytes(make_code, pressed, desc, scan_code);
 	return EC_SUCCESS;
 }
 
@@ -434,6 +456,10 @@ void keyboard_clear_buffer(void)
 {
 	mutex_lock(&to_host_mutex);
 	queue_reset(&to_host);
+#ifdef CONFIG_KEYBOARD_LATENCY
+	keylat_pos = -1;
+#endif
+	clear_count++;
 	mutex_unlock(&to_host_mutex);
 	lpc_keyboard_clear_buffer();
 }
@@ -455,29 +481,128 @@ static void clear_typematic_key(void)
 	typematic_len = 0;
 }
 
-void keyboard_state_changed(int row, int col, int is_pressed)
+/**
+ * Translate one key change and update typematic state.
+ *
+ * @param scan_code	Buffer for the scan code, MAX_SCAN_CODE_LEN bytes
+ * @return The number of bytes to send to the host
+ */
+static int key_state_encode(int row, int col, int is_pressed,
+			    uint8_t *scan_code)
 {
-	uint8_t scan_code[MAX_SCAN_CODE_LEN];
 	int32_t len;
-	enum ec_error_list ret;
 
 	CPRINTS5("KB (%d,%d)=%d", row, col, is_pressed);
 
-	ret = matrix_callback(row, col, is_pressed, scancode_set, scan_code,
-			      &len);
-	if (ret == EC_SUCCESS) {
-		ASSERT(len > 0);
-		if (keystroke_enabled)
-			i8042_send_to_host(len, scan_code);
-	}
+	if (matrix_callback(row, col, is_pressed, scancode_set, scan_code,
+			    &len) != EC_SUCCESS)
+		len = 0;
 
 	if (is_pressed) {
 		keyboard_wakeup();
 		set_typematic_key(scan_code, len);
-		task_wake(TASK_ID_KEYPROTO);
 	} else {
 		clear_typematic_key();
 	}
+
+	return keystroke_enabled ? len : 0;
+}
+
+/**
+ * Send the scan codes for one or more key changes to the host.
+ *
+ * @return EC_SUCCESS, or EC_ERROR_OVERFLOW if the queue had no room for them.
+ */
+static int send_key_bytes(const uint8_t *bytes, int len)
+{
+	if (!len)
+		return EC_SUCCESS;
+
+#ifdef CONFIG_KEYBOARD_LATENCY
+	{
+		uint32_t t = keylat_queued();
+
+		/* Trace one key event at a time through to_host */
+		if (keylat_pos < 0 && queue_has_space(&to_host, len)) {
+			keylat_pos = to_host.tail;
+			keylat_time = t;
+		}
+	}
+#endif
+	return i8042_send_to_host(len, bytes);
+}
+
+/**
+ * Send a batch of key scan code sequences to the host.
+ *
+ * If the queue has no room for the whole batch, fall back to sending each
+ * sequence on its own, so only the keys which don't fit are dropped.
+ *
+ * @param bytes		Scan code sequences, back to back
+ * @param seq_len	Length of each sequence
+ * @param count		Number of sequences
+ */
+static void send_key_batch(const uint8_t *bytes, const uint8_t *seq_len,
+			   int count)
+{
+	int len = 0;
+	int i;
+
+	for (i = 0; i < count; i++)
+		len += seq_len[i];
+
+	if (send_key_bytes(bytes, len) == EC_SUCCESS || count < 2)
+		return;
+
+	for (i = 0; i < count; bytes += seq_len[i++])
+		send_key_bytes(bytes, seq_len[i]);
+}
+
+void keyboard_state_changed(int row, int col, int is_pressed)
+{
+	uint8_t scan_code[MAX_SCAN_CODE_LEN];
+
+	send_key_bytes(scan_code,
+		       key_state_encode(row, col, is_pressed, scan_code));
+
+	if (is_pressed)
+		task_wake(TASK_ID_KEYPROTO);
+}
+
+void keyboard_matrix_changed(const uint8_t *changed, const uint8_t *state)
+{
+	uint8_t bytes[sizeof(to_host_buffer)];
+	uint8_t seq_len[sizeof(to_host_buffer)];
+	int len = 0;
+	int count = 0;
+	int any_pressed = 0;
+	int c;
+
+	for (c = 0; c < KEYBOARD_COLS; c++) {
+		uint8_t m;
+
+		for (m = changed[c]; m; m &= m - 1) {
+			int r = __builtin_ctz(m);
+			int pressed = (state[c] >> r) & 1;
+			int n;
+
+			if (len + MAX_SCAN_CODE_LEN > sizeof(bytes)) {
+				send_key_batch(bytes, seq_len, count);
+				len = count = 0;
+			}
+			n = key_state_encode(r, c, pressed, bytes + len);
+			if (n) {
+				seq_len[count++] = n;
+				len += n;
+			}
+			any_pressed |= pressed;
+		}
+	}
+
+	send_key_batch(bytes, seq_len, count);
+
+	if (any_pressed)
+		task_wake(TASK_ID_KEYPROTO);
 }
 
 static void keystroke_enable(int enable)
@@ -838,19 +963,46 @@ static int handle_keyboard_command(uint8_t command, uint8_t *output)
 	return out_len;
 }
 
+/**
+ * Handle every pending byte from the host, and send all the replies to the
+ * host in one go.
+ */
 static void i8042_handle_from_host(void)
 {
-	struct host_byte h;
-	int ret_len;
+	struct host_byte h[sizeof(from_host_buffer) / sizeof(struct host_byte)];
 	uint8_t output[MAX_SCAN_CODE_LEN];
+	uint32_t cleared;
+	int count, len;
+	int i;
 
-	while (queue_remove_unit(&from_host, &h)) {
-		if (h.type == HOST_COMMAND)
-			ret_len = handle_keyboard_command(h.byte, output);
-		else
-			ret_len = handle_keyboard_data(h.byte, output);
+	while ((count = queue_remove_units(&from_host, h, ARRAY_SIZE(h)))) {
+		for (i = 0; i < count; i++) {
+			/* Make room for the longest reply to one byte */
+			if (host_reply_len + MAX_SCAN_CODE_LEN >
+			    sizeof(host_reply)) {
+				i8042_send_to_host(host_reply_len, host_reply);
+				host_reply_len = 0;
+			}
+
+			cleared = clear_count;
+			if (h[i].type == HOST_COMMAND)
+				len = handle_keyboard_command(h[i].byte,
+							      output);
+			else
+				len = handle_keyboard_data(h[i].byte, output);
 
-		i8042_send_to_host(ret_len, output);
+			/* Clearing the buffer drops the replies before it */
+			if (clear_count != cleared)
+				host_reply_len = 0;
+
+			memcpy(host_reply + host_reply_len, output, len);
+			host_reply_len += len;
+		}
+	}
+
+	if (host_reply_len) {
+		i8042_send_to_host(host_reply_len, host_reply);
+		host_reply_len = 0;
 	}
 }
 
@@ -961,6 +1113,14 @@ void keyboard_protocol_task(void)
 				break;
 			}
 
+#ifdef CONFIG_KEYBOARD_LATENCY
+			/* Is the host getting the key event being traced? */
+			if (to_host.head == keylat_pos) {
+				keylat_host_pickup(keylat_time);
+				keylat_pos = -1;
+			}
+#endif
+
 			/* Get a char from buffer. */
 			kblog_put('k', to_host.head);
 			queue_remove_unit(&to_host, &chr);
@@ -987,6 +1147,7 @@ test_mockable void keyboard_update_button(enum keyboard_button_type button,
 	uint32_t len;
 	struct button_8042_t button_8042;
 	enum scancode_set_list code_set;
+	const struct scancode_set_desc *desc;
 
 	/*
 	 * Only send the scan code if main chipset is fully awake and
@@ -996,21 +1157,15 @@ test_mockable void keyboard_update_button(enum keyboard_button_type button,
 		return;
 
 	code_set = acting_code_set(scancode_set);
-	button_8042 = buttons_8042[button];
-
-	switch (code_set) {
-	case SCANCODE_SET_1:
-		make_code = button_8042.scancode_set1;
-		break;
-	case SCANCODE_SET_2:
-		make_code = button_8042.scancode_set2;
-		break;
-	default:
+	desc = get_set_desc(code_set);
+	if (!desc)
 		return; /* Other sets are not supported */
-	}
 
-	scancode_bytes(make_code, is_pressed, code_set, scan_code, &len);
-	ASSERT(len > 0);
+	button_8042 = buttons_8042[button];
+	make_code = code_set == SCANCODE_SET_1 ? button_8042.scancode_set1 :
+		button_8042.scancode_set2;
+
+	len = scancode_bytes(make_code, is_pressed, desc, scan_code);
 
 	if (button_8042.repeat) {
 		if (is_pressed)
@@ -1103,18 +1258,22 @@ DECLARE_CONSOLE_COMMAND(ctrlram, command_controller_ram,
 
 static int command_keyboard_log(int argc, char **argv)
 {
-	int i;
+	struct kblog_t e[16];
+	int count;
+	int i, j;
 
 	/* If no args, print log */
 	if (argc == 1) {
-		ccprintf("KBC log (len=%d):\n", kblog_len);
-		for (i = 0; kblog_buf && i < kblog_len; ++i) {
-			ccprintf("%c.%02x ",
-				 kblog_buf[i].type, kblog_buf[i].byte);
-			if ((i & 15) == 15) {
-				ccputs("\n");
-				cflush();
-			}
+		ccprintf("KBC log (len=%d):\n",
+			 kblog.buf ? queue_count(&kblog) : 0);
+		for (i = 0; kblog.buf &&
+			     (count = queue_peek_units(&kblog, e, i,
+						       ARRAY_SIZE(e)));
+		     i += count) {
+			for (j = 0; j < count; j++)
+				ccprintf("%c.%02x ", e[j].type, e[j].byte);
+			ccputs("\n");
+			cflush();
 		}
 		ccputs("\n");
 		return EC_SUCCESS;
@@ -1125,20 +1284,18 @@ static int command_keyboard_log(int argc, char **argv)
 		return EC_ERROR_PARAM1;
 
 	if (i) {
-		if (!kblog_buf) {
-			int rv = shared_mem_acquire(
-				sizeof(*kblog_buf) * MAX_KBLOG,
-				(char **)&kblog_buf);
+		if (!kblog.buf) {
+			int rv = shared_mem_acquire(kblog.buf_bytes,
+						    (char **)&kblog.buf);
 			if (rv != EC_SUCCESS)
-				kblog_buf = NULL;
-			kblog_len = 0;
+				kblog.buf = NULL;
+			queue_reset(&kblog);
 			return rv;
 		}
 	} else {
-		kblog_len = 0;
-		if (kblog_buf)
-			shared_mem_release(kblog_buf);
-		kblog_buf = NULL;
+		if (kblog.buf)
+			shared_mem_release(kblog.buf);
+		kblog.buf = NULL;
 	}
 
 	return EC_SUCCESS;
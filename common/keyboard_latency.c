@@ -0,0 +1,76 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Key event latency tracing for Chrome EC */
+
+#include "common.h"
+#include "ec_commands.h"
+#include "host_command.h"
+#include "keyboard_latency.h"
+#include "timer.h"
+#include "util.h"
+
+static struct ec_response_keyboard_latency stats;
+
+/* Time the last key change from the scanner finished debouncing */
+static uint32_t debounced_time;
+static int debounced_pending;
+
+void keylat_record(enum ec_keyboard_latency_stage stage, uint32_t us)
+{
+	struct ec_keyboard_latency_stage_stats *s = stats.stage + stage;
+	int bucket = histogram_log2_bucket(us, EC_KEYBOARD_LATENCY_BUCKETS);
+
+	s->count++;
+	s->total_us = (s->total_us + us < s->total_us) ?
+		      -1U : s->total_us + us;
+	if (us > s->max_us)
+		s->max_us = us;
+	if (s->buckets[bucket] != 0xffff)
+		s->buckets[bucket]++;
+}
+
+void keylat_debounced(uint32_t t)
+{
+	debounced_time = t;
+	debounced_pending = 1;
+}
+
+uint32_t keylat_queued(void)
+{
+	uint32_t now = get_time().le.lo;
+
+	if (debounced_pending) {
+		keylat_record(EC_KEYBOARD_LATENCY_ENCODE,
+			      now - debounced_time);
+		debounced_pending = 0;
+	}
+
+	return now;
+}
+
+void keylat_host_pickup(uint32_t queued)
+{
+	keylat_record(EC_KEYBOARD_LATENCY_HOST, get_time().le.lo - queued);
+}
+
+/*****************************************************************************/
+/* Host commands */
+
+static int keyboard_latency(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_keyboard_latency *p = args->params;
+
+	memcpy(args->response, &stats, sizeof(stats));
+	args->response_size = sizeof(stats);
+
+	if (p->flags & EC_KEYBOARD_LATENCY_FLAG_CLEAR)
+		memset(&stats, 0, sizeof(stats));
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_KEYBOARD_LATENCY,
+		     keyboard_latency,
+		     EC_VER_MASK(0));
@@ -9,12 +9,15 @@
 #include "chipset.h"
 #include "console.h"
 #include "gpio.h"
+#include "hooks.h"
 #include "host_command.h"
 #include "keyboard_config.h"
+#include "keyboard_latency.h"
 #include "keyboard_protocol.h"
 #include "keyboard_raw.h"
 #include "keyboard_scan.h"
 #include "keyboard_test.h"
+#include "lid_switch.h"
 #include "system.h"
 #include "task.h"
 #include "timer.h"
@@ -25,12 +28,13 @@
 #define CPRINTS(format, args...) cprints(CC_KEYBOARD, format, ## args)
 
 /*
- * Keyboard FIFO depth.  This needs to be big enough not to overflow if a
+ * MKBP FIFO depth.  This needs to be big enough not to overflow if a
  * series of keys is pressed in rapid succession and the kernel is too busy
  * to read them out right away.
  *
- * RAM usage is (depth * #cols); see kb_fifo[][] below.  A 16-entry FIFO will
- * consume 16x13=208 bytes, which is non-trivial but not horrible.
+ * RAM usage is (depth * sizeof(struct ec_mkbp_event_entry)); see kb_fifo[]
+ * below.  A 16-entry FIFO will consume 16x18=288 bytes, which is non-trivial
+ * but not horrible.
  */
 #define KB_FIFO_DEPTH 16
 
@@ -41,12 +45,21 @@
 #define BATTERY_KEY_ROW 7
 #define BATTERY_KEY_ROW_MASK (1 << BATTERY_KEY_ROW)
 
+BUILD_ASSERT(KEYBOARD_COLS <=
+	     sizeof(((union ec_mkbp_event_data *)0)->key_matrix));
+
 static uint32_t kb_fifo_start;		/* first entry */
 static uint32_t kb_fifo_end;		/* last entry */
 static uint32_t kb_fifo_entries;	/* number of existing entries */
-static uint8_t kb_fifo[KB_FIFO_DEPTH][KEYBOARD_COLS];
+static struct ec_mkbp_event_entry kb_fifo[KB_FIFO_DEPTH];
 static struct mutex fifo_mutex;
 
+/* Last key state handed to the host, for EC_CMD_MKBP_STATE on underrun */
+static uint8_t kb_last_state[KEYBOARD_COLS];
+
+/* Buttons currently pressed; bit n is enum keyboard_button_type n */
+static uint32_t mkbp_button_state;
+
 /* Config for mkbp protocol; does not include fields from scan config */
 struct ec_mkbp_protocol_config {
 	uint32_t valid_mask;	/* valid fields */
@@ -62,36 +75,32 @@ static struct ec_mkbp_protocol_config config = {
 		EC_MKBP_VALID_MIN_POST_SCAN_DELAY |
 		EC_MKBP_VALID_OUTPUT_SETTLE | EC_MKBP_VALID_DEBOUNCE_DOWN |
 		EC_MKBP_VALID_DEBOUNCE_UP | EC_MKBP_VALID_FIFO_MAX_DEPTH,
-	.valid_flags = EC_MKBP_FLAGS_ENABLE,
+	.valid_flags = EC_MKBP_FLAGS_ENABLE | EC_MKBP_FLAGS_ADAPTIVE_SCAN,
 	.flags = EC_MKBP_FLAGS_ENABLE,
 	.fifo_max_depth = KB_FIFO_DEPTH,
 };
 
 /**
- * Pop keyboard state from FIFO
+ * Pop the oldest event from FIFO
  *
  * @return EC_SUCCESS if entry popped, EC_ERROR_UNKNOWN if FIFO is empty
  */
-static int kb_fifo_remove(uint8_t *buffp)
+static int kb_fifo_remove(struct ec_mkbp_event_entry *e)
 {
-	if (!kb_fifo_entries) {
-		/* no entry remaining in FIFO : return last known state */
-		int last = (kb_fifo_start + KB_FIFO_DEPTH - 1) % KB_FIFO_DEPTH;
-		memcpy(buffp, kb_fifo[last], KEYBOARD_COLS);
-
-		/*
-		 * Bail out without changing any FIFO indices and let the
-		 * caller know something strange happened. The buffer will
-		 * will contain the last known state of the keyboard.
-		 */
+	if (!kb_fifo_entries)
 		return EC_ERROR_UNKNOWN;
-	}
-	memcpy(buffp, kb_fifo[kb_fifo_start], KEYBOARD_COLS);
+
+	memcpy(e, &kb_fifo[kb_fifo_start], sizeof(*e));
 
 	kb_fifo_start = (kb_fifo_start + 1) % KB_FIFO_DEPTH;
 
 	atomic_sub(&kb_fifo_entries, 1);
 
+	if (e->event_type == EC_MKBP_EVENT_KEY_MATRIX) {
+		memcpy(kb_last_state, e->data.key_matrix, KEYBOARD_COLS);
+		keylat_host_pickup(e->timestamp);
+	}
+
 	return EC_SUCCESS;
 }
 
@@ -109,28 +118,29 @@ static void set_host_interrupt(int active)
 
 void keyboard_clear_buffer(void)
 {
-	int i;
-
 	CPRINTS("clearing keyboard fifo");
 
 	kb_fifo_start = 0;
 	kb_fifo_end = 0;
 	kb_fifo_entries = 0;
-	for (i = 0; i < KB_FIFO_DEPTH; i++)
-		memset(kb_fifo[i], 0, KEYBOARD_COLS);
+	memset(kb_fifo, 0, sizeof(kb_fifo));
+	memset(kb_last_state, 0, sizeof(kb_last_state));
 }
 
-test_mockable int keyboard_fifo_add(const uint8_t *buffp)
+int mkbp_fifo_add(enum ec_mkbp_event event_type, const void *data, int size)
 {
+	struct ec_mkbp_event_entry *e;
 	int ret = EC_SUCCESS;
 
 	/*
-	 * If keyboard protocol is not enabled, don't save the state to the
-	 * FIFO or trigger an interrupt.
+	 * If the protocol is not enabled, don't queue any event or interrupt
+	 * the host; it isn't listening.
 	 */
 	if (!(config.flags & EC_MKBP_FLAGS_ENABLE))
 		return EC_SUCCESS;
 
+	mutex_lock(&fifo_mutex);
+
 	if (kb_fifo_entries >= config.fifo_max_depth) {
 		CPRINTS("KB FIFO depth %d reached",
 			config.fifo_max_depth);
@@ -138,13 +148,16 @@ test_mockable int keyboard_fifo_add(const uint8_t *buffp)
 		goto kb_fifo_push_done;
 	}
 
-	mutex_lock(&fifo_mutex);
-	memcpy(kb_fifo[kb_fifo_end], buffp, KEYBOARD_COLS);
+	e = &kb_fifo[kb_fifo_end];
+	e->event_type = event_type;
+	e->timestamp = get_time().le.lo;
+	memset(&e->data, 0, sizeof(e->data));
+	memcpy(&e->data, data, MIN(size, sizeof(e->data)));
 	kb_fifo_end = (kb_fifo_end + 1) % KB_FIFO_DEPTH;
 	atomic_add(&kb_fifo_entries, 1);
-	mutex_unlock(&fifo_mutex);
 
 kb_fifo_push_done:
+	mutex_unlock(&fifo_mutex);
 
 	if (ret == EC_SUCCESS)
 		set_host_interrupt(1);
@@ -152,6 +165,35 @@ kb_fifo_push_done:
 	return ret;
 }
 
+test_mockable int keyboard_fifo_add(const uint8_t *buffp)
+{
+	int ret;
+
+	/*
+	 * If keyboard protocol is not enabled, don't save the state to the
+	 * FIFO or trigger an interrupt.
+	 */
+	if (!(config.flags & EC_MKBP_FLAGS_ENABLE))
+		return EC_SUCCESS;
+
+	ret = mkbp_fifo_add(EC_MKBP_EVENT_KEY_MATRIX, buffp, KEYBOARD_COLS);
+	if (ret == EC_SUCCESS)
+		keylat_queued();
+
+	return ret;
+}
+
+void keyboard_update_button(enum keyboard_button_type button, int is_pressed)
+{
+	if (is_pressed)
+		mkbp_button_state |= 1 << button;
+	else
+		mkbp_button_state &= ~(1 << button);
+
+	mkbp_fifo_add(EC_MKBP_EVENT_BUTTON, &mkbp_button_state,
+		      sizeof(mkbp_button_state));
+}
+
 void keyboard_send_battery_key(void)
 {
 	uint8_t state[KEYBOARD_COLS];
@@ -165,12 +207,33 @@ void keyboard_send_battery_key(void)
 		keyboard_fifo_add(state);
 }
 
+#ifdef CONFIG_LID_SWITCH
+static void mkbp_lid_change(void)
+{
+	uint32_t switches = lid_is_open() ? EC_MKBP_SWITCH_LID_OPEN : 0;
+
+	mkbp_fifo_add(EC_MKBP_EVENT_SWITCH, &switches, sizeof(switches));
+}
+DECLARE_HOOK(HOOK_LID_CHANGE, mkbp_lid_change, HOOK_PRIO_DEFAULT);
+#endif
+
 /*****************************************************************************/
 /* Host commands */
 
 static int keyboard_get_scan(struct host_cmd_handler_args *args)
 {
-	kb_fifo_remove(args->response);
+	struct ec_mkbp_event_entry e;
+
+	/*
+	 * Older hosts only understand key matrix events, so skip anything
+	 * else.  If the FIFO runs dry, return the last known key state.
+	 */
+	while (kb_fifo_remove(&e) == EC_SUCCESS) {
+		if (e.event_type == EC_MKBP_EVENT_KEY_MATRIX)
+			break;
+	}
+	memcpy(args->response, kb_last_state, KEYBOARD_COLS);
+
 	if (!kb_fifo_entries)
 		set_host_interrupt(0);
 
@@ -182,6 +245,27 @@ DECLARE_HOST_COMMAND(EC_CMD_MKBP_STATE,
 		     keyboard_get_scan,
 		     EC_VER_MASK(0));
 
+static int mkbp_get_events(struct host_cmd_handler_args *args)
+{
+	struct ec_response_mkbp_get_events *r = args->response;
+	int max = (args->response_max - sizeof(*r)) / sizeof(r->events[0]);
+
+	r->count = 0;
+	while (r->count < max && kb_fifo_remove(&r->events[r->count]) ==
+	       EC_SUCCESS)
+		r->count++;
+
+	if (!kb_fifo_entries)
+		set_host_interrupt(0);
+
+	args->response_size = sizeof(*r) + r->count * sizeof(r->events[0]);
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_MKBP_GET_EVENTS,
+		     mkbp_get_events,
+		     EC_VER_MASK(0));
+
 static int keyboard_get_info(struct host_cmd_handler_args *args)
 {
 	struct ec_response_mkbp_info *r = args->response;
@@ -198,6 +282,18 @@ DECLARE_HOST_COMMAND(EC_CMD_MKBP_INFO,
 		     keyboard_get_info,
 		     EC_VER_MASK(0));
 
+/**
+ * Get flags with the adaptive scan flag taken from the scan config, which
+ * boards may set.
+ */
+static uint8_t with_adaptive_flag(uint8_t flags)
+{
+	if (keyboard_scan_get_config()->max_scan_period_us)
+		return flags | EC_MKBP_FLAGS_ADAPTIVE_SCAN;
+	else
+		return flags & ~EC_MKBP_FLAGS_ADAPTIVE_SCAN;
+}
+
 static void set_keyscan_config(const struct ec_mkbp_config *src,
 			       struct ec_mkbp_protocol_config *dst,
 			       uint32_t valid_mask, uint8_t new_flags)
@@ -229,6 +325,11 @@ static void set_keyscan_config(const struct ec_mkbp_config *src,
 	if (valid_mask & EC_MKBP_VALID_DEBOUNCE_UP)
 		ksc->debounce_up_us = src->debounce_up_us;
 
+	if ((new_flags ^ dst->flags) & EC_MKBP_FLAGS_ADAPTIVE_SCAN)
+		ksc->max_scan_period_us =
+			(new_flags & EC_MKBP_FLAGS_ADAPTIVE_SCAN) ?
+			ksc->debounce_down_us : 0;
+
 	/*
 	 * If we just enabled key scanning, kick the task so that it will
 	 * fall out of the task_wait_event() in keyboard_scan_task().
@@ -271,6 +372,8 @@ static void keyscan_copy_config(const struct ec_mkbp_config *src,
 {
 	uint8_t new_flags;
 
+	dst->flags = with_adaptive_flag(dst->flags);
+
 	if (valid_mask & EC_MKBP_VALID_FIFO_MAX_DEPTH) {
 		/* Sanity check for fifo depth */
 		dst->fifo_max_depth = MIN(src->fifo_max_depth,
@@ -307,7 +410,7 @@ static int host_command_mkbp_get_config(struct host_cmd_handler_args *args)
 
 	/* Copy fields from mkbp protocol config to mkbp config */
 	dst->valid_mask = config.valid_mask;
-	dst->flags = config.flags;
+	dst->flags = with_adaptive_flag(config.flags);
 	dst->valid_flags = config.valid_flags;
 	dst->fifo_max_depth = config.fifo_max_depth;
 
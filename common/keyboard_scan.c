@@ -12,6 +12,7 @@
 #include "hooks.h"
 #include "host_command.h"
 #include "keyboard_config.h"
+#include "keyboard_latency.h"
 #include "keyboard_protocol.h"
 #include "keyboard_raw.h"
 #include "keyboard_scan.h"
@@ -71,14 +72,29 @@ static enum boot_key boot_key_value = BOOT_KEY_OTHER;
 
 static uint8_t debounced_state[KEYBOARD_COLS]; /* Debounced key matrix */
 static uint8_t prev_state[KEYBOARD_COLS];    /* Matrix from previous scan */
-static uint8_t debouncing[KEYBOARD_COLS];    /* Mask of keys being debounced */
+static uint8_t debouncing_down[KEYBOARD_COLS]; /* Keys debouncing a press */
+static uint8_t debouncing_up[KEYBOARD_COLS];   /* Keys debouncing a release */
 static uint8_t simulated_key[KEYBOARD_COLS]; /* Keys simulated-pressed */
 
 static uint32_t scan_time[SCAN_TIME_COUNT];  /* Times of last scans */
 static int scan_time_index;                  /* Current scan_time[] index */
 
-/* Index into scan_time[] when each key started debouncing */
-static uint8_t scan_edge_index[KEYBOARD_COLS][KEYBOARD_ROWS];
+/*
+ * Time each key finishes debouncing, and the earliest of those for each
+ * column.  A column's deadline may be early (if a key was re-armed), in which
+ * case it is recomputed when it passes; it is never late.
+ */
+static uint32_t key_deadline[KEYBOARD_COLS][KEYBOARD_ROWS];
+static uint32_t col_deadline[KEYBOARD_COLS];
+
+/* Mask of columns with keys being debounced */
+static uint32_t debouncing_cols;
+
+/* Time of the previous scan, or of the wake-up which started polling */
+static uint32_t prev_scan_time;
+
+/* Current time between scans in polling mode */
+static uint32_t scan_period_us;
 
 /* Minimum delay between keyboard scans based on current clock frequency */
 static uint32_t post_scan_clock_us;
@@ -311,6 +327,19 @@ static int check_runtime_keys(const uint8_t *state)
 	return 0;
 }
 
+/*
+ * Incremental ghosting state.  Ghosting happens if 2 columns share at least 2
+ * keys.  ghost_pairs[c] has bit c2 set if columns c and c2 ghost; ghost_cols
+ * has bit c set if ghost_pairs[c] is non-zero.  Only columns which changed
+ * since the last check need their pairs recomputed, and only against columns
+ * with keys down.
+ */
+static uint8_t ghost_state[KEYBOARD_COLS];
+static uint16_t ghost_pairs[KEYBOARD_COLS];
+static uint16_t ghost_cols;
+static uint16_t active_cols;
+BUILD_ASSERT(KEYBOARD_COLS <= 16);
+
 /**
  * Check for ghosting in the keyboard state.
  *
@@ -322,30 +351,142 @@ static int check_runtime_keys(const uint8_t *state)
  *
  * @return 1 if ghosting detected, else 0.
  */
-static int has_ghosting(const uint8_t *state)
+test_export_static int has_ghosting(const uint8_t *state)
 {
-	int c, c2;
+	int c;
 
 	for (c = 0; c < KEYBOARD_COLS; c++) {
-		if (!state[c])
+		uint16_t pairs = 0;
+		uint16_t m;
+
+		if (state[c] == ghost_state[c])
 			continue;
+		ghost_state[c] = state[c];
 
-		for (c2 = c + 1; c2 < KEYBOARD_COLS; c2++) {
+		if (state[c])
+			active_cols |= 1 << c;
+		else
+			active_cols &= ~(1 << c);
+
+		for (m = state[c] ? active_cols & ~(1 << c) : 0; m;
+		     m &= m - 1) {
+			int c2 = __builtin_ctz(m);
 			/*
-			 * A little bit of cleverness here.  Ghosting happens
-			 * if 2 columns share at least 2 keys.  So we OR the
-			 * columns together and then see if more than one bit
-			 * is set.  x&(x-1) is non-zero only if x has more than
-			 * one bit set.
+			 * A little bit of cleverness here.  x&(x-1) is
+			 * non-zero only if x has more than one bit set.
 			 */
 			uint8_t common = state[c] & state[c2];
 
 			if (common & (common - 1))
-				return 1;
+				pairs |= 1 << c2;
 		}
+
+		/* Update the other side of every pair which changed */
+		for (m = pairs ^ ghost_pairs[c]; m; m &= m - 1) {
+			int c2 = __builtin_ctz(m);
+
+			ghost_pairs[c2] ^= 1 << c;
+			if (ghost_pairs[c2])
+				ghost_cols |= 1 << c2;
+			else
+				ghost_cols &= ~(1 << c2);
+		}
+
+		ghost_pairs[c] = pairs;
+		if (pairs)
+			ghost_cols |= 1 << c;
+		else
+			ghost_cols &= ~(1 << c);
 	}
 
-	return 0;
+	return ghost_cols ? 1 : 0;
+}
+
+/**
+ * Return non-zero if time t is at or after deadline, allowing for wrap.
+ */
+static inline int deadline_passed(uint32_t t, uint32_t deadline)
+{
+	return (int32_t)(t - deadline) >= 0;
+}
+
+/**
+ * Start debouncing keys which changed state since the last scan.
+ *
+ * @param c		Column
+ * @param diff		Mask of keys in column which changed
+ * @param new_col	New raw state of column
+ * @param tnow		Time of this scan
+ */
+static void debounce_start(int c, uint8_t diff, uint8_t new_col,
+			   uint32_t tnow)
+{
+	uint32_t down = tnow + keyscan_config.debounce_down_us;
+	uint32_t up = tnow + keyscan_config.debounce_up_us;
+	uint32_t earliest;
+	uint8_t m = diff;
+
+	/* A new edge restarts debouncing for that key, in its new direction */
+	debouncing_down[c] = (debouncing_down[c] & ~diff) | (diff & new_col);
+	debouncing_up[c] = (debouncing_up[c] & ~diff) | (diff & ~new_col);
+
+	while (m) {
+		int i = __builtin_ctz(m);
+
+		key_deadline[c][i] = (new_col & (1 << i)) ? down : up;
+		m &= m - 1;
+	}
+
+	/* Wake for whichever of the new deadlines comes first */
+	if (!(diff & new_col))
+		earliest = up;
+	else if (!(diff & ~new_col) || deadline_passed(up, down))
+		earliest = down;
+	else
+		earliest = up;
+	if (!(debouncing_cols & (1 << c)) ||
+	    deadline_passed(col_deadline[c], earliest))
+		col_deadline[c] = earliest;
+	debouncing_cols |= 1 << c;
+}
+
+/**
+ * Find keys in a column which have finished debouncing.
+ *
+ * @param c		Column
+ * @param tnow		Time of this scan
+ *
+ * @return mask of keys which are done debouncing.
+ */
+static uint8_t debounce_done(int c, uint32_t tnow)
+{
+	uint8_t m = debouncing_down[c] | debouncing_up[c];
+	uint8_t done = 0;
+	uint32_t earliest = 0;
+	int pending = 0;
+
+	while (m) {
+		int i = __builtin_ctz(m);
+
+		m &= m - 1;
+		if (deadline_passed(tnow, key_deadline[c][i])) {
+			done |= 1 << i;
+		} else if (!pending ||
+			   deadline_passed(earliest, key_deadline[c][i])) {
+			earliest = key_deadline[c][i];
+			pending = 1;
+		}
+	}
+
+	debouncing_down[c] &= ~done;
+	debouncing_up[c] &= ~done;
+
+	if (pending)
+		col_deadline[c] = earliest;
+	else
+		debouncing_cols &= ~(1 << c);
+
+	return done;
 }
 
 /**
@@ -358,10 +499,18 @@ static int has_ghosting(const uint8_t *state)
 static int check_keys_changed(uint8_t *state)
 {
 	int any_pressed = 0;
-	int c, i;
+	int c;
 	int any_change = 0;
+	int any_edge = 0;
 	static uint8_t new_state[KEYBOARD_COLS];
 	uint32_t tnow = get_time().le.lo;
+	uint32_t cols;
+#ifdef PRINT_SCAN_TIMES
+	int i;
+#endif
+#ifdef CONFIG_KEYBOARD_PROTOCOL_8042
+	uint8_t kb_changed[KEYBOARD_COLS] = {0};
+#endif
 
 	/* Save the current scan time */
 	if (++scan_time_index >= SCAN_TIME_COUNT)
@@ -377,54 +526,81 @@ static int check_keys_changed(uint8_t *state)
 
 	/* Check for changes between previous scan and this one */
 	for (c = 0; c < KEYBOARD_COLS; c++) {
-		int diff = new_state[c] ^ prev_state[c];
+		uint8_t diff = new_state[c] ^ prev_state[c];
 
 		if (!diff)
 			continue;
 
-		for (i = 0; i < KEYBOARD_ROWS; i++) {
-			if (diff & (1 << i))
-				scan_edge_index[c][i] = scan_time_index;
-		}
-
-		debouncing[c] |= diff;
+		debounce_start(c, diff, new_state[c], tnow);
 		prev_state[c] = new_state[c];
+		any_edge = 1;
 	}
 
-	/* Check for keys which are done debouncing */
-	for (c = 0; c < KEYBOARD_COLS; c++) {
-		int debc = debouncing[c];
+	/* A change could have happened any time since the previous scan */
+	if (any_edge)
+		keylat_record(EC_KEYBOARD_LATENCY_SCAN, tnow - prev_scan_time);
+	prev_scan_time = tnow;
 
-		if (!debc)
+	/*
+	 * Check for keys which are done debouncing.  Only columns whose
+	 * earliest deadline has passed need to look at individual keys.
+	 */
+	for (cols = debouncing_cols; cols; cols &= cols - 1) {
+		uint8_t changed;
+#ifdef CONFIG_KEYBOARD_LATENCY
+		uint8_t m;
+#endif
+
+		c = __builtin_ctz(cols);
+		if (!deadline_passed(tnow, col_deadline[c]))
 			continue;
 
-		for (i = 0; i < KEYBOARD_ROWS; i++) {
-			int mask = 1 << i;
-			int new_mask = new_state[c] & mask;
+		/* Keys which are done and differ from their debounced state */
+		changed = debounce_done(c, tnow) & (state[c] ^ new_state[c]);
+		if (!changed)
+			continue;
 
-			/* Are we done debouncing this key? */
-			if (!(debc & mask))
-				continue;  /* Not debouncing this key */
-			if (tnow - scan_time[scan_edge_index[c][i]] <
-			    (new_mask ? keyscan_config.debounce_down_us :
-					keyscan_config.debounce_up_us))
-				continue;  /* Not done debouncing */
+		state[c] ^= changed;
+		any_change = 1;
 
-			debouncing[c] &= ~mask;
+#ifdef CONFIG_KEYBOARD_LATENCY
+		keylat_debounced(tnow);
+		for (m = changed; m; m &= m - 1) {
+			int r = __builtin_ctz(m);
+			int pressed = (new_state[c] >> r) & 1;
 
-			/* Did the key change from its previous state? */
-			if ((state[c] & mask) == new_mask)
-				continue;  /* No */
+			/* Work back from the deadline to the key's edge */
+			keylat_record(EC_KEYBOARD_LATENCY_DEBOUNCE,
+				      tnow - key_deadline[c][r] +
+				      (pressed ? keyscan_config.debounce_down_us :
+				       keyscan_config.debounce_up_us));
+		}
+#endif
 
-			state[c] ^= mask;
-			any_change = 1;
+#ifdef CONFIG_KEYBOARD_PROTOCOL_8042
+		kb_changed[c] = changed;
+#endif
+	}
 
 #ifdef CONFIG_KEYBOARD_PROTOCOL_8042
-			/* Inform keyboard module if scanning is enabled */
-			if (keyboard_scan_is_enabled())
-				keyboard_state_changed(i, c, new_mask ? 1 : 0);
+	/* Inform keyboard module if scanning is enabled */
+	if (any_change && keyboard_scan_is_enabled())
+		keyboard_matrix_changed(kb_changed, new_state);
 #endif
-		}
+
+	/*
+	 * Scan fast while keys are changing, so we see the next edge and the
+	 * end of debouncing promptly.  Otherwise back off, but never beyond
+	 * the key down debounce time.
+	 */
+	if (any_edge || debouncing_cols || !keyscan_config.max_scan_period_us) {
+		scan_period_us = keyscan_config.scan_period_us;
+	} else {
+		uint32_t max = MIN(keyscan_config.max_scan_period_us,
+				   keyscan_config.debounce_down_us);
+
+		scan_period_us = MAX(MIN(scan_period_us * 2, max),
+				     keyscan_config.scan_period_us);
 	}
 
 	if (any_change) {
@@ -604,6 +780,8 @@ void keyboard_scan_task(void)
 
 		/* Enter polling mode */
 		CPRINTS("KB poll");
+		prev_scan_time = get_time().le.lo;
+		scan_period_us = keyscan_config.scan_period_us;
 		keyboard_raw_enable_interrupt(0);
 		keyboard_raw_drive_column(KEYBOARD_COLUMN_NONE);
 
@@ -620,7 +798,7 @@ void keyboard_scan_task(void)
 			}
 
 			/* Delay between scans */
-			wait_time = keyscan_config.scan_period_us -
+			wait_time = scan_period_us -
 				(get_time().val - start.val);
 
 			if (wait_time < keyscan_config.min_post_scan_delay_us)
@@ -680,7 +858,8 @@ static int command_ksstate(int argc, char **argv)
 
 	print_state(debounced_state, "debounced ");
 	print_state(prev_state, "prev      ");
-	print_state(debouncing, "debouncing");
+	print_state(debouncing_down, "debounc dn");
+	print_state(debouncing_up, "debounc up");
 
 	ccprintf("Keyboard scan disable mask: 0x%08x\n",
 		 disable_scanning_mask);
@@ -15,58 +15,97 @@
 #define COSINE_LUT_SIZE		((180 / COSINE_LUT_INCR_DEG) + 1)
 
 /* Lookup table for the value of cosine from 0 degrees to 180 degrees. */
-static const float cos_lut[] = {
-	 1.00000,  0.99619,  0.98481,  0.96593,  0.93969,
-	 0.90631,  0.86603,  0.81915,  0.76604,  0.70711,
-	 0.64279,  0.57358,  0.50000,  0.42262,  0.34202,
-	 0.25882,  0.17365,  0.08716,  0.00000, -0.08716,
-	-0.17365, -0.25882, -0.34202, -0.42262, -0.50000,
-	-0.57358, -0.64279, -0.70711, -0.76604, -0.81915,
-	-0.86603, -0.90631, -0.93969, -0.96593, -0.98481,
-	-0.99619, -1.00000,
+static const fp_t cos_lut[] = {
+	FLOAT_TO_FP( 1.00000), FLOAT_TO_FP( 0.99619), FLOAT_TO_FP( 0.98481),
+	FLOAT_TO_FP( 0.96593), FLOAT_TO_FP( 0.93969), FLOAT_TO_FP( 0.90631),
+	FLOAT_TO_FP( 0.86603), FLOAT_TO_FP( 0.81915), FLOAT_TO_FP( 0.76604),
+	FLOAT_TO_FP( 0.70711), FLOAT_TO_FP( 0.64279), FLOAT_TO_FP( 0.57358),
+	FLOAT_TO_FP( 0.50000), FLOAT_TO_FP( 0.42262), FLOAT_TO_FP( 0.34202),
+	FLOAT_TO_FP( 0.25882), FLOAT_TO_FP( 0.17365), FLOAT_TO_FP( 0.08716),
+	FLOAT_TO_FP( 0.00000), FLOAT_TO_FP(-0.08716), FLOAT_TO_FP(-0.17365),
+	FLOAT_TO_FP(-0.25882), FLOAT_TO_FP(-0.34202), FLOAT_TO_FP(-0.42262),
+	FLOAT_TO_FP(-0.50000), FLOAT_TO_FP(-0.57358), FLOAT_TO_FP(-0.64279),
+	FLOAT_TO_FP(-0.70711), FLOAT_TO_FP(-0.76604), FLOAT_TO_FP(-0.81915),
+	FLOAT_TO_FP(-0.86603), FLOAT_TO_FP(-0.90631), FLOAT_TO_FP(-0.93969),
+	FLOAT_TO_FP(-0.96593), FLOAT_TO_FP(-0.98481), FLOAT_TO_FP(-0.99619),
+	FLOAT_TO_FP(-1.00000),
 };
 BUILD_ASSERT(ARRAY_SIZE(cos_lut) == COSINE_LUT_SIZE);
 
 
-float arc_cos(float x)
+fp_t arc_cos(fp_t x)
 {
-	int i;
+	int lo = 0, hi = COSINE_LUT_SIZE - 1, mid;
 
 	/* Cap x if out of range. */
-	if (x < -1.0)
-		x = -1.0;
-	else if (x > 1.0)
-		x = 1.0;
+	if (x < FLOAT_TO_FP(-1.0))
+		x = FLOAT_TO_FP(-1.0);
+	else if (x > FLOAT_TO_FP(1.0))
+		x = FLOAT_TO_FP(1.0);
 
 	/*
-	 * Increment through lookup table to find index and then linearly
-	 * interpolate for precision.
+	 * Binary search the lookup table, which is decreasing, for the entries
+	 * either side of x, so that cos_lut[lo] >= x >= cos_lut[hi]. Then
+	 * linearly interpolate for precision.
 	 */
-	/* TODO(crosbug.com/p/25600): Optimize with binary search. */
-	for (i = 0; i < COSINE_LUT_SIZE-1; i++)
-		if (x >= cos_lut[i+1])
-			return COSINE_LUT_INCR_DEG *
-			(i + (cos_lut[i] - x) / (cos_lut[i] - cos_lut[i+1]));
-
-	/*
-	 * Shouldn't be possible to get here because inputs are clipped to
-	 * [-1, 1] and the cos_lut[] table goes over the same range. If we
-	 * are here, throw an assert.
-	 */
-	ASSERT(0);
+	while (hi - lo > 1) {
+		mid = (lo + hi) / 2;
+		if (x > cos_lut[mid])
+			hi = mid;
+		else
+			lo = mid;
+	}
+
+	return INT_TO_FP(COSINE_LUT_INCR_DEG * lo) +
+		fp_div(fp_mul(INT_TO_FP(COSINE_LUT_INCR_DEG), cos_lut[lo] - x),
+		       cos_lut[lo] - cos_lut[hi]);
+}
 
-	return 0;
+uint32_t int_sqrt(uint64_t x)
+{
+	uint64_t root = 0;
+	uint64_t bit = 1ULL << 62;
+
+	/* Start from the highest power of four <= x. */
+	while (bit > x)
+		bit >>= 2;
+
+	/* Work out one bit of the root for each pair of bits of x. */
+	while (bit) {
+		if (x >= root + bit) {
+			x -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return root;
 }
 
 int vector_magnitude(const vector_3_t v)
 {
-	return sqrtf(SQ(v[0]) + SQ(v[1]) + SQ(v[2]));
+	return int_sqrt(SQ(v[0]) + SQ(v[1]) + SQ(v[2]));
+}
+
+fp_t cosine_of_dot_product(int64_t dotproduct, uint64_t sq_mag)
+{
+	/* Check for divide by 0 although extremely unlikely. */
+	if (!sq_mag)
+		return 0;
+
+#ifdef CONFIG_FPU
+	return (float)dotproduct / sqrtf((float)sq_mag);
+#else
+	return (fp_t)((dotproduct * (1 << FP_BITS)) / int_sqrt(sq_mag));
+#endif
 }
 
-float cosine_of_angle_diff(const vector_3_t v1, const vector_3_t v2)
+fp_t cosine_of_angle_diff(const vector_3_t v1, const vector_3_t v2)
 {
 	int dotproduct;
-	float denominator;
+	uint64_t sq_mag;
 
 	/*
 	 * Angle between two vectors is acos(A dot B / |A|*|B|). To return
@@ -75,31 +114,34 @@ float cosine_of_angle_diff(const vector_3_t v1, const vector_3_t v2)
 
 	dotproduct = v1[0] * v2[0] + v1[1] * v2[1] + v1[2] * v2[2];
 
-	denominator = vector_magnitude(v1) * vector_magnitude(v2);
+	/* |A|*|B| is sqrt(|A|^2 * |B|^2), which needs only one sqrt. */
+	sq_mag = (uint64_t)(SQ(v1[0]) + SQ(v1[1]) + SQ(v1[2])) *
+		(SQ(v2[0]) + SQ(v2[1]) + SQ(v2[2]));
 
-	/* Check for divide by 0 although extremely unlikely. */
-	if (ABS(denominator) < 0.01F)
-		return 0.0;
-
-	return (float)dotproduct / (denominator);
+	return cosine_of_dot_product(dotproduct, sq_mag);
 }
 
 void rotate(const vector_3_t v, const matrix_3x3_t (* const R),
 		vector_3_t *res)
 {
-	(*res)[0] =	v[0] * (*R)[0][0] +
-			v[1] * (*R)[1][0] +
-			v[2] * (*R)[2][0];
-	(*res)[1] =	v[0] * (*R)[0][1] +
-			v[1] * (*R)[1][1] +
-			v[2] * (*R)[2][1];
-	(*res)[2] =	v[0] * (*R)[0][2] +
-			v[1] * (*R)[1][2] +
-			v[2] * (*R)[2][2];
+	fp_t x = INT_TO_FP(v[0]), y = INT_TO_FP(v[1]), z = INT_TO_FP(v[2]);
+
+	/* v is read up front, so res may point at v. */
+	(*res)[0] = FP_TO_INT(fp_mul(x, (*R)[0][0]) + fp_mul(y, (*R)[1][0]) +
+			      fp_mul(z, (*R)[2][0]));
+	(*res)[1] = FP_TO_INT(fp_mul(x, (*R)[0][1]) + fp_mul(y, (*R)[1][1]) +
+			      fp_mul(z, (*R)[2][1]));
+	(*res)[2] = FP_TO_INT(fp_mul(x, (*R)[0][2]) + fp_mul(y, (*R)[1][2]) +
+			      fp_mul(z, (*R)[2][2]));
 }
 
 #ifdef CONFIG_ACCEL_CALIBRATE
 
+/* Calibration solves for rotation matrices in floating point. */
+#ifndef CONFIG_FPU
+#error "CONFIG_ACCEL_CALIBRATE requires CONFIG_FPU"
+#endif
+
 void matrix_multiply(matrix_3x3_t *m1, matrix_3x3_t *m2, matrix_3x3_t *res)
 {
 	(*res)[0][0] = (*m1)[0][0] * (*m2)[0][0] + (*m1)[0][1] * (*m2)[1][0] +
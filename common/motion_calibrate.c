@@ -151,6 +151,8 @@ static int calibrate_orientation(int type)
 
 	if (ret != EC_SUCCESS)
 		ccprintf("Failed to find rotation matrix.\n");
+	else
+		motion_orientation_changed();
 
 	return ret;
 }
@@ -201,6 +203,7 @@ static int calibrate_hinge(void)
 		}
 	}
 
+	motion_orientation_changed();
 	return EC_SUCCESS;
 }
 
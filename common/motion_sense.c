@@ -6,13 +6,17 @@
 /* Motion sense module to read from various motion sensors. */
 
 #include "accelerometer.h"
+#include "atomic.h"
 #include "common.h"
 #include "console.h"
+#include "gpio.h"
 #include "hooks.h"
 #include "host_command.h"
+#include "keyboard_mkbp.h"
 #include "lid_angle.h"
 #include "math_util.h"
 #include "motion_sense.h"
+#include "queue.h"
 #include "timer.h"
 #include "task.h"
 #include "util.h"
@@ -24,12 +28,26 @@
 /* Minimum time in between running motion sense task loop. */
 #define MIN_MOTION_SENSE_WAIT_TIME (1 * MSEC)
 
-/* Current acceleration vectors and current lid angle. */
-static vector_3_t acc_lid_raw, acc_lid, acc_base;
-static vector_3_t acc_lid_host, acc_base_host;
-static float lid_angle_deg;
+/* Accelerometers used to calculate the lid angle, if the board has them. */
+static struct motion_sensor_t *sensor_base, *sensor_lid;
+
+/* Current lid angle, after smoothing. */
+static fp_t lid_angle_deg;
 static int lid_angle_is_reliable;
 
+/*
+ * Each new lid angle moves the smoothed angle 1/2^LID_ANGLE_FILTER_SHIFT of
+ * the way towards it. Moves of more than LID_ANGLE_FILTER_SNAP_DEG are
+ * followed at once, so the filter does not lag when the lid is moved.
+ */
+#define LID_ANGLE_FILTER_SHIFT 2
+#define LID_ANGLE_FILTER_SNAP_DEG 20
+
+/* Hinge constants, precomputed by motion_orientation_changed(). */
+static int hinge_sq_mag;
+static vector_3_t hinge_rot_axis;
+#define HINGE_ROT_AXIS_SCALE 1024
+
 /* Bounds for setting the sensor polling interval. */
 #define MIN_POLLING_INTERVAL_MS 5
 #define MAX_POLLING_INTERVAL_MS 1000
@@ -44,9 +62,12 @@ static const int accel_interval_ap_suspend_ms = 100;
  * efficiency, value is given unit-less, so if you want the threshold to be
  * at 15 degrees, the value would be cos(15 deg) = 0.96593.
  */
-#define HINGE_ALIGNED_WITH_GRAVITY_THRESHOLD 0.96593F
+#define HINGE_ALIGNED_WITH_GRAVITY_THRESHOLD FLOAT_TO_FP(0.96593)
 
-/* Sampling interval for measuring acceleration and calculating lid angle. */
+/*
+ * Sampling interval for sensors which follow the module rate, which includes
+ * the accelerometers used to calculate the lid angle.
+ */
 static int accel_interval_ms;
 
 #ifdef CONFIG_CMD_LID_ANGLE
@@ -61,6 +82,153 @@ enum {
 /* Pointer to constant acceleration orientation data. */
 const struct accel_orientation * const p_acc_orient = &acc_orient;
 
+#ifdef CONFIG_ACCEL_HW_FIFO
+/* Task event for a hardware FIFO watermark interrupt. */
+#define TASK_EVENT_MOTION_HW_FIFO TASK_EVENT_CUSTOM(1)
+
+/* Bit i is set when motion_sensors[i] has interrupted to be drained. */
+static uint32_t hw_fifo_pending;
+
+/* Samples of one drain, only touched by the motion sense task. */
+static vector_3_t hw_fifo_buf[ACCEL_HW_FIFO_MAX];
+#endif
+
+/**
+ * Find the first present sensor of a given type and location.
+ *
+ * @return the sensor, or NULL if the board has none.
+ */
+static struct motion_sensor_t *motion_sense_find(enum motionsensor_type type,
+		enum motionsensor_location location)
+{
+	int i;
+
+	for (i = 0; i < motion_sensor_count; i++) {
+		struct motion_sensor_t *s = &motion_sensors[i];
+
+		if (s->present && s->type == type && s->location == location)
+			return s;
+	}
+
+	return NULL;
+}
+
+/**
+ * Map a host sensor ID (enum motionsensor_id) to a sensor in the table.
+ *
+ * @return the sensor, or NULL if the board has no such sensor.
+ */
+static struct motion_sensor_t *host_sensor_id_to_motion_sensor(int host_id)
+{
+	switch (host_id) {
+	case EC_MOTION_SENSOR_ACCEL_BASE:
+		return motion_sense_find(MOTIONSENSE_TYPE_ACCEL,
+					 MOTIONSENSE_LOC_BASE);
+	case EC_MOTION_SENSOR_ACCEL_LID:
+		return motion_sense_find(MOTIONSENSE_TYPE_ACCEL,
+					 MOTIONSENSE_LOC_LID);
+	case EC_MOTION_SENSOR_GYRO:
+		return motion_sense_find(MOTIONSENSE_TYPE_GYRO,
+					 MOTIONSENSE_LOC_BASE);
+	}
+
+	/* If no match then the EC currently doesn't support ID received. */
+	return NULL;
+}
+
+#ifdef CONFIG_ACCEL_FIFO
+/**
+ * Map a sensor in the table to its host sensor ID (enum motionsensor_id).
+ */
+static int motion_sensor_to_host_id(const struct motion_sensor_t *s)
+{
+	if (s->type == MOTIONSENSE_TYPE_GYRO)
+		return EC_MOTION_SENSOR_GYRO;
+
+	return s->location == MOTIONSENSE_LOC_LID ?
+		EC_MOTION_SENSOR_ACCEL_LID : EC_MOTION_SENSOR_ACCEL_BASE;
+}
+
+/* Samples queued for the host; the queue holds one less than its buffer. */
+static struct ec_response_motion_sensor_data fifo_buf[CONFIG_ACCEL_FIFO + 1];
+static struct queue motion_fifo = {
+	.buf_bytes  = sizeof(fifo_buf),
+	.unit_bytes = sizeof(struct ec_response_motion_sensor_data),
+	.buf        = (uint8_t *)fifo_buf,
+};
+static struct mutex fifo_mutex;
+static int fifo_watermark = (CONFIG_ACCEL_FIFO + 1) / 2;
+static uint16_t fifo_lost;
+/* Set once the host has been told about the watermark, until it reads. */
+static int fifo_host_notified;
+/* Host sensor IDs of the sensors feeding the FIFO. */
+static uint32_t fifo_sensor_mask;
+
+/**
+ * Queue a sample for the host, dropping the oldest one if the FIFO is full.
+ *
+ * @param sensor_num	Host sensor ID (enum motionsensor_id)
+ * @param v		Sample, in the host reference frame
+ * @param t		Time the sample was taken
+ */
+static void motion_fifo_add(int sensor_num, const vector_3_t v, uint32_t t)
+{
+	struct ec_response_motion_sensor_data d;
+	int notify = 0;
+
+	d.sensor_num = sensor_num;
+	d.reserved = 0;
+	d.timestamp = t;
+	d.data[X] = v[X];
+	d.data[Y] = v[Y];
+	d.data[Z] = v[Z];
+
+	mutex_lock(&fifo_mutex);
+	if (!queue_has_space(&motion_fifo, 1)) {
+		struct ec_response_motion_sensor_data dropped;
+
+		queue_remove_unit(&motion_fifo, &dropped);
+		if (fifo_lost < 0xffff)
+			fifo_lost++;
+	}
+	queue_add_units(&motion_fifo, &d, 1);
+	if (!fifo_host_notified &&
+	    queue_count(&motion_fifo) >= fifo_watermark) {
+		fifo_host_notified = 1;
+		notify = 1;
+	}
+	mutex_unlock(&fifo_mutex);
+
+	if (notify) {
+#ifdef CONFIG_KEYBOARD_PROTOCOL_MKBP
+		mkbp_fifo_add(EC_MKBP_EVENT_SENSOR, &fifo_sensor_mask,
+			      sizeof(fifo_sensor_mask));
+#endif
+		host_set_single_event(EC_HOST_EVENT_MOTION_SENSE_FIFO);
+	}
+}
+#endif
+
+void motion_orientation_changed(void)
+{
+	const matrix_3x3_t *R = &p_acc_orient->rot_hinge_90;
+	const int *h = p_acc_orient->hinge_axis;
+
+	hinge_sq_mag = SQ(h[X]) + SQ(h[Y]) + SQ(h[Z]);
+
+	/*
+	 * The axis rot_hinge_90 turns about, with its sign, is twice the
+	 * skew-symmetric part of the matrix. Only its direction matters, so
+	 * keep it as a scaled integer vector.
+	 */
+	hinge_rot_axis[X] = FP_TO_INT(((*R)[Y][Z] - (*R)[Z][Y]) *
+				      HINGE_ROT_AXIS_SCALE);
+	hinge_rot_axis[Y] = FP_TO_INT(((*R)[Z][X] - (*R)[X][Z]) *
+				      HINGE_ROT_AXIS_SCALE);
+	hinge_rot_axis[Z] = FP_TO_INT(((*R)[X][Y] - (*R)[Y][X]) *
+				      HINGE_ROT_AXIS_SCALE);
+}
+
 /**
  * Calculate the lid angle using two acceleration vectors, one recorded in
  * the base and one in the lid.
@@ -71,23 +239,35 @@ const struct accel_orientation * const p_acc_orient = &acc_orient;
  *
  * @return flag representing if resulting lid angle calculation is reliable.
  */
-static int calculate_lid_angle(vector_3_t base, vector_3_t lid,
-		float *lid_angle)
+static int calculate_lid_angle(const vector_3_t base, const vector_3_t lid,
+		fp_t *lid_angle)
 {
-	vector_3_t v;
-	float ang_lid_to_base, ang_lid_90, ang_lid_270;
-	float lid_to_base, base_to_hinge;
+	const int *h = p_acc_orient->hinge_axis;
+	const int *k = hinge_rot_axis;
+	fp_t ang_lid_to_base;
+	fp_t lid_to_base, base_to_hinge;
+	int64_t triple;
+	uint64_t sq_base, sq_lid;
 	int reliable = 1;
 
 	/*
 	 * The angle between lid and base is:
 	 * acos((cad(base, lid) - cad(base, hinge)^2) /(1 - cad(base, hinge)^2))
-	 * where cad() is the cosine_of_angle_diff() function.
+	 * where cad() is the cosine of the angle between two vectors.
+	 *
+	 * Both cosines share |base|, so find the squared magnitudes once.
 	 *
 	 * Make sure to check for divide by 0.
 	 */
-	lid_to_base = cosine_of_angle_diff(base, lid);
-	base_to_hinge = cosine_of_angle_diff(base, p_acc_orient->hinge_axis);
+	sq_base = SQ(base[X]) + SQ(base[Y]) + SQ(base[Z]);
+	sq_lid = SQ(lid[X]) + SQ(lid[Y]) + SQ(lid[Z]);
+
+	lid_to_base = cosine_of_dot_product(
+		base[X] * lid[X] + base[Y] * lid[Y] + base[Z] * lid[Z],
+		sq_base * sq_lid);
+	base_to_hinge = cosine_of_dot_product(
+		base[X] * h[X] + base[Y] * h[Y] + base[Z] * h[Z],
+		sq_base * hinge_sq_mag);
 
 	/*
 	 * If hinge aligns too closely with gravity, then result may be
@@ -96,51 +276,73 @@ static int calculate_lid_angle(vector_3_t base, vector_3_t lid,
 	if (ABS(base_to_hinge) > HINGE_ALIGNED_WITH_GRAVITY_THRESHOLD)
 		reliable = 0;
 
-	base_to_hinge = SQ(base_to_hinge);
+	base_to_hinge = fp_mul(base_to_hinge, base_to_hinge);
 
 	/* Check divide by 0. */
-	if (ABS(1.0F - base_to_hinge) < 0.01F) {
-		*lid_angle = 0.0;
+	if (ABS(FLOAT_TO_FP(1.0) - base_to_hinge) < FLOAT_TO_FP(0.01)) {
+		*lid_angle = 0;
 		return 0;
 	}
 
-	ang_lid_to_base = arc_cos(
-			(lid_to_base - base_to_hinge) / (1 - base_to_hinge));
+	ang_lid_to_base = arc_cos(fp_div(lid_to_base - base_to_hinge,
+					 FLOAT_TO_FP(1.0) - base_to_hinge));
 
 	/*
 	 * The previous calculation actually has two solutions, a positive and
-	 * a negative solution. To figure out the sign of the answer, calculate
-	 * the angle between the actual lid angle and the estimated vector if
-	 * the lid were open to 90 deg, ang_lid_90. Also calculate the angle
-	 * between the actual lid angle and the estimated vector if the lid
-	 * were open to 270 deg, ang_lid_270. The smaller of the two angles
-	 * represents which one is closer. If the lid is closer to the
-	 * estimated 270 degree vector then the result is negative, otherwise
-	 * it is positive.
+	 * a negative solution. The lid is on the positive side if turning the
+	 * base vector 90 degrees about the hinge brings it closer to the lid
+	 * than turning it 270 degrees does. Writing the 90 degree turn about
+	 * the unit axis k as (base.k)k + k x base, that reduces to the sign
+	 * of the triple product (k x base) . lid.
 	 */
-	rotate(base, &p_acc_orient->rot_hinge_90, &v);
-	ang_lid_90 = cosine_of_angle_diff(v, lid);
-	rotate(v, &p_acc_orient->rot_hinge_180, &v);
-	ang_lid_270 = cosine_of_angle_diff(v, lid);
-
-	/*
-	 * Note that ang_lid_90 and ang_lid_270 are not in degrees, because
-	 * the arc_cos() was never performed. But, since arc_cos() is
-	 * monotonically decreasing, we can do this comparison without ever
-	 * taking arc_cos(). But, since the function is monotonically
-	 * decreasing, the logic of this comparison is reversed.
-	 */
-	if (ang_lid_270 > ang_lid_90)
+	triple = (int64_t)(k[Y] * base[Z] - k[Z] * base[Y]) * lid[X] +
+		 (int64_t)(k[Z] * base[X] - k[X] * base[Z]) * lid[Y] +
+		 (int64_t)(k[X] * base[Y] - k[Y] * base[X]) * lid[Z];
+	if (triple < 0)
 		ang_lid_to_base = -ang_lid_to_base;
 
 	/* Place lid angle between 0 and 360 degrees. */
 	if (ang_lid_to_base < 0)
-		ang_lid_to_base += 360;
+		ang_lid_to_base += INT_TO_FP(360);
 
 	*lid_angle = ang_lid_to_base;
 	return reliable;
 }
 
+/**
+ * Fold a new lid angle calculation into the smoothed lid angle.
+ *
+ * @param angle Lid angle just calculated
+ * @param reliable Whether that calculation is reliable
+ */
+static void update_lid_angle(fp_t angle, int reliable)
+{
+	fp_t diff = angle - lid_angle_deg;
+
+	/* Take the shorter way around the circle. */
+	if (diff > INT_TO_FP(180))
+		diff -= INT_TO_FP(360);
+	else if (diff < INT_TO_FP(-180))
+		diff += INT_TO_FP(360);
+
+	/*
+	 * Start afresh after an unreliable reading, and follow large moves
+	 * immediately so that only sensor noise gets smoothed.
+	 */
+	if (!reliable || !lid_angle_is_reliable ||
+	    ABS(diff) > INT_TO_FP(LID_ANGLE_FILTER_SNAP_DEG)) {
+		lid_angle_deg = angle;
+	} else {
+		lid_angle_deg += diff / (1 << LID_ANGLE_FILTER_SHIFT);
+		if (lid_angle_deg < 0)
+			lid_angle_deg += INT_TO_FP(360);
+		else if (lid_angle_deg >= INT_TO_FP(360))
+			lid_angle_deg -= INT_TO_FP(360);
+	}
+
+	lid_angle_is_reliable = reliable;
+}
+
 int motion_get_lid_angle(void)
 {
 	if (lid_angle_is_reliable)
@@ -148,41 +350,148 @@ int motion_get_lid_angle(void)
 		 * Round to nearest int by adding 0.5. Note, only works because
 		 * lid angle is known to be positive.
 		 */
-		return (int)(lid_angle_deg + 0.5F);
+		return FP_TO_INT(lid_angle_deg + FLOAT_TO_FP(0.5));
 	else
-		return (int)LID_ANGLE_UNRELIABLE;
+		return LID_ANGLE_UNRELIABLE;
 }
 
 #ifdef CONFIG_ACCEL_CALIBRATE
 void motion_get_accel_lid(vector_3_t *v, int adjusted)
 {
-	memcpy(v, adjusted ? &acc_lid : &acc_lid_raw, sizeof(vector_3_t));
+	if (sensor_lid)
+		memcpy(v, adjusted ? &sensor_lid->xyz : &sensor_lid->raw_xyz,
+		       sizeof(vector_3_t));
+	else
+		memset(v, 0, sizeof(vector_3_t));
 }
 
 void motion_get_accel_base(vector_3_t *v)
 {
-	memcpy(v, &acc_base, sizeof(vector_3_t));
+	if (sensor_base)
+		memcpy(v, &sensor_base->xyz, sizeof(vector_3_t));
+	else
+		memset(v, 0, sizeof(vector_3_t));
 }
 #endif
 
+/**
+ * Set the module sampling interval. The task is woken so that sensors which
+ * follow the module rate are resampled and rescheduled right away.
+ */
+static void set_module_interval(int interval_ms)
+{
+	accel_interval_ms = interval_ms;
+	task_wake(TASK_ID_MOTIONSENSE);
+}
+
 static void set_ap_suspend_polling(void)
 {
-	accel_interval_ms = accel_interval_ap_suspend_ms;
+	set_module_interval(accel_interval_ap_suspend_ms);
 }
 DECLARE_HOOK(HOOK_CHIPSET_SUSPEND, set_ap_suspend_polling, HOOK_PRIO_DEFAULT);
 
 static void set_ap_on_polling(void)
 {
-	accel_interval_ms = accel_interval_ap_on_ms;
+	set_module_interval(accel_interval_ap_on_ms);
 }
 DECLARE_HOOK(HOOK_CHIPSET_RESUME, set_ap_on_polling, HOOK_PRIO_DEFAULT);
 
+/**
+ * Rotate the latest raw sample of a sensor into the base and standard
+ * reference frames, and queue it for the host.
+ *
+ * @param s	Sensor the sample came from
+ * @param ts	Time of the sample
+ */
+static void motion_sense_process(struct motion_sensor_t *s, timestamp_t ts)
+{
+	if (s->rot)
+		rotate(s->raw_xyz, s->rot, &s->xyz);
+	else
+		memcpy(s->xyz, s->raw_xyz, sizeof(vector_3_t));
+
+	rotate(s->xyz, &p_acc_orient->rot_standard_ref, &s->host_xyz);
+
+#ifdef CONFIG_ACCEL_FIFO
+	motion_fifo_add(motion_sensor_to_host_id(s), s->host_xyz, ts.le.lo);
+#endif
+}
+
+#ifdef CONFIG_ACCEL_HW_FIFO
+/**
+ * Drain a sensor's hardware FIFO in one burst.
+ *
+ * @param s	Sensor to drain
+ * @param ts	Time of the drain, taken as the time of the newest sample
+ */
+static void motion_sense_drain(struct motion_sensor_t *s, timestamp_t ts)
+{
+	timestamp_t t;
+	int i, n, rate, period_us = 0;
+
+	if (s->drv->read_fifo(s, hw_fifo_buf, ARRAY_SIZE(hw_fifo_buf), &n) !=
+	    EC_SUCCESS)
+		return;
+
+	/* Older samples are one output data period apart. */
+	if (s->drv->get_data_rate(s, &rate) == EC_SUCCESS && rate > 0)
+		period_us = 1000000000 / rate;
+
+	for (i = 0; i < n; i++) {
+		t.val = ts.val - (uint64_t)(n - 1 - i) * period_us;
+		memcpy(s->raw_xyz, hw_fifo_buf[i], sizeof(vector_3_t));
+		motion_sense_process(s, t);
+	}
+}
+#endif
+
+/**
+ * Take a sample from a sensor and rotate it into the base and standard
+ * reference frames. A sensor using its hardware FIFO is drained instead.
+ *
+ * @param s	Sensor to read
+ * @param ts	Time of the sample
+ */
+static void motion_sense_read(struct motion_sensor_t *s, timestamp_t ts)
+{
+#ifdef CONFIG_ACCEL_HW_FIFO
+	if (s->hw_fifo) {
+		motion_sense_drain(s, ts);
+		return;
+	}
+#endif
+
+	s->drv->read(s, &s->raw_xyz[X], &s->raw_xyz[Y], &s->raw_xyz[Z]);
+	motion_sense_process(s, ts);
+}
+
+/**
+ * Interval until a sensor should next be read, in ms.
+ */
+static int motion_sense_interval_ms(const struct motion_sensor_t *s)
+{
+#ifdef CONFIG_ACCEL_HW_FIFO
+	/*
+	 * Sensors with a hardware FIFO interrupt when they need draining, so
+	 * only drain them slowly in case an interrupt is missed.
+	 */
+	if (s->hw_fifo)
+		return MAX_POLLING_INTERVAL_MS;
+#endif
+	return s->poll_ms ? s->poll_ms : accel_interval_ms;
+}
 
 void motion_sense_task(void)
 {
 	static timestamp_t ts0, ts1;
+	struct motion_sensor_t *s;
+	uint32_t event = TASK_EVENT_WAKE;
 	int wait_us;
-	int ret;
+	int i, present = 0;
+	int updated;
+	uint32_t pending = 0;
+	int reliable;
+	fp_t angle;
 	uint8_t *lpc_status;
 	uint16_t *lpc_data;
 	int sample_id = 0;
@@ -190,116 +499,155 @@ void motion_sense_task(void)
 	lpc_status = host_get_memmap(EC_MEMMAP_ACC_STATUS);
 	lpc_data = (uint16_t *)host_get_memmap(EC_MEMMAP_ACC_DATA);
 
-	/*
-	 * TODO(crosbug.com/p/27320): The motion_sense task currently assumes
-	 * one configuration of motion sensors. Namely, it assumes there is
-	 * one accel in the base, one in the lid, and they both use the same
-	 * driver. Eventually, all of these assumptions will have to be removed
-	 * when we have other configurations of motion sensors.
-	 */
+	/* Initialize sensors and set their default parameters. */
+	for (i = 0; i < motion_sensor_count; i++) {
+		s = &motion_sensors[i];
+
+		if (s->drv->init(s) != EC_SUCCESS) {
+			CPRINTS("%s init failed", s->name);
+			continue;
+		}
 
-	/* Initialize accelerometers. */
-	ret = accel_init(ACCEL_LID);
-	ret |= accel_init(ACCEL_BASE);
+		s->drv->set_range(s, s->default_range, 1);
+		s->drv->set_resolution(s, 12, 1);
+		s->drv->set_data_rate(s, s->default_odr, 1);
+		s->present = 1;
+		present++;
+
+#ifdef CONFIG_ACCEL_HW_FIFO
+		if (s->hw_fifo_watermark && s->drv->set_fifo_watermark &&
+		    s->drv->set_fifo_watermark(s, s->hw_fifo_watermark) ==
+		    EC_SUCCESS) {
+			s->hw_fifo = 1;
+			gpio_enable_interrupt(s->int_signal);
+		}
+#endif
+	}
 
-	/* If accelerometers do not initialize, then end task. */
-	if (ret != EC_SUCCESS) {
-		CPRINTS("Accel init failed; stopping MS");
+	/* If no sensor initializes, then end task. */
+	if (!present) {
+		CPRINTS("Motion sensor init failed; stopping MS");
 		return;
 	}
 
+	sensor_base = motion_sense_find(MOTIONSENSE_TYPE_ACCEL,
+					MOTIONSENSE_LOC_BASE);
+	sensor_lid = motion_sense_find(MOTIONSENSE_TYPE_ACCEL,
+				       MOTIONSENSE_LOC_LID);
+	motion_orientation_changed();
+#ifdef CONFIG_ACCEL_FIFO
+	for (i = 0; i < motion_sensor_count; i++)
+		if (motion_sensors[i].present)
+			fifo_sensor_mask |=
+				1 << motion_sensor_to_host_id(&motion_sensors[i]);
+#endif
+
 	/* Initialize sampling interval. */
 	accel_interval_ms = accel_interval_ap_suspend_ms;
 
-	/* Set default accelerometer parameters. */
-	accel_set_range(ACCEL_LID,  2, 1);
-	accel_set_range(ACCEL_BASE, 2, 1);
-	accel_set_resolution(ACCEL_LID,  12, 1);
-	accel_set_resolution(ACCEL_BASE, 12, 1);
-	accel_set_datarate(ACCEL_LID,  100000, 1);
-	accel_set_datarate(ACCEL_BASE, 100000, 1);
-
 	/* Write to status byte to represent that accelerometers are present. */
 	*lpc_status |= EC_MEMMAP_ACC_STATUS_PRESENCE_BIT;
 
 	while (1) {
 		ts0 = get_time();
-
-		/* Read all accelerations. */
-		accel_read(ACCEL_LID, &acc_lid_raw[X], &acc_lid_raw[Y],
-			   &acc_lid_raw[Z]);
-		accel_read(ACCEL_BASE, &acc_base[X], &acc_base[Y],
-			   &acc_base[Z]);
+		updated = 0;
+#ifdef CONFIG_ACCEL_HW_FIFO
+		pending = atomic_read_clear(&hw_fifo_pending);
+#endif
 
 		/*
-		 * Rotate the lid vector so the reference frame aligns with
-		 * the base sensor.
+		 * Read each sensor whose deadline has passed, or which has
+		 * interrupted to be drained. A wake from another task (a host
+		 * command, a rate change) reads them all.
 		 */
-		rotate(acc_lid_raw, &p_acc_orient->rot_align, &acc_lid);
-
-		/* Calculate angle of lid. */
-		lid_angle_is_reliable = calculate_lid_angle(acc_base, acc_lid,
-				&lid_angle_deg);
-
-		/* TODO(crosbug.com/p/25597): Add filter to smooth lid angle. */
-
-		/* Rotate accels into standard reference frame for the host. */
-		rotate(acc_base, &p_acc_orient->rot_standard_ref,
-				&acc_base_host);
-		rotate(acc_lid, &p_acc_orient->rot_standard_ref,
-				&acc_lid_host);
+		for (i = 0; i < motion_sensor_count; i++) {
+			s = &motion_sensors[i];
+			if (!s->present)
+				continue;
+			if (!(event & TASK_EVENT_WAKE) &&
+			    !(pending & (1 << i)) &&
+			    ts0.val < s->next_poll.val)
+				continue;
+
+			motion_sense_read(s, ts0);
+			s->next_poll.val = ts0.val +
+				motion_sense_interval_ms(s) * MSEC;
+			updated = 1;
+		}
 
-		/*
-		 * Set the busy bit before writing the sensor data. Increment
-		 * the counter and clear the busy bit after writing the sensor
-		 * data. On the host side, the host needs to make sure the busy
-		 * bit is not set and that the counter remains the same before
-		 * and after reading the data.
-		 */
-		*lpc_status |= EC_MEMMAP_ACC_STATUS_BUSY_BIT;
+		if (updated) {
+			/* Calculate angle of lid. */
+			if (sensor_base && sensor_lid) {
+				reliable = calculate_lid_angle(sensor_base->xyz,
+							       sensor_lid->xyz,
+							       &angle);
+				update_lid_angle(angle, reliable);
+			} else {
+				lid_angle_is_reliable = 0;
+			}
 
-		/*
-		 * Copy sensor data to shared memory. Note that this code
-		 * assumes little endian, which is what the host expects. Also,
-		 * note that we share the lid angle calculation with host only
-		 * for debugging purposes. The EC lid angle is an approximation
-		 * with un-calibrated accels. The AP calculates a separate,
-		 * more accurate lid angle.
-		 */
-		lpc_data[0] = motion_get_lid_angle();
-		lpc_data[1] = acc_base_host[X];
-		lpc_data[2] = acc_base_host[Y];
-		lpc_data[3] = acc_base_host[Z];
-		lpc_data[4] = acc_lid_host[X];
-		lpc_data[5] = acc_lid_host[Y];
-		lpc_data[6] = acc_lid_host[Z];
+			/*
+			 * Set the busy bit before writing the sensor data.
+			 * Increment the counter and clear the busy bit after
+			 * writing the sensor data. On the host side, the host
+			 * needs to make sure the busy bit is not set and that
+			 * the counter remains the same before and after
+			 * reading the data.
+			 */
+			*lpc_status |= EC_MEMMAP_ACC_STATUS_BUSY_BIT;
+
+			/*
+			 * Copy sensor data to shared memory. Note that this
+			 * code assumes little endian, which is what the host
+			 * expects. Also, note that we share the lid angle
+			 * calculation with host only for debugging purposes.
+			 * The EC lid angle is an approximation with
+			 * un-calibrated accels. The AP calculates a separate,
+			 * more accurate lid angle.
+			 */
+			lpc_data[0] = motion_get_lid_angle();
+			for (i = 0; i < 6; i++) {
+				s = i < 3 ? sensor_base : sensor_lid;
+				lpc_data[1 + i] = s ? s->host_xyz[i % 3] : 0;
+			}
 
-		/*
-		 * Increment sample id and clear busy bit to signal we finished
-		 * updating data.
-		 */
-		sample_id = (sample_id + 1) &
-				EC_MEMMAP_ACC_STATUS_SAMPLE_ID_MASK;
-		*lpc_status = EC_MEMMAP_ACC_STATUS_PRESENCE_BIT | sample_id;
+			/*
+			 * Increment sample id and clear busy bit to signal we
+			 * finished updating data.
+			 */
+			sample_id = (sample_id + 1) &
+					EC_MEMMAP_ACC_STATUS_SAMPLE_ID_MASK;
+			*lpc_status = EC_MEMMAP_ACC_STATUS_PRESENCE_BIT |
+					sample_id;
 
 #ifdef CONFIG_LID_ANGLE_KEY_SCAN
-		lidangle_keyscan_update(motion_get_lid_angle());
+			lidangle_keyscan_update(motion_get_lid_angle());
 #endif
 
 #ifdef CONFIG_CMD_LID_ANGLE
-		if (accel_disp) {
-			CPRINTS("ACC base=%-5d, %-5d, %-5d  lid=%-5d, "
+			if (accel_disp && sensor_base && sensor_lid) {
+				CPRINTS("ACC base=%-5d, %-5d, %-5d  lid=%-5d, "
 					"%-5d, %-5d  a=%-6.1d r=%d",
-					acc_base[X], acc_base[Y], acc_base[Z],
-					acc_lid[X], acc_lid[Y], acc_lid[Z],
-					(int)(10*lid_angle_deg),
+					sensor_base->xyz[X],
+					sensor_base->xyz[Y],
+					sensor_base->xyz[Z],
+					sensor_lid->xyz[X],
+					sensor_lid->xyz[Y],
+					sensor_lid->xyz[Z],
+					FP_TO_INT(10 * lid_angle_deg),
 					lid_angle_is_reliable);
-		}
+			}
 #endif
+		}
 
-		/* Delay appropriately to keep sampling time consistent. */
+		/* Delay until the next sensor is due. */
 		ts1 = get_time();
-		wait_us = accel_interval_ms * MSEC - (ts1.val-ts0.val);
+		wait_us = MAX_POLLING_INTERVAL_MS * MSEC;
+		for (i = 0; i < motion_sensor_count; i++) {
+			s = &motion_sensors[i];
+			if (s->present && s->next_poll.val < ts1.val + wait_us)
+				wait_us = s->next_poll.val - ts1.val;
+		}
 
 		/*
 		 * Guarantee some minimum delay to allow other lower priority
@@ -308,12 +656,42 @@ void motion_sense_task(void)
 		if (wait_us < MIN_MOTION_SENSE_WAIT_TIME)
 			wait_us = MIN_MOTION_SENSE_WAIT_TIME;
 
-		task_wait_event(wait_us);
+		event = task_wait_event(wait_us);
 	}
 }
 
+#ifdef CONFIG_ACCEL_HW_FIFO
+/**
+ * Have the task drain the sensors whose FIFO interrupts on a signal.
+ *
+ * @return non-zero if any sensor uses the signal.
+ */
+static int hw_fifo_interrupt(enum gpio_signal signal)
+{
+	uint32_t mask = 0;
+	int i;
+
+	for (i = 0; i < motion_sensor_count; i++)
+		if (motion_sensors[i].hw_fifo &&
+		    motion_sensors[i].int_signal == signal)
+			mask |= 1 << i;
+
+	if (!mask)
+		return 0;
+
+	atomic_or(&hw_fifo_pending, mask);
+	task_set_event(TASK_ID_MOTIONSENSE, TASK_EVENT_MOTION_HW_FIFO, 0);
+	return 1;
+}
+#endif
+
 void accel_int_lid(enum gpio_signal signal)
 {
+#ifdef CONFIG_ACCEL_HW_FIFO
+	if (hw_fifo_interrupt(signal))
+		return;
+#endif
+
 	/*
 	 * Print statement is here for testing with console accelint command.
 	 * Remove print statement when interrupt is used for real.
@@ -323,6 +701,11 @@ void accel_int_lid(enum gpio_signal signal)
 
 void accel_int_base(enum gpio_signal signal)
 {
+#ifdef CONFIG_ACCEL_HW_FIFO
+	if (hw_fifo_interrupt(signal))
+		return;
+#endif
+
 	/*
 	 * Print statement is here for testing with console accelint command.
 	 * Remove print statement when interrupt is used for real.
@@ -333,81 +716,39 @@ void accel_int_base(enum gpio_signal signal)
 /*****************************************************************************/
 /* Host commands */
 
-/**
- * Temporary function to map host sensor IDs to EC sensor IDs.
- *
- * TODO(crosbug.com/p/27320): Eventually we need a board specific table
- * specifying which motion sensors are attached and which driver to use to
- * access that sensor. Once we have this, this function should be able to go
- * away.
- */
-static int host_sensor_id_to_ec_sensor_id(int host_id)
-{
-	switch (host_id) {
-	case EC_MOTION_SENSOR_ACCEL_BASE:
-		return ACCEL_BASE;
-	case EC_MOTION_SENSOR_ACCEL_LID:
-		return ACCEL_LID;
-	}
-
-	/* If no match then the EC currently doesn't support ID received. */
-	return -1;
-}
-
 static int host_cmd_motion_sense(struct host_cmd_handler_args *args)
 {
 	const struct ec_params_motion_sense *in = args->params;
 	struct ec_response_motion_sense *out = args->response;
-	int id, data;
+	const struct motion_sensor_t *s;
+	int i, data;
 
 	switch (in->cmd) {
 	case MOTIONSENSE_CMD_DUMP:
-		/*
-		 * TODO(crosbug.com/p/27320): Need to remove hard coding and
-		 * use some motion_sense data structure from the board file to
-		 * help fill in this response.
-		 */
 		out->dump.module_flags =
 			(*(host_get_memmap(EC_MEMMAP_ACC_STATUS)) &
 				EC_MEMMAP_ACC_STATUS_PRESENCE_BIT) ?
 					MOTIONSENSE_MODULE_FLAG_ACTIVE : 0;
-		out->dump.sensor_flags[0] = MOTIONSENSE_SENSOR_FLAG_PRESENT;
-		out->dump.sensor_flags[1] = MOTIONSENSE_SENSOR_FLAG_PRESENT;
-		out->dump.sensor_flags[2] = 0;
-		out->dump.data[0] = acc_base_host[X];
-		out->dump.data[1] = acc_base_host[Y];
-		out->dump.data[2] = acc_base_host[Z];
-		out->dump.data[3] = acc_lid_host[X];
-		out->dump.data[4] = acc_lid_host[Y];
-		out->dump.data[5] = acc_lid_host[Z];
+		for (i = 0; i < EC_MOTION_SENSOR_COUNT; i++) {
+			s = host_sensor_id_to_motion_sensor(i);
+			out->dump.sensor_flags[i] =
+				s ? MOTIONSENSE_SENSOR_FLAG_PRESENT : 0;
+			out->dump.data[3 * i + X] = s ? s->host_xyz[X] : 0;
+			out->dump.data[3 * i + Y] = s ? s->host_xyz[Y] : 0;
+			out->dump.data[3 * i + Z] = s ? s->host_xyz[Z] : 0;
+		}
 
 		args->response_size = sizeof(out->dump);
 		break;
 
 	case MOTIONSENSE_CMD_INFO:
-		/*
-		 * TODO(crosbug.com/p/27320): Need to remove hard coding and
-		 * use some motion_sense data structure from the board file to
-		 * help fill in this response.
-		 */
-		id = host_sensor_id_to_ec_sensor_id(in->sensor_odr.sensor_num);
-		if (id < 0)
+		s = host_sensor_id_to_motion_sensor(in->info.sensor_num);
+		if (!s)
 			return EC_RES_INVALID_PARAM;
 
-		switch (id) {
-		case ACCEL_BASE:
-			out->info.type = MOTIONSENSE_TYPE_ACCEL;
-			out->info.location = MOTIONSENSE_LOC_BASE;
-			out->info.chip = MOTIONSENSE_CHIP_KXCJ9;
-			break;
-		case ACCEL_LID:
-			out->info.type = MOTIONSENSE_TYPE_ACCEL;
-			out->info.location = MOTIONSENSE_LOC_LID;
-			out->info.chip = MOTIONSENSE_CHIP_KXCJ9;
-			break;
-		default:
-			return EC_RES_INVALID_PARAM;
-		}
+		out->info.type = s->type;
+		out->info.location = s->location;
+		out->info.chip = s->chip;
 
 		args->response_size = sizeof(out->info);
 		break;
@@ -426,7 +767,7 @@ static int host_cmd_motion_sense(struct host_cmd_handler_args *args)
 				data = MAX_POLLING_INTERVAL_MS;
 
 			accel_interval_ap_on_ms = data;
-			accel_interval_ms = data;
+			set_module_interval(data);
 		}
 
 		out->ec_rate.ret = accel_interval_ap_on_ms;
@@ -436,13 +777,13 @@ static int host_cmd_motion_sense(struct host_cmd_handler_args *args)
 
 	case MOTIONSENSE_CMD_SENSOR_ODR:
 		/* Verify sensor number is valid. */
-		id = host_sensor_id_to_ec_sensor_id(in->sensor_odr.sensor_num);
-		if (id < 0)
+		s = host_sensor_id_to_motion_sensor(in->sensor_odr.sensor_num);
+		if (!s)
 			return EC_RES_INVALID_PARAM;
 
 		/* Set new datarate if the data arg has a value. */
 		if (in->sensor_odr.data != EC_MOTION_SENSE_NO_VALUE) {
-			if (accel_set_datarate(id, in->sensor_odr.data,
+			if (s->drv->set_data_rate(s, in->sensor_odr.data,
 					in->sensor_odr.roundup) != EC_SUCCESS) {
 				CPRINTS("MS bad sensor rate %d",
 						in->sensor_odr.data);
@@ -450,7 +791,7 @@ static int host_cmd_motion_sense(struct host_cmd_handler_args *args)
 			}
 		}
 
-		accel_get_datarate(id, &data);
+		s->drv->get_data_rate(s, &data);
 		out->sensor_odr.ret = data;
 
 		args->response_size = sizeof(out->sensor_odr);
@@ -458,13 +799,14 @@ static int host_cmd_motion_sense(struct host_cmd_handler_args *args)
 
 	case MOTIONSENSE_CMD_SENSOR_RANGE:
 		/* Verify sensor number is valid. */
-		id = host_sensor_id_to_ec_sensor_id(in->sensor_odr.sensor_num);
-		if (id < 0)
+		s = host_sensor_id_to_motion_sensor(
+				in->sensor_range.sensor_num);
+		if (!s)
 			return EC_RES_INVALID_PARAM;
 
-		/* Set new datarate if the data arg has a value. */
+		/* Set new range if the data arg has a value. */
 		if (in->sensor_range.data != EC_MOTION_SENSE_NO_VALUE) {
-			if (accel_set_range(id, in->sensor_range.data,
+			if (s->drv->set_range(s, in->sensor_range.data,
 				in->sensor_range.roundup) != EC_SUCCESS) {
 				CPRINTS("MS bad sensor range %d",
 						in->sensor_range.data);
@@ -472,7 +814,7 @@ static int host_cmd_motion_sense(struct host_cmd_handler_args *args)
 			}
 		}
 
-		accel_get_range(id, &data);
+		s->drv->get_range(s, &data);
 		out->sensor_range.ret = data;
 
 		args->response_size = sizeof(out->sensor_range);
@@ -492,6 +834,44 @@ static int host_cmd_motion_sense(struct host_cmd_handler_args *args)
 
 		break;
 
+#ifdef CONFIG_ACCEL_FIFO
+	case MOTIONSENSE_CMD_FIFO_INFO:
+		/* Set new watermark if the data arg has a value. */
+		data = in->fifo_info.watermark;
+		if (data != EC_MOTION_SENSE_NO_VALUE &&
+		    (data < 1 || data > CONFIG_ACCEL_FIFO))
+			return EC_RES_INVALID_PARAM;
+
+		mutex_lock(&fifo_mutex);
+		if (data != EC_MOTION_SENSE_NO_VALUE)
+			fifo_watermark = data;
+		out->fifo_info.size = CONFIG_ACCEL_FIFO;
+		out->fifo_info.count = queue_count(&motion_fifo);
+		out->fifo_info.watermark = fifo_watermark;
+		out->fifo_info.lost = fifo_lost;
+		fifo_lost = 0;
+		mutex_unlock(&fifo_mutex);
+
+		args->response_size = sizeof(out->fifo_info);
+		break;
+
+	case MOTIONSENSE_CMD_FIFO_READ:
+		data = (args->response_max - sizeof(out->fifo_read)) /
+			sizeof(out->fifo_read.data[0]);
+		data = MIN(data, in->fifo_read.max_samples);
+
+		mutex_lock(&fifo_mutex);
+		out->fifo_read.count = queue_remove_units(&motion_fifo,
+					out->fifo_read.data, MIN(data, 255));
+		if (queue_count(&motion_fifo) < fifo_watermark)
+			fifo_host_notified = 0;
+		mutex_unlock(&fifo_mutex);
+
+		args->response_size = sizeof(out->fifo_read) +
+			out->fifo_read.count * sizeof(out->fifo_read.data[0]);
+		break;
+#endif
+
 	default:
 		CPRINTS("MS bad cmd 0x%x", in->cmd);
 		return EC_RES_INVALID_PARAM;
@@ -533,7 +913,7 @@ static int command_ctrl_print_lid_angle_calcs(int argc, char **argv)
 		if (*e)
 			return EC_ERROR_PARAM2;
 
-		accel_interval_ms = val;
+		set_module_interval(val);
 	}
 
 	return EC_SUCCESS;
@@ -548,14 +928,16 @@ static int command_accelrange(int argc, char **argv)
 {
 	char *e;
 	int id, data, round = 1;
+	const struct motion_sensor_t *s;
 
 	if (argc < 2 || argc > 4)
 		return EC_ERROR_PARAM_COUNT;
 
 	/* First argument is sensor id. */
 	id = strtoi(argv[1], &e, 0);
-	if (*e || id < 0 || id > ACCEL_COUNT)
+	if (*e || id < 0 || id >= motion_sensor_count)
 		return EC_ERROR_PARAM1;
+	s = &motion_sensors[id];
 
 	if (argc >= 3) {
 		/* Second argument is data to write. */
@@ -574,10 +956,10 @@ static int command_accelrange(int argc, char **argv)
 		 * Write new range, if it returns invalid arg, then return
 		 * a parameter error.
 		 */
-		if (accel_set_range(id, data, round) == EC_ERROR_INVAL)
+		if (s->drv->set_range(s, data, round) == EC_ERROR_INVAL)
 			return EC_ERROR_PARAM2;
 	} else {
-		accel_get_range(id, &data);
+		s->drv->get_range(s, &data);
 		ccprintf("Range for sensor %d: %d\n", id, data);
 	}
 
@@ -591,14 +973,16 @@ static int command_accelresolution(int argc, char **argv)
 {
 	char *e;
 	int id, data, round = 1;
+	const struct motion_sensor_t *s;
 
 	if (argc < 2 || argc > 4)
 		return EC_ERROR_PARAM_COUNT;
 
 	/* First argument is sensor id. */
 	id = strtoi(argv[1], &e, 0);
-	if (*e || id < 0 || id > ACCEL_COUNT)
+	if (*e || id < 0 || id >= motion_sensor_count)
 		return EC_ERROR_PARAM1;
+	s = &motion_sensors[id];
 
 	if (argc >= 3) {
 		/* Second argument is data to write. */
@@ -617,10 +1001,10 @@ static int command_accelresolution(int argc, char **argv)
 		 * Write new resolution, if it returns invalid arg, then
 		 * return a parameter error.
 		 */
-		if (accel_set_resolution(id, data, round) == EC_ERROR_INVAL)
+		if (s->drv->set_resolution(s, data, round) == EC_ERROR_INVAL)
 			return EC_ERROR_PARAM2;
 	} else {
-		accel_get_resolution(id, &data);
+		s->drv->get_resolution(s, &data);
 		ccprintf("Resolution for sensor %d: %d\n", id, data);
 	}
 
@@ -634,14 +1018,16 @@ static int command_acceldatarate(int argc, char **argv)
 {
 	char *e;
 	int id, data, round = 1;
+	const struct motion_sensor_t *s;
 
 	if (argc < 2 || argc > 4)
 		return EC_ERROR_PARAM_COUNT;
 
 	/* First argument is sensor id. */
 	id = strtoi(argv[1], &e, 0);
-	if (*e || id < 0 || id > ACCEL_COUNT)
+	if (*e || id < 0 || id >= motion_sensor_count)
 		return EC_ERROR_PARAM1;
+	s = &motion_sensors[id];
 
 	if (argc >= 3) {
 		/* Second argument is data to write. */
@@ -660,10 +1046,10 @@ static int command_acceldatarate(int argc, char **argv)
 		 * Write new data rate, if it returns invalid arg, then
 		 * return a parameter error.
 		 */
-		if (accel_set_datarate(id, data, round) == EC_ERROR_INVAL)
+		if (s->drv->set_data_rate(s, data, round) == EC_ERROR_INVAL)
 			return EC_ERROR_PARAM2;
 	} else {
-		accel_get_datarate(id, &data);
+		s->drv->get_data_rate(s, &data);
 		ccprintf("Data rate for sensor %d: %d\n", id, data);
 	}
 
@@ -684,7 +1070,7 @@ static int command_accelerometer_interrupt(int argc, char **argv)
 
 	/* First argument is id. */
 	id = strtoi(argv[1], &e, 0);
-	if (*e || id < 0 || id >= ACCEL_COUNT)
+	if (*e || id < 0 || id >= motion_sensor_count)
 		return EC_ERROR_PARAM1;
 
 	/* Second argument is interrupt threshold. */
@@ -692,7 +1078,7 @@ static int command_accelerometer_interrupt(int argc, char **argv)
 	if (*e)
 		return EC_ERROR_PARAM2;
 
-	accel_set_interrupt(id, thresh);
+	motion_sensors[id].drv->set_interrupt(&motion_sensors[id], thresh);
 
 	return EC_SUCCESS;
 }
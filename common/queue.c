@@ -27,31 +27,64 @@ int queue_has_space(const struct queue *q, int unit_count)
 		       (q->head - 1);
 }
 
+int queue_count(const struct queue *q)
+{
+	return ((q->tail - q->head + q->buf_bytes) % q->buf_bytes) /
+		q->unit_bytes;
+}
+
 void queue_add_units(struct queue *q, const void *src, int unit_count)
 {
 	const uint8_t *s = (const uint8_t *)src;
+	int bytes = unit_count * q->unit_bytes;
+	int first;
 
 	if (!queue_has_space(q, unit_count))
 		return;
 
-	for (unit_count *= q->unit_bytes; unit_count; unit_count--) {
-		q->buf[q->tail++] = *(s++);
-		q->tail %= q->buf_bytes;
-	}
+	/* Copy up to the end of the buffer, then wrap to the start */
+	first = MIN(bytes, q->buf_bytes - q->tail);
+	memcpy(q->buf + q->tail, s, first);
+	memcpy(q->buf, s + first, bytes - first);
+	q->tail = (q->tail + bytes) % q->buf_bytes;
 }
 
-int queue_remove_unit(struct queue *q, void *dest)
+/**
+ * Copy bytes out of the queue buffer, starting at buffer position pos.
+ */
+static void queue_copy_out(const struct queue *q, int pos, uint8_t *dest,
+			   int bytes)
+{
+	int first = MIN(bytes, q->buf_bytes - pos);
+
+	memcpy(dest, q->buf + pos, first);
+	memcpy(dest + first, q->buf, bytes - first);
+}
+
+int queue_peek_units(const struct queue *q, void *dest, int offset,
+		     int unit_count)
 {
-	int count;
-	uint8_t *d = (uint8_t *)dest;
+	int avail = queue_count(q) - offset;
 
-	if (queue_is_empty(q))
+	if (avail <= 0)
 		return 0;
 
-	for (count = q->unit_bytes; count; count--) {
-		*(d++) = q->buf[q->head++];
-		q->head %= q->buf_bytes;
-	}
+	unit_count = MIN(unit_count, avail);
+	queue_copy_out(q, (q->head + offset * q->unit_bytes) % q->buf_bytes,
+		       dest, unit_count * q->unit_bytes);
 
-	return 1;
+	return unit_count;
+}
+
+int queue_remove_units(struct queue *q, void *dest, int unit_count)
+{
+	unit_count = queue_peek_units(q, dest, 0, unit_count);
+	q->head = (q->head + unit_count * q->unit_bytes) % q->buf_bytes;
+
+	return unit_count;
+}
+
+int queue_remove_unit(struct queue *q, void *dest)
+{
+	return queue_remove_units(q, dest, 1);
 }
@@ -454,6 +454,9 @@ int system_run_image_copy(enum system_image_copy_t copy)
 			return EC_ERROR_ACCESS_DENIED;
 	}
 
+	/* Don't lose buffered flash writes across the jump */
+	flash_write_flush();
+
 	/* Load the appropriate reset vector */
 	base = get_base(copy);
 	if (base == 0xffffffff)
@@ -607,6 +610,7 @@ static int handle_pending_reboot(enum ec_reboot_cmd cmd)
 	case EC_REBOOT_JUMP_RW:
 		return system_run_image_copy(SYSTEM_IMAGE_RW);
 	case EC_REBOOT_COLD:
+		flash_write_flush();
 		system_reset(SYSTEM_RESET_HARD);
 		/* That shouldn't return... */
 		return EC_ERROR_UNKNOWN;
@@ -615,6 +619,7 @@ static int handle_pending_reboot(enum ec_reboot_cmd cmd)
 		return EC_SUCCESS;
 	case EC_REBOOT_HIBERNATE:
 		CPRINTS("system hibernating");
+		flash_write_flush();
 		system_hibernate(0, 0);
 		/* That shouldn't return... */
 		return EC_ERROR_UNKNOWN;
@@ -792,6 +797,7 @@ static int command_reboot(int argc, char **argv)
 		ccputs("Hard-");
 	ccputs("Rebooting!\n\n\n");
 	cflush();
+	flash_write_flush();
 	system_reset(flags);
 	return EC_SUCCESS;
 }
@@ -14,6 +14,93 @@
 #include "timer.h"
 #include "util.h"
 
+#ifdef CONFIG_TEMP_SENSOR_POLL
+/*
+ * Each sensor is read once a second, on its own hook tick, so the bus
+ * traffic for a board full of sensors isn't all in one burst.
+ */
+#define POLL_TICKS (SECOND / HOOK_TICK_INTERVAL)
+#define POLL_PER_TICK DIV_ROUND_UP(TEMP_SENSOR_COUNT, POLL_TICKS)
+
+/* Latest reading from each sensor */
+static struct {
+	int temp;
+	int rv;
+	timestamp_t time;	/* When the sensor was read */
+	uint32_t read_us;	/* How long the read took */
+	uint32_t read_max_us;
+} readings[TEMP_SENSOR_COUNT];
+
+/* Tick within the second, which selects the sensors to read */
+static int poll_tick;
+
+static void poll_sensor(int id)
+{
+	const struct temp_sensor_t *sensor = temp_sensors + id;
+	timestamp_t begin = get_time();
+	uint32_t us;
+	int t, rv;
+
+	rv = sensor->read(sensor->idx, &t);
+	readings[id].time = get_time();
+
+	us = readings[id].time.val - begin.val;
+	readings[id].read_us = us;
+	if (us > readings[id].read_max_us)
+		readings[id].read_max_us = us;
+
+	readings[id].rv = rv;
+	if (rv == EC_SUCCESS)
+		readings[id].temp = t;
+}
+
+static void temp_sensor_poll(void)
+{
+	int id = poll_tick * POLL_PER_TICK;
+	int end = MIN(id + POLL_PER_TICK, TEMP_SENSOR_COUNT);
+
+	for (; id < end; id++)
+		poll_sensor(id);
+
+	poll_tick = (poll_tick + 1) % POLL_TICKS;
+}
+DECLARE_HOOK(HOOK_TICK, temp_sensor_poll, HOOK_PRIO_TEMP_SENSOR);
+
+static void temp_sensor_poll_init(void)
+{
+	int id;
+
+	/* Read everything once, so the first HOOK_SECOND has data to use */
+	for (id = 0; id < TEMP_SENSOR_COUNT; id++)
+		poll_sensor(id);
+}
+DECLARE_HOOK(HOOK_INIT, temp_sensor_poll_init, HOOK_PRIO_LAST);
+
+int temp_sensor_read_age(enum temp_sensor_id id, int *temp_ptr,
+			 uint32_t *age_ptr)
+{
+	uint64_t age;
+
+	if (id < 0 || id >= TEMP_SENSOR_COUNT)
+		return EC_ERROR_INVAL;
+
+	age = get_time().val - readings[id].time.val;
+	*age_ptr = MIN(age, (uint64_t)-1U);
+	if (age > TEMP_SENSOR_MAX_AGE)
+		return EC_ERROR_TIMEOUT;
+
+	if (readings[id].rv == EC_SUCCESS)
+		*temp_ptr = readings[id].temp;
+	return readings[id].rv;
+}
+
+int temp_sensor_read(enum temp_sensor_id id, int *temp_ptr)
+{
+	uint32_t age;
+
+	return temp_sensor_read_age(id, temp_ptr, &age);
+}
+#else
 int temp_sensor_read(enum temp_sensor_id id, int *temp_ptr)
 {
 	const struct temp_sensor_t *sensor;
@@ -24,6 +111,7 @@ int temp_sensor_read(enum temp_sensor_id id, int *temp_ptr)
 
 	return sensor->read(sensor->idx, temp_ptr);
 }
+#endif
 
 static void update_mapped_memory(void)
 {
@@ -129,6 +217,36 @@ DECLARE_CONSOLE_COMMAND(temps, command_temps,
 			"Print temp sensors",
 			NULL);
 
+#ifdef CONFIG_TEMP_SENSOR_POLL
+static int command_temppoll(int argc, char **argv)
+{
+	uint32_t age;
+	int i, t;
+
+	if (argc > 1) {
+		if (strcasecmp(argv[1], "clear"))
+			return EC_ERROR_PARAM1;
+		for (i = 0; i < TEMP_SENSOR_COUNT; i++)
+			readings[i].read_max_us = 0;
+		return EC_SUCCESS;
+	}
+
+	ccputs("Sensor                  age_ms  read_us  read_max\n");
+	for (i = 0; i < TEMP_SENSOR_COUNT; i++) {
+		temp_sensor_read_age(i, &t, &age);
+		ccprintf("  %-20s %7d %8d %9d\n", temp_sensors[i].name,
+			 age / MSEC, readings[i].read_us,
+			 readings[i].read_max_us);
+	}
+
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(temppoll, command_temppoll,
+			"[clear]",
+			"Print or clear temp sensor poll age and read latency",
+			NULL);
+#endif
+
 /*****************************************************************************/
 /* Host commands */
 
@@ -255,10 +255,16 @@ static void thermal_control(void)
 	/* TODO(crosbug.com/p/23797): For now, we just treat all fans the
 	 * same. It would be better if we could assign different thermal
 	 * profiles to each fan - in case one fan cools the CPU while another
-	 * cools the radios or battery.
+	 * cools the radios or battery. CONFIG_FAN_PID does that for the fans
+	 * which have a PID profile.
 	 */
-	for (i = 0; i < CONFIG_FANS; i++)
+	for (i = 0; i < CONFIG_FANS; i++) {
+#ifdef CONFIG_FAN_PID
+		if (fan_pid_enabled(i))
+			continue;
+#endif
 		fan_set_percent_needed(i, fmax);
+	}
 #endif
 
 	/* Don't forget to signal any DPTF thresholds */
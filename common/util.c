@@ -370,6 +370,13 @@ int get_next_bit(uint32_t *mask)
 	return bit;
 }
 
+int histogram_log2_bucket(uint32_t val, int count)
+{
+	int bucket = val ? 31 - __builtin_clz(val) : 0;
+
+	return MIN(bucket, count - 1);
+}
+
 
 /****************************************************************************/
 /* stateful conditional stuff */
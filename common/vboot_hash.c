@@ -7,6 +7,7 @@
 
 #include "common.h"
 #include "console.h"
+#include "flash.h"
 #include "hooks.h"
 #include "host_command.h"
 #include "sha256.h"
@@ -117,6 +118,9 @@ static int vboot_hash_start(uint32_t offset, uint32_t size,
 		return EC_ERROR_INVAL;
 	}
 
+	/* Hash is computed directly from flash, so commit pending writes */
+	flash_write_flush();
+
 	/* Save new hash request */
 	data_offset = offset;
 	data_size = size;
@@ -11,6 +11,7 @@
 #include "driver/accel_kxcj9.h"
 #include "gpio.h"
 #include "i2c.h"
+#include "motion_sense.h"
 #include "task.h"
 #include "timer.h"
 #include "util.h"
@@ -59,24 +60,6 @@ const struct accel_param_pair datarates[] = {
 	{1600000, KXCJ9_OSA_1600_HZ}
 };
 
-/* Current range of each accelerometer. The value is an index into ranges[]. */
-static int sensor_range[ACCEL_COUNT] = {0, 0};
-
-/*
- * Current resolution of each accelerometer. The value is an index into
- * resolutions[].
- */
-static int sensor_resolution[ACCEL_COUNT] = {1, 1};
-
-/*
- * Current output data rate of each accelerometer. The value is an index into
- * datarates[].
- */
-static int sensor_datarate[ACCEL_COUNT] = {6, 6};
-
-
-static struct mutex accel_mutex[ACCEL_COUNT];
-
 /**
  * Find index into a accel_param_pair that matches the given engineering value
  * passed in. The round_up flag is used to specify whether to round up or down.
@@ -104,21 +87,51 @@ static int find_param_index(const int eng_val, const int round_up,
 	return i;
 }
 
+/*
+ * Registers which only change when the EC writes them. CTRL2 is left out
+ * because its reset and self-test bits clear themselves.
+ */
+static const uint8_t cached_regs[] = {
+	KXCJ9_CTRL1, KXCJ9_INT_CTRL1, KXCJ9_INT_CTRL2, KXCJ9_DATA_CTRL,
+	KXCJ9_WAKEUP_TIMER, KXCJ9_WAKEUP_THRESHOLD,
+};
+
 /**
  * Read register from accelerometer.
  */
-static int raw_read8(const int addr, const int reg, int *data_ptr)
+static int raw_read8(const struct motion_sensor_t *s, const int reg,
+		     int *data_ptr)
 {
-	return i2c_read8(I2C_PORT_ACCEL, addr, reg, data_ptr);
+	struct kxcj9_data *data = s->drv_data;
+
+	return i2c_regcache_read8(&data->regs, I2C_PORT_ACCEL, s->i2c_addr,
+				  reg, data_ptr);
 }
 
 /**
  * Write register from accelerometer.
  */
-static int raw_write8(const int addr, const int reg, int data)
+static int raw_write8(const struct motion_sensor_t *s, const int reg, int val)
+{
+	struct kxcj9_data *data = s->drv_data;
+
+	return i2c_regcache_write8(&data->regs, I2C_PORT_ACCEL, s->i2c_addr,
+				   reg, val);
+}
+
+#ifdef CONFIG_ACCEL_INTERRUPTS
+/**
+ * Set the bits in <mask> of an accelerometer register to those of <val>.
+ */
+static int raw_update8(const struct motion_sensor_t *s, const int reg,
+		       int mask, int val)
 {
-	return i2c_write8(I2C_PORT_ACCEL, addr, reg, data);
+	struct kxcj9_data *data = s->drv_data;
+
+	return i2c_regcache_update8(&data->regs, I2C_PORT_ACCEL, s->i2c_addr,
+				    reg, mask, val);
 }
+#endif
 
 /**
  * Disable sensor by taking it out of operating mode. When disabled, the
@@ -126,34 +139,37 @@ static int raw_write8(const int addr, const int reg, int data)
  *
  * Note: This is intended to be called in a pair with enable_sensor().
  *
- * @id Sensor index
+ * @s Pointer to motion sensor data
  * @ctrl1 Pointer to location to store KXCJ9_CTRL1 register after disabling
  *
  * @return EC_SUCCESS if successful, EC_ERROR_* otherwise
  */
-static int disable_sensor(const enum accel_id id, int *ctrl1)
+static int disable_sensor(const struct motion_sensor_t *s, int *ctrl1)
 {
 	int ret;
 
 	/*
-	 * Read the current state of the ctrl1 register so that we can restore
-	 * it later.
+	 * Before disabling the sensor, acquire mutex to prevent another task
+	 * from attempting to access accel parameters until we enable sensor.
+	 * This also guards the register cache.
 	 */
-	ret = raw_read8(accel_addr[id], KXCJ9_CTRL1, ctrl1);
-	if (ret != EC_SUCCESS)
-		return ret;
+	mutex_lock(s->mutex);
 
 	/*
-	 * Before disabling the sensor, acquire mutex to prevent another task
-	 * from attempting to access accel parameters until we enable sensor.
+	 * Read the current state of the ctrl1 register so that we can restore
+	 * it later.
 	 */
-	mutex_lock(&accel_mutex[id]);
+	ret = raw_read8(s, KXCJ9_CTRL1, ctrl1);
+	if (ret != EC_SUCCESS) {
+		mutex_unlock(s->mutex);
+		return ret;
+	}
 
 	/* Disable sensor. */
 	*ctrl1 &= ~KXCJ9_CTRL1_PC1;
-	ret = raw_write8(accel_addr[id], KXCJ9_CTRL1, *ctrl1);
+	ret = raw_write8(s, KXCJ9_CTRL1, *ctrl1);
 	if (ret != EC_SUCCESS) {
-		mutex_unlock(&accel_mutex[id]);
+		mutex_unlock(s->mutex);
 		return ret;
 	}
 
@@ -165,178 +181,164 @@ static int disable_sensor(const enum accel_id id, int *ctrl1)
  *
  * Note: This is intended to be called in a pair with disable_sensor().
  *
- * @id Sensor index
+ * @s Pointer to motion sensor data
  * @ctrl1 Value of KXCJ9_CTRL1 register to write to sensor
  *
  * @return EC_SUCCESS if successful, EC_ERROR_* otherwise
  */
-static int enable_sensor(const enum accel_id id, const int ctrl1)
+static int enable_sensor(const struct motion_sensor_t *s, const int ctrl1)
 {
 	int i, ret;
 
 	for (i = 0; i < SENSOR_ENABLE_ATTEMPTS; i++) {
 		/* Enable accelerometer based on ctrl1 value. */
-		ret = raw_write8(accel_addr[id], KXCJ9_CTRL1,
+		ret = raw_write8(s, KXCJ9_CTRL1,
 				ctrl1 | KXCJ9_CTRL1_PC1);
 
 		/* On first success, we are done. */
 		if (ret == EC_SUCCESS) {
-			mutex_unlock(&accel_mutex[id]);
+			mutex_unlock(s->mutex);
 			return EC_SUCCESS;
 		}
 
 	}
 
 	/* Release mutex. */
-	mutex_unlock(&accel_mutex[id]);
+	mutex_unlock(s->mutex);
 
 	/* Cannot enable accel, print warning and return an error. */
-	CPRINTF("Error trying to enable accelerometer %d", id);
+	CPRINTS("Error trying to enable accelerometer %s", s->name);
 
 	return ret;
 }
 
-int accel_set_range(const enum accel_id id, const int range, const int rnd)
+static int set_range(const struct motion_sensor_t *s, int range, int rnd)
 {
+	struct kxcj9_data *data = s->drv_data;
 	int ret, ctrl1, ctrl1_new, index;
 
-	/* Check for valid id. */
-	if (id < 0 || id >= ACCEL_COUNT)
-		return EC_ERROR_INVAL;
-
 	/* Find index for interface pair matching the specified range. */
 	index = find_param_index(range, rnd, ranges, ARRAY_SIZE(ranges));
 
 	/* Disable the sensor to allow for changing of critical parameters. */
-	ret = disable_sensor(id, &ctrl1);
+	ret = disable_sensor(s, &ctrl1);
 	if (ret != EC_SUCCESS)
 		return ret;
 
 	/* Determine new value of CTRL1 reg and attempt to write it. */
 	ctrl1_new = (ctrl1 & ~KXCJ9_GSEL_ALL) | ranges[index].reg;
-	ret = raw_write8(accel_addr[id],  KXCJ9_CTRL1, ctrl1_new);
+	ret = raw_write8(s, KXCJ9_CTRL1, ctrl1_new);
 
 	/* If successfully written, then save the range. */
 	if (ret == EC_SUCCESS) {
-		sensor_range[id] = index;
+		data->sensor_range = index;
 		ctrl1 = ctrl1_new;
 	}
 
 	/* Re-enable the sensor. */
-	if (enable_sensor(id, ctrl1) != EC_SUCCESS)
+	if (enable_sensor(s, ctrl1) != EC_SUCCESS)
 		return EC_ERROR_UNKNOWN;
 
 	return ret;
 }
 
-int accel_get_range(const enum accel_id id, int * const range)
+static int get_range(const struct motion_sensor_t *s, int *range)
 {
-	/* Check for valid id. */
-	if (id < 0 || id >= ACCEL_COUNT)
-		return EC_ERROR_INVAL;
+	struct kxcj9_data *data = s->drv_data;
 
-	*range = ranges[sensor_range[id]].val;
+	*range = ranges[data->sensor_range].val;
 	return EC_SUCCESS;
 }
 
-int accel_set_resolution(const enum accel_id id, const int res, const int rnd)
+static int set_resolution(const struct motion_sensor_t *s, int res, int rnd)
 {
+	struct kxcj9_data *data = s->drv_data;
 	int ret, ctrl1, ctrl1_new, index;
 
-	/* Check for valid id. */
-	if (id < 0 || id >= ACCEL_COUNT)
-		return EC_ERROR_INVAL;
-
 	/* Find index for interface pair matching the specified resolution. */
 	index = find_param_index(res, rnd, resolutions,
 			ARRAY_SIZE(resolutions));
 
 	/* Disable the sensor to allow for changing of critical parameters. */
-	ret = disable_sensor(id, &ctrl1);
+	ret = disable_sensor(s, &ctrl1);
 	if (ret != EC_SUCCESS)
 		return ret;
 
 	/* Determine new value of CTRL1 reg and attempt to write it. */
 	ctrl1_new = (ctrl1 & ~KXCJ9_RES_12BIT) | resolutions[index].reg;
-	ret = raw_write8(accel_addr[id],  KXCJ9_CTRL1, ctrl1_new);
+	ret = raw_write8(s, KXCJ9_CTRL1, ctrl1_new);
 
 	/* If successfully written, then save the range. */
 	if (ret == EC_SUCCESS) {
-		sensor_resolution[id] = index;
+		data->sensor_resolution = index;
 		ctrl1 = ctrl1_new;
 	}
 
 	/* Re-enable the sensor. */
-	if (enable_sensor(id, ctrl1) != EC_SUCCESS)
+	if (enable_sensor(s, ctrl1) != EC_SUCCESS)
 		return EC_ERROR_UNKNOWN;
 
 	return ret;
 }
 
-int accel_get_resolution(const enum accel_id id, int * const res)
+static int get_resolution(const struct motion_sensor_t *s, int *res)
 {
-	/* Check for valid id. */
-	if (id < 0 || id >= ACCEL_COUNT)
-		return EC_ERROR_INVAL;
+	struct kxcj9_data *data = s->drv_data;
 
-	*res = resolutions[sensor_resolution[id]].val;
+	*res = resolutions[data->sensor_resolution].val;
 	return EC_SUCCESS;
 }
 
-int accel_set_datarate(const enum accel_id id, const int rate, const int rnd)
+static int set_data_rate(const struct motion_sensor_t *s, int rate, int rnd)
 {
+	struct kxcj9_data *data = s->drv_data;
 	int ret, ctrl1, index;
 
-	/* Check for valid id. */
-	if (id < 0 || id >= ACCEL_COUNT)
-		return EC_ERROR_INVAL;
-
 	/* Find index for interface pair matching the specified rate. */
 	index = find_param_index(rate, rnd, datarates, ARRAY_SIZE(datarates));
 
 	/* Disable the sensor to allow for changing of critical parameters. */
-	ret = disable_sensor(id, &ctrl1);
+	ret = disable_sensor(s, &ctrl1);
 	if (ret != EC_SUCCESS)
 		return ret;
 
 	/* Set output data rate. */
-	ret = raw_write8(accel_addr[id],  KXCJ9_DATA_CTRL,
+	ret = raw_write8(s, KXCJ9_DATA_CTRL,
 			datarates[index].reg);
 
 	/* If successfully written, then save the range. */
 	if (ret == EC_SUCCESS)
-		sensor_datarate[id] = index;
+		data->sensor_datarate = index;
 
 	/* Re-enable the sensor. */
-	if (enable_sensor(id, ctrl1) != EC_SUCCESS)
+	if (enable_sensor(s, ctrl1) != EC_SUCCESS)
 		return EC_ERROR_UNKNOWN;
 
 	return ret;
 }
 
-int accel_get_datarate(const enum accel_id id, int * const rate)
+static int get_data_rate(const struct motion_sensor_t *s, int *rate)
 {
-	/* Check for valid id. */
-	if (id < 0 || id >= ACCEL_COUNT)
-		return EC_ERROR_INVAL;
+	struct kxcj9_data *data = s->drv_data;
 
-	*rate = datarates[sensor_datarate[id]].val;
+	*rate = datarates[data->sensor_datarate].val;
 	return EC_SUCCESS;
 }
 
 
 #ifdef CONFIG_ACCEL_INTERRUPTS
-int accel_set_interrupt(const enum accel_id id, unsigned int threshold)
+static int set_interrupt(const struct motion_sensor_t *s,
+			 unsigned int threshold)
 {
 	int ctrl1, tmp, ret;
 
 	/* Disable the sensor to allow for changing of critical parameters. */
-	ret = disable_sensor(id, &ctrl1);
+	ret = disable_sensor(s, &ctrl1);
 	if (ret != EC_SUCCESS)
 		return ret;
 
 	/* Set interrupt timer to 1 so it wakes up immediately. */
-	ret = raw_write8(accel_addr[id], KXCJ9_WAKEUP_TIMER, 1);
+	ret = raw_write8(s, KXCJ9_WAKEUP_TIMER, 1);
 	if (ret != EC_SUCCESS)
 		goto error_enable_sensor;
 
@@ -345,7 +347,7 @@ int accel_set_interrupt(const enum accel_id id, unsigned int threshold)
 	 * first we need to divide by 16 to get the value to send.
 	 */
 	threshold >>= 4;
-	ret = raw_write8(accel_addr[id], KXCJ9_WAKEUP_THRESHOLD, threshold);
+	ret = raw_write8(s, KXCJ9_WAKEUP_THRESHOLD, threshold);
 	if (ret != EC_SUCCESS)
 		goto error_enable_sensor;
 
@@ -354,56 +356,48 @@ int accel_set_interrupt(const enum accel_id id, unsigned int threshold)
 	 * function is called once, the interrupt stays enabled and it is
 	 * only necessary to clear KXCJ9_INT_REL to allow the next interrupt.
 	 */
-	ret = raw_read8(accel_addr[id], KXCJ9_INT_CTRL1, &tmp);
+	ret = raw_update8(s, KXCJ9_INT_CTRL1, KXCJ9_INT_CTRL1_IEN,
+			  KXCJ9_INT_CTRL1_IEN);
 	if (ret != EC_SUCCESS)
 		goto error_enable_sensor;
-	if (!(tmp & KXCJ9_INT_CTRL1_IEN)) {
-		ret = raw_write8(accel_addr[id], KXCJ9_INT_CTRL1,
-				tmp | KXCJ9_INT_CTRL1_IEN);
-		if (ret != EC_SUCCESS)
-			goto error_enable_sensor;
-	}
 
 	/*
 	 * Clear any pending interrupt on sensor by reading INT_REL register.
 	 * Note: this register latches motion detected above threshold. Once
 	 * latched, no interrupt can occur until this register is cleared.
 	 */
-	ret = raw_read8(accel_addr[id], KXCJ9_INT_REL, &tmp);
+	ret = raw_read8(s, KXCJ9_INT_REL, &tmp);
 
 error_enable_sensor:
 	/* Re-enable the sensor. */
-	if (enable_sensor(id, ctrl1) != EC_SUCCESS)
+	if (enable_sensor(s, ctrl1) != EC_SUCCESS)
 		return EC_ERROR_UNKNOWN;
 
 	return ret;
 }
 #endif
 
-int accel_read(const enum accel_id id, int * const x_acc, int * const y_acc,
-		int * const z_acc)
+static int read(const struct motion_sensor_t *s, int *x_acc, int *y_acc,
+		int *z_acc)
 {
+	struct kxcj9_data *data = s->drv_data;
 	uint8_t acc[6];
 	uint8_t reg = KXCJ9_XOUT_L;
 	int ret, multiplier;
 
-	/* Check for valid id. */
-	if (id < 0 || id >= ACCEL_COUNT)
-		return EC_ERROR_INVAL;
-
 	/* Read 6 bytes starting at KXCJ9_XOUT_L. */
-	mutex_lock(&accel_mutex[id]);
+	mutex_lock(s->mutex);
 	i2c_lock(I2C_PORT_ACCEL, 1);
-	ret = i2c_xfer(I2C_PORT_ACCEL, accel_addr[id], &reg, 1, acc, 6,
+	ret = i2c_xfer(I2C_PORT_ACCEL, s->i2c_addr, &reg, 1, acc, 6,
 			I2C_XFER_SINGLE);
 	i2c_lock(I2C_PORT_ACCEL, 0);
-	mutex_unlock(&accel_mutex[id]);
+	mutex_unlock(s->mutex);
 
 	if (ret != EC_SUCCESS)
 		return ret;
 
 	/* Determine multiplier based on stored range. */
-	switch (ranges[sensor_range[id]].reg) {
+	switch (ranges[data->sensor_range].reg) {
 	case KXCJ9_GSEL_2G:
 		multiplier = 1;
 		break;
@@ -436,17 +430,16 @@ int accel_read(const enum accel_id id, int * const x_acc, int * const y_acc,
 	return EC_SUCCESS;
 }
 
-int accel_init(const enum accel_id id)
+static int init(const struct motion_sensor_t *s)
 {
+	struct kxcj9_data *data = s->drv_data;
 	int ret = EC_SUCCESS;
 	int cnt = 0, ctrl1, ctrl2;
 
-	/* Check for valid id. */
-	if (id < 0 || id >= ACCEL_COUNT)
-		return EC_ERROR_INVAL;
+	i2c_regcache_init(&data->regs, cached_regs, ARRAY_SIZE(cached_regs));
 
 	/* Disable the sensor to allow for changing of critical parameters. */
-	ret = disable_sensor(id, &ctrl1);
+	ret = disable_sensor(s, &ctrl1);
 	if (ret != EC_SUCCESS)
 		return ret;
 
@@ -455,17 +448,19 @@ int accel_init(const enum accel_id id)
 	 * the sensor is unknown here. Initiate software reset to restore
 	 * sensor to default.
 	 */
-	ret = raw_write8(accel_addr[id], KXCJ9_CTRL2, KXCJ9_CTRL2_SRST);
+	ret = raw_write8(s, KXCJ9_CTRL2, KXCJ9_CTRL2_SRST);
 	if (ret != EC_SUCCESS)
 		return ret;
 
 	/* Wait until software reset is complete or timeout. */
 	while (1) {
-		ret = raw_read8(accel_addr[id], KXCJ9_CTRL2, &ctrl2);
+		ret = raw_read8(s, KXCJ9_CTRL2, &ctrl2);
 
-		/* Reset complete. */
-		if (ret == EC_SUCCESS && !(ctrl2 & KXCJ9_CTRL2_SRST))
+		/* Reset complete; every register is back to its default. */
+		if (ret == EC_SUCCESS && !(ctrl2 & KXCJ9_CTRL2_SRST)) {
+			i2c_regcache_invalidate(&data->regs);
 			break;
+		}
 
 		/* Check for timeout. */
 		if (cnt++ > 5)
@@ -475,24 +470,29 @@ int accel_init(const enum accel_id id)
 		msleep(10);
 	}
 
+	/* Start from 2G, 12-bit and 50Hz. */
+	data->sensor_range = 0;
+	data->sensor_resolution = 1;
+	data->sensor_datarate = 6;
+
 	/* Set resolution and range. */
-	ctrl1 = resolutions[sensor_resolution[id]].reg |
-			ranges[sensor_range[id]].reg;
+	ctrl1 = resolutions[data->sensor_resolution].reg |
+			ranges[data->sensor_range].reg;
 #ifdef CONFIG_ACCEL_INTERRUPTS
 	/* Enable wake up (motion detect) functionality. */
 	ctrl1 |= KXCJ9_CTRL1_WUFE;
 #endif
-	ret = raw_write8(accel_addr[id], KXCJ9_CTRL1, ctrl1);
+	ret = raw_write8(s, KXCJ9_CTRL1, ctrl1);
 
 #ifdef CONFIG_ACCEL_INTERRUPTS
 	/* Set interrupt polarity to rising edge and keep interrupt disabled. */
-	ret |= raw_write8(accel_addr[id], KXCJ9_INT_CTRL1, KXCJ9_INT_CTRL1_IEA);
+	ret |= raw_write8(s, KXCJ9_INT_CTRL1, KXCJ9_INT_CTRL1_IEA);
 
 	/* Set output data rate for wake-up interrupt function. */
-	ret |= raw_write8(accel_addr[id], KXCJ9_CTRL2, KXCJ9_OWUF_100_0HZ);
+	ret |= raw_write8(s, KXCJ9_CTRL2, KXCJ9_OWUF_100_0HZ);
 
 	/* Set interrupt to trigger on motion on any axis. */
-	ret |= raw_write8(accel_addr[id], KXCJ9_INT_CTRL2,
+	ret |= raw_write8(s, KXCJ9_INT_CTRL2,
 			KXCJ9_INT_SRC2_XNWU | KXCJ9_INT_SRC2_XPWU |
 			KXCJ9_INT_SRC2_YNWU | KXCJ9_INT_SRC2_YPWU |
 			KXCJ9_INT_SRC2_ZNWU | KXCJ9_INT_SRC2_ZPWU);
@@ -506,11 +506,25 @@ int accel_init(const enum accel_id id)
 #endif
 
 	/* Set output data rate. */
-	ret |= raw_write8(accel_addr[id], KXCJ9_DATA_CTRL,
-			datarates[sensor_datarate[id]].reg);
+	ret |= raw_write8(s, KXCJ9_DATA_CTRL,
+			datarates[data->sensor_datarate].reg);
 
 	/* Enable the sensor. */
-	ret |= enable_sensor(id, ctrl1);
+	ret |= enable_sensor(s, ctrl1);
 
 	return ret;
 }
+
+const struct accelgyro_drv kxcj9_drv = {
+	.init = init,
+	.read = read,
+	.set_range = set_range,
+	.get_range = get_range,
+	.set_resolution = set_resolution,
+	.get_resolution = get_resolution,
+	.set_data_rate = set_data_rate,
+	.get_data_rate = get_data_rate,
+#ifdef CONFIG_ACCEL_INTERRUPTS
+	.set_interrupt = set_interrupt,
+#endif
+};
@@ -8,6 +8,8 @@
 #ifndef __CROS_EC_ACCEL_KXCJ9_H
 #define __CROS_EC_ACCEL_KXCJ9_H
 
+#include "i2c.h"
+
 /*
  * 7-bit address is 000111Xb. Where 'X' is determined
  * by the voltage on the ADDR pin.
@@ -100,16 +102,19 @@
 #define KXCJ9_OSA_1600_HZ	7
 
 
-#ifdef CONFIG_ACCEL_INTERRUPTS
-/**
- * Setup a one-time accel interrupt. If the threshold is low enough, the
- * interrupt may trigger due simply to noise and not any real motion. If the
- * threshold is 0, the interrupt will fire immediately.
- *
- * @param id Target accelerometer
- * @param threshold Threshold for interrupt in units of counts.
+/*
+ * Driver state for each KXCJ9 in the board's motion_sensors[] table. The
+ * values are indices into the driver's tables of ranges, resolutions and
+ * output data rates.
  */
-int accel_set_interrupt(const enum accel_id id, unsigned int threshold);
-#endif
+struct kxcj9_data {
+	int sensor_range;
+	int sensor_resolution;
+	int sensor_datarate;
+	/* Cached configuration registers */
+	struct i2c_regcache regs;
+};
+
+extern const struct accelgyro_drv kxcj9_drv;
 
 #endif /* __CROS_EC_ACCEL_KXCJ9_H */
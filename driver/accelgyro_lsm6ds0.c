@@ -11,6 +11,7 @@
 #include "driver/accelgyro_lsm6ds0.h"
 #include "hooks.h"
 #include "i2c.h"
+#include "motion_sense.h"
 #include "task.h"
 #include "util.h"
 
@@ -24,14 +25,21 @@ struct accel_param_pair {
 };
 
 /* List of range values in +/-G's and their associated register values. */
-const struct accel_param_pair ranges[] = {
+static const struct accel_param_pair g_ranges[] = {
 	{2, LSM6DS0_GSEL_2G},
 	{4, LSM6DS0_GSEL_4G},
 	{8, LSM6DS0_GSEL_8G}
 };
 
-/* List of ODR values in mHz and their associated register values. */
-const struct accel_param_pair datarates[] = {
+/* List of range values in +/-deg/s and their associated register values. */
+static const struct accel_param_pair dps_ranges[] = {
+	{245,  LSM6DS0_DPS_SEL_245},
+	{500,  LSM6DS0_DPS_SEL_500},
+	{2000, LSM6DS0_DPS_SEL_2000}
+};
+
+/* List of accelerometer ODR values in mHz and their register values. */
+static const struct accel_param_pair accel_datarates[] = {
 	{10000,    LSM6DS0_ODR_10HZ},
 	{50000,    LSM6DS0_ODR_50HZ},
 	{119000,   LSM6DS0_ODR_119HZ},
@@ -40,16 +48,51 @@ const struct accel_param_pair datarates[] = {
 	{952000,   LSM6DS0_ODR_982HZ}
 };
 
-/* Current range of each accelerometer. The value is an index into ranges[]. */
-static int sensor_range[ACCEL_COUNT] = {0, 0};
+/* List of gyro ODR values in mHz and their register values. */
+static const struct accel_param_pair gyro_datarates[] = {
+	{14900,    LSM6DS0_ODR_15HZ},
+	{59500,    LSM6DS0_ODR_59HZ},
+	{119000,   LSM6DS0_ODR_119HZ},
+	{238000,   LSM6DS0_ODR_238HZ},
+	{476000,   LSM6DS0_ODR_476HZ},
+	{952000,   LSM6DS0_ODR_982HZ}
+};
 
-/*
- * Current output data rate of each accelerometer. The value is an index into
- * datarates[].
- */
-static int sensor_datarate[ACCEL_COUNT] = {1, 1};
+static const struct accel_param_pair *get_range_table(
+		const struct motion_sensor_t *s, int *psize)
+{
+	if (s->type == MOTIONSENSE_TYPE_GYRO) {
+		*psize = ARRAY_SIZE(dps_ranges);
+		return dps_ranges;
+	}
+	*psize = ARRAY_SIZE(g_ranges);
+	return g_ranges;
+}
 
-static struct mutex accel_mutex[ACCEL_COUNT];
+static const struct accel_param_pair *get_odr_table(
+		const struct motion_sensor_t *s, int *psize)
+{
+	if (s->type == MOTIONSENSE_TYPE_GYRO) {
+		*psize = ARRAY_SIZE(gyro_datarates);
+		return gyro_datarates;
+	}
+	*psize = ARRAY_SIZE(accel_datarates);
+	return accel_datarates;
+}
+
+/* Register holding the range and ODR of the sensor. */
+static int get_ctrl_reg(const struct motion_sensor_t *s)
+{
+	return s->type == MOTIONSENSE_TYPE_GYRO ? LSM6DS0_CTRL_REG1_G :
+		LSM6DS0_CTRL_REG6_XL;
+}
+
+/* First of the six output registers of the sensor. */
+static int get_xyz_reg(const struct motion_sensor_t *s)
+{
+	return s->type == MOTIONSENSE_TYPE_GYRO ? LSM6DS0_OUT_X_L_G :
+		LSM6DS0_OUT_X_L_XL;
+}
 
 /**
  * Find index into a accel_param_pair that matches the given engineering value
@@ -94,192 +137,315 @@ static int raw_write8(const int addr, const int reg, int data)
 	return i2c_write8(I2C_PORT_ACCEL, addr, reg, data);
 }
 
-int accel_set_range(const enum accel_id id, const int range, const int rnd)
+/**
+ * Update some bits of a register. The caller must hold the sensor mutex.
+ */
+static int update_reg(const struct motion_sensor_t *s, int reg, int mask,
+		      int val)
 {
-	int ret, index, ctrl_reg6;
+	int ret, tmp;
 
-	/* Find index for interface pair matching the specified range. */
-	index = find_param_index(range, rnd, ranges, ARRAY_SIZE(ranges));
+	ret = raw_read8(s->i2c_addr, reg, &tmp);
+	if (ret == EC_SUCCESS)
+		ret = raw_write8(s->i2c_addr, reg, (tmp & ~mask) | val);
+
+	return ret;
+}
+
+/**
+ * Update some bits of the sensor's control register.
+ *
+ * @param s Target sensor
+ * @param mask Bits to change
+ * @param val New value of those bits
+ *
+ * @return EC_SUCCESS if successful, non-zero if error.
+ */
+static int update_ctrl_reg(const struct motion_sensor_t *s, int mask, int val)
+{
+	int ret;
 
 	/*
 	 * Lock accel resource to prevent another task from attempting
 	 * to write accel parameters until we are done.
 	 */
-	mutex_lock(&accel_mutex[id]);
+	mutex_lock(s->mutex);
+	ret = update_reg(s, get_ctrl_reg(s), mask, val);
+	mutex_unlock(s->mutex);
 
-	ret = raw_read8(accel_addr[id], LSM6DS0_CTRL_REG6_XL, &ctrl_reg6);
-	if (ret != EC_SUCCESS)
-		goto accel_cleanup;
+	return ret;
+}
+
+static int set_range(const struct motion_sensor_t *s, int range, int rnd)
+{
+	struct lsm6ds0_data *data = s->drv_data;
+	const struct accel_param_pair *ranges;
+	int ret, index, size;
+
+	/* Find index for interface pair matching the specified range. */
+	ranges = get_range_table(s, &size);
+	index = find_param_index(range, rnd, ranges, size);
 
-	ctrl_reg6 = (ctrl_reg6 & ~LSM6DS0_GSEL_ALL) | ranges[index].reg;
-	ret = raw_write8(accel_addr[id], LSM6DS0_CTRL_REG6_XL, ctrl_reg6);
+	/* The accel and gyro range fields are at the same place. */
+	ret = update_ctrl_reg(s, LSM6DS0_GSEL_ALL, ranges[index].reg);
 
-accel_cleanup:
-	/* Unlock accel resource and save new range if written successfully. */
-	mutex_unlock(&accel_mutex[id]);
+	/* Save new range if written successfully. */
 	if (ret == EC_SUCCESS)
-		sensor_range[id] = index;
+		data->sensor_range = index;
 
-	return EC_SUCCESS;
+	return ret;
 }
 
-int accel_get_range(const enum accel_id id, int * const range)
+static int get_range(const struct motion_sensor_t *s, int *range)
 {
-	/* Check for valid id. */
-	if (id < 0 || id >= ACCEL_COUNT)
-		return EC_ERROR_INVAL;
+	struct lsm6ds0_data *data = s->drv_data;
+	int size;
 
-	*range = ranges[sensor_range[id]].val;
+	*range = get_range_table(s, &size)[data->sensor_range].val;
 	return EC_SUCCESS;
 }
 
-int accel_set_resolution(const enum accel_id id, const int res, const int rnd)
+static int set_resolution(const struct motion_sensor_t *s, int res, int rnd)
 {
-	/* Check for valid id. */
-	if (id < 0 || id >= ACCEL_COUNT)
-		return EC_ERROR_INVAL;
-
 	/* Only one resolution, LSM6DS0_RESOLUTION, so nothing to do. */
 	return EC_SUCCESS;
 }
 
-int accel_get_resolution(const enum accel_id id, int * const res)
+static int get_resolution(const struct motion_sensor_t *s, int *res)
 {
-	/* Check for valid id. */
-	if (id < 0 || id >= ACCEL_COUNT)
-		return EC_ERROR_INVAL;
-
 	*res = LSM6DS0_RESOLUTION;
 	return EC_SUCCESS;
 }
 
-int accel_set_datarate(const enum accel_id id, const int rate, const int rnd)
+static int set_data_rate(const struct motion_sensor_t *s, int rate, int rnd)
 {
-	int ret, index, ctrl_reg6;
-
-	/* Check for valid id. */
-	if (id < 0 || id >= ACCEL_COUNT)
-		return EC_ERROR_INVAL;
-
-	/* Find index for interface pair matching the specified range. */
-	index = find_param_index(rate, rnd, datarates, ARRAY_SIZE(datarates));
-
-	/*
-	 * Lock accel resource to prevent another task from attempting
-	 * to write accel parameters until we are done.
-	 */
-	mutex_lock(&accel_mutex[id]);
+	struct lsm6ds0_data *data = s->drv_data;
+	const struct accel_param_pair *datarates;
+	int ret, index, size;
 
-	ret = raw_read8(accel_addr[id], LSM6DS0_CTRL_REG6_XL, &ctrl_reg6);
-	if (ret != EC_SUCCESS)
-		goto accel_cleanup;
+	/* Find index for interface pair matching the specified rate. */
+	datarates = get_odr_table(s, &size);
+	index = find_param_index(rate, rnd, datarates, size);
 
-	ctrl_reg6 = (ctrl_reg6 & ~LSM6DS0_ODR_ALL) | datarates[index].reg;
-	ret = raw_write8(accel_addr[id], LSM6DS0_CTRL_REG6_XL, ctrl_reg6);
+	ret = update_ctrl_reg(s, LSM6DS0_ODR_ALL, datarates[index].reg);
 
-accel_cleanup:
-	/* Unlock accel resource and save new ODR if written successfully. */
-	mutex_unlock(&accel_mutex[id]);
+	/* Save new ODR if written successfully. */
 	if (ret == EC_SUCCESS)
-		sensor_datarate[id] = index;
+		data->sensor_datarate = index;
 
-	return EC_SUCCESS;
+	return ret;
 }
 
-int accel_get_datarate(const enum accel_id id, int * const rate)
+static int get_data_rate(const struct motion_sensor_t *s, int *rate)
 {
-	/* Check for valid id. */
-	if (id < 0 || id >= ACCEL_COUNT)
-		return EC_ERROR_INVAL;
+	struct lsm6ds0_data *data = s->drv_data;
+	int size;
 
-	*rate = datarates[sensor_datarate[id]].val;
+	*rate = get_odr_table(s, &size)[data->sensor_datarate].val;
 	return EC_SUCCESS;
 }
 
 #ifdef CONFIG_ACCEL_INTERRUPTS
-int accel_set_interrupt(const enum accel_id id, unsigned int threshold)
+static int set_interrupt(const struct motion_sensor_t *s,
+			 unsigned int threshold)
 {
 	/* Currently unsupported. */
 	return EC_ERROR_UNKNOWN;
 }
 #endif
 
-int accel_read(const enum accel_id id, int * const x_acc, int * const y_acc,
-		int * const z_acc)
+/**
+ * Convert one sample, as read from the six output registers, to counts.
+ */
+static void decode_xyz(const struct motion_sensor_t *s, const uint8_t *acc,
+		       int *x_acc, int *y_acc, int *z_acc)
+{
+	struct lsm6ds0_data *data = s->drv_data;
+	const struct accel_param_pair *ranges;
+	int multiplier, size;
+
+	/*
+	 * Scale to counts of the smallest range, so that for the
+	 * accelerometer ACCEL_G counts are always 1G.
+	 */
+	ranges = get_range_table(s, &size);
+	multiplier = ranges[data->sensor_range].val / ranges[0].val;
+
+	/*
+	 * Convert data to signed 12-bit value. Note order of registers:
+	 *
+	 * acc[0] = LSM6DS0_OUT_X_L
+	 * acc[1] = LSM6DS0_OUT_X_H
+	 * acc[2] = LSM6DS0_OUT_Y_L
+	 * acc[3] = LSM6DS0_OUT_Y_H
+	 * acc[4] = LSM6DS0_OUT_Z_L
+	 * acc[5] = LSM6DS0_OUT_Z_H
+	 */
+	*x_acc = multiplier * ((int16_t)(acc[1] << 8 | acc[0])) >> 4;
+	*y_acc = multiplier * ((int16_t)(acc[3] << 8 | acc[2])) >> 4;
+	*z_acc = multiplier * ((int16_t)(acc[5] << 8 | acc[4])) >> 4;
+}
+
+static int read(const struct motion_sensor_t *s, int *x_acc, int *y_acc,
+		int *z_acc)
 {
 	uint8_t acc[6];
-	uint8_t reg = LSM6DS0_OUT_X_L_XL;
-	int ret, multiplier;
+	uint8_t reg = get_xyz_reg(s);
+	int ret;
 
-	/* Read 6 bytes starting at LSM6DS0_OUT_X_L_XL. */
-	mutex_lock(&accel_mutex[id]);
+	/* Read 6 bytes starting at the X low byte. */
+	mutex_lock(s->mutex);
 	i2c_lock(I2C_PORT_ACCEL, 1);
-	ret = i2c_xfer(I2C_PORT_ACCEL, accel_addr[id], &reg, 1, acc, 6,
+	ret = i2c_xfer(I2C_PORT_ACCEL, s->i2c_addr, &reg, 1, acc, 6,
 			I2C_XFER_SINGLE);
 	i2c_lock(I2C_PORT_ACCEL, 0);
-	mutex_unlock(&accel_mutex[id]);
+	mutex_unlock(s->mutex);
 
 	if (ret != EC_SUCCESS)
 		return ret;
 
-	/* Determine multiplier based on stored range. */
-	switch (ranges[sensor_range[id]].reg) {
-	case LSM6DS0_GSEL_2G:
-		multiplier = 1;
-		break;
-	case LSM6DS0_GSEL_4G:
-		multiplier = 2;
-		break;
-	case LSM6DS0_GSEL_8G:
-		multiplier = 4;
-		break;
-	default:
-		return EC_ERROR_UNKNOWN;
+	decode_xyz(s, acc, x_acc, y_acc, z_acc);
+	return EC_SUCCESS;
+}
+
+#ifdef CONFIG_ACCEL_HW_FIFO
+static int set_fifo_watermark(const struct motion_sensor_t *s, int watermark)
+{
+	int ret;
+
+	/*
+	 * The FIFO keeps accelerometer and gyro data in step, but only the
+	 * accelerometer is drained from it; the gyro is still polled.
+	 */
+	if (s->type != MOTIONSENSE_TYPE_ACCEL)
+		return EC_ERROR_UNIMPLEMENTED;
+
+	watermark = MIN(watermark, LSM6DS0_FIFO_FTH_MASK);
+
+	mutex_lock(s->mutex);
+
+	/* Continuous mode keeps the newest samples if the FIFO fills. */
+	ret = raw_write8(s->i2c_addr, LSM6DS0_FIFO_CTRL, watermark ?
+			 LSM6DS0_FIFO_MODE_CONT | watermark :
+			 LSM6DS0_FIFO_MODE_BYPASS);
+	if (ret == EC_SUCCESS)
+		ret = update_reg(s, LSM6DS0_CTRL_REG9,
+				 LSM6DS0_CTRL_REG9_FIFO_EN,
+				 watermark ? LSM6DS0_CTRL_REG9_FIFO_EN : 0);
+	if (ret == EC_SUCCESS)
+		ret = update_reg(s, LSM6DS0_INT1_CTRL, LSM6DS0_INT1_FTH,
+				 watermark ? LSM6DS0_INT1_FTH : 0);
+
+	mutex_unlock(s->mutex);
+	return ret;
+}
+
+static int read_fifo(const struct motion_sensor_t *s, vector_3_t *v,
+		     int max, int *count)
+{
+	uint8_t gyro[6], acc[6];
+	uint8_t gyro_reg = LSM6DS0_OUT_X_L_G;
+	uint8_t acc_reg = LSM6DS0_OUT_X_L_XL;
+	int ret, src, odr_g, i, n = 0;
+
+	*count = 0;
+
+	mutex_lock(s->mutex);
+
+	ret = raw_read8(s->i2c_addr, LSM6DS0_FIFO_SRC, &src);
+	if (ret == EC_SUCCESS)
+		ret = raw_read8(s->i2c_addr, LSM6DS0_CTRL_REG1_G, &odr_g);
+	if (ret == EC_SUCCESS) {
+		n = MIN(src & LSM6DS0_FIFO_SRC_FSS_MASK,
+			MIN(max, LSM6DS0_FIFO_SIZE));
 	}
 
 	/*
-	 * Convert data to signed 12-bit value. Note order of registers:
-	 *
-	 * acc[0] = LSM6DS0_OUT_X_L_XL
-	 * acc[1] = LSM6DS0_OUT_X_H_XL
-	 * acc[2] = LSM6DS0_OUT_Y_L_XL
-	 * acc[3] = LSM6DS0_OUT_Y_H_XL
-	 * acc[4] = LSM6DS0_OUT_Z_L_XL
-	 * acc[5] = LSM6DS0_OUT_Z_H_XL
+	 * While the gyro is on, each FIFO slot holds a gyro sample (OUT_X_L_G
+	 * 18h to OUT_Z_H_G 1Dh) as well as an accelerometer sample (OUT_X_L_XL
+	 * 28h to OUT_Z_H_XL 2Dh), and the slot only moves on once both have
+	 * been read; see "Retrieving data from FIFO" in the datasheet.  The
+	 * two halves aren't adjacent, so read each one explicitly rather than
+	 * relying on the address rolling over, and drop the gyro half, which
+	 * is still polled.  With the gyro powered down, slots hold only the
+	 * accelerometer sample.
 	 */
-	*x_acc = multiplier * ((int16_t)(acc[1] << 8 | acc[0])) >> 4;
-	*y_acc = multiplier * ((int16_t)(acc[3] << 8 | acc[2])) >> 4;
-	*z_acc = multiplier * ((int16_t)(acc[5] << 8 | acc[4])) >> 4;
+	if (n)
+		i2c_lock(I2C_PORT_ACCEL, 1);
+	for (i = 0; ret == EC_SUCCESS && i < n; i++) {
+		if (odr_g & LSM6DS0_ODR_ALL)
+			ret = i2c_xfer(I2C_PORT_ACCEL, s->i2c_addr,
+				       &gyro_reg, 1, gyro, sizeof(gyro),
+				       I2C_XFER_SINGLE);
+		if (ret == EC_SUCCESS)
+			ret = i2c_xfer(I2C_PORT_ACCEL, s->i2c_addr,
+				       &acc_reg, 1, acc, sizeof(acc),
+				       I2C_XFER_SINGLE);
+		if (ret == EC_SUCCESS)
+			decode_xyz(s, acc, &v[i][0], &v[i][1], &v[i][2]);
+	}
+	if (n)
+		i2c_lock(I2C_PORT_ACCEL, 0);
 
+	mutex_unlock(s->mutex);
+
+	if (ret != EC_SUCCESS)
+		return ret;
+
+	*count = n;
 	return EC_SUCCESS;
 }
+#endif
 
-int accel_init(const enum accel_id id)
+static int init(const struct motion_sensor_t *s)
 {
-	int ret, ctrl_reg6;
-
-	/* Check for valid id. */
-	if (id < 0 || id >= ACCEL_COUNT)
-		return EC_ERROR_INVAL;
+	struct lsm6ds0_data *data = s->drv_data;
+	const struct accel_param_pair *ranges, *datarates;
+	int ret = EC_SUCCESS, size;
 
-	mutex_lock(&accel_mutex[id]);
+	mutex_lock(s->mutex);
 
 	/*
 	 * This sensor can be powered through an EC reboot, so the state of
 	 * the sensor is unknown here. Initiate software reset to restore
-	 * sensor to default.
+	 * sensor to default. The accelerometer and gyro share the device, so
+	 * only the accelerometer resets it; the gyro is set up by writing its
+	 * whole control register below.
 	 */
-	ret = raw_write8(accel_addr[id], LSM6DS0_CTRL_REG8, 1);
-	if (ret != EC_SUCCESS)
-		goto accel_cleanup;
-
-	/* Set ODR and range. */
-	ctrl_reg6 = datarates[sensor_datarate[id]].reg |
-			ranges[sensor_range[id]].reg;
+	if (s->type == MOTIONSENSE_TYPE_ACCEL) {
+		ret = raw_write8(s->i2c_addr, LSM6DS0_CTRL_REG8, 1);
+		if (ret != EC_SUCCESS)
+			goto accel_cleanup;
+	}
 
-	ret = raw_write8(accel_addr[id], LSM6DS0_CTRL_REG6_XL, ctrl_reg6);
+	/* Set ODR and range, starting from ~50Hz and the lowest range. */
+	data->sensor_range = 0;
+	data->sensor_datarate = 1;
+	ranges = get_range_table(s, &size);
+	datarates = get_odr_table(s, &size);
+	ret = raw_write8(s->i2c_addr, get_ctrl_reg(s),
+			 datarates[data->sensor_datarate].reg |
+			 ranges[data->sensor_range].reg);
 
 accel_cleanup:
-	mutex_unlock(&accel_mutex[id]);
+	mutex_unlock(s->mutex);
 	return ret;
 }
+
+const struct accelgyro_drv lsm6ds0_drv = {
+	.init = init,
+	.read = read,
+	.set_range = set_range,
+	.get_range = get_range,
+	.set_resolution = set_resolution,
+	.get_resolution = get_resolution,
+	.set_data_rate = set_data_rate,
+	.get_data_rate = get_data_rate,
+#ifdef CONFIG_ACCEL_INTERRUPTS
+	.set_interrupt = set_interrupt,
+#endif
+#ifdef CONFIG_ACCEL_HW_FIFO
+	.set_fifo_watermark = set_fifo_watermark,
+	.read_fifo = read_fifo,
+#endif
+};
@@ -16,21 +16,52 @@
 #define LSM6DS0_ADDR1             0xd6
 
 /* Chip specific registers. */
+#define LSM6DS0_INT1_CTRL         0x0c
+#define LSM6DS0_CTRL_REG1_G       0x10
+#define LSM6DS0_OUT_X_L_G         0x18
+#define LSM6DS0_OUT_X_H_G         0x19
+#define LSM6DS0_OUT_Y_L_G         0x1a
+#define LSM6DS0_OUT_Y_H_G         0x1b
+#define LSM6DS0_OUT_Z_L_G         0x1c
+#define LSM6DS0_OUT_Z_H_G         0x1d
 #define LSM6DS0_CTRL_REG6_XL      0x20
 #define LSM6DS0_CTRL_REG8         0x22
+#define LSM6DS0_CTRL_REG9         0x23
 #define LSM6DS0_OUT_X_L_XL        0x28
 #define LSM6DS0_OUT_X_H_XL        0x29
 #define LSM6DS0_OUT_Y_L_XL        0x2a
 #define LSM6DS0_OUT_Y_H_XL        0x2b
 #define LSM6DS0_OUT_Z_L_XL        0x2c
 #define LSM6DS0_OUT_Z_H_XL        0x2d
+#define LSM6DS0_FIFO_CTRL         0x2e
+#define LSM6DS0_FIFO_SRC          0x2f
 
+#define LSM6DS0_INT1_FTH          (1 << 3)
+
+#define LSM6DS0_CTRL_REG9_FIFO_EN (1 << 1)
+
+#define LSM6DS0_FIFO_MODE_BYPASS  (0 << 5)
+#define LSM6DS0_FIFO_MODE_CONT    (6 << 5)
+#define LSM6DS0_FIFO_FTH_MASK     0x1f
+#define LSM6DS0_FIFO_SRC_FSS_MASK 0x3f
+
+/* Depth of the hardware FIFO, in samples. */
+#define LSM6DS0_FIFO_SIZE         32
 
 #define LSM6DS0_GSEL_2G         (0 << 3)
 #define LSM6DS0_GSEL_4G         (2 << 3)
 #define LSM6DS0_GSEL_8G         (3 << 3)
 #define LSM6DS0_GSEL_ALL        (3 << 3)
 
+#define LSM6DS0_DPS_SEL_245     (0 << 3)
+#define LSM6DS0_DPS_SEL_500     (1 << 3)
+#define LSM6DS0_DPS_SEL_2000    (3 << 3)
+#define LSM6DS0_DPS_SEL_ALL     (3 << 3)
+
+/* Gyro ODRs; the accelerometer runs at the gyro ODR while it is on. */
+#define LSM6DS0_ODR_15HZ        (1 << 5)
+#define LSM6DS0_ODR_59HZ        (2 << 5)
+
 #define LSM6DS0_ODR_10HZ        (1 << 5)
 #define LSM6DS0_ODR_50HZ        (2 << 5)
 #define LSM6DS0_ODR_119HZ       (3 << 5)
@@ -42,4 +73,16 @@
 /* Sensor resolution in number of bits. This sensor has fixed resolution. */
 #define LSM6DS0_RESOLUTION      16
 
+/*
+ * Driver state for each accelerometer or gyro of an LSM6DS0 in the board's
+ * motion_sensors[] table. The values are indices into the driver's tables of
+ * ranges and output data rates.
+ */
+struct lsm6ds0_data {
+	int sensor_range;
+	int sensor_datarate;
+};
+
+extern const struct accelgyro_drv lsm6ds0_drv;
+
 #endif /* __CROS_EC_ACCEL_LSM6DS0_H */
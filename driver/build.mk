@@ -8,6 +8,7 @@
 
 # Accelerometers
 driver-$(CONFIG_ACCEL_KXCJ9)+=accel_kxcj9.o
+driver-$(CONFIG_ACCELGYRO_LSM6DS0)+=accelgyro_lsm6ds0.o
 
 # ALS drivers
 driver-$(CONFIG_ALS_ISL29035)+=als_isl29035.o
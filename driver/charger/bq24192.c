@@ -13,6 +13,7 @@
 #include "hooks.h"
 #include "i2c.h"
 #include "printf.h"
+#include "task.h"
 #include "util.h"
 
 /* Console output macros */
@@ -36,6 +37,24 @@ static const struct charger_info bq24192_charger_info = {
 static const int input_current_steps[] = {
 	100, 150, 500, 900, 1200, 1500, 2000, 3000};
 
+/*
+ * Registers which only change when the EC writes them, once the I2C watchdog
+ * is off; until then a watchdog expiry resets them.  INPUT_CTRL isn't one:
+ * the charger sets the input current limit itself when an adapter is plugged
+ * in.
+ */
+static const uint8_t cached_regs[] = {
+	BQ24192_REG_POWER_ON_CFG,
+	BQ24192_REG_CHG_CURRENT,
+	BQ24192_REG_PRE_CHG_CURRENT,
+	BQ24192_REG_CHG_VOLTAGE,
+	BQ24192_REG_CHG_TERM_TMR,
+};
+
+/* Empty until bq24192_init() turns the watchdog off */
+static struct i2c_regcache regs;
+static struct mutex regs_lock;
+
 static int bq24192_read(int reg, int *value)
 {
 	return i2c_read8(I2C_PORT_CHARGER, BQ24192_ADDR, reg, value);
@@ -46,45 +65,56 @@ static int bq24192_write(int reg, int value)
 	return i2c_write8(I2C_PORT_CHARGER, BQ24192_ADDR, reg, value);
 }
 
+/**
+ * Replace the bits in <mask> of a register, using the cached value if any.
+ */
+static int bq24192_update(int reg, int mask, int value)
+{
+	int rv;
+
+	mutex_lock(&regs_lock);
+	rv = i2c_regcache_update8(&regs, I2C_PORT_CHARGER, BQ24192_ADDR, reg,
+				  mask, value);
+	mutex_unlock(&regs_lock);
+
+	return rv;
+}
+
 static int bq24192_watchdog_reset(void)
 {
 	int rv, val;
 
-	rv = bq24192_read(BQ24192_REG_POWER_ON_CFG, &val);
-	if (rv)
-		return rv;
-	val |= (1 << 6);
-	return bq24192_write(BQ24192_REG_POWER_ON_CFG, val) ||
-	       bq24192_write(BQ24192_REG_POWER_ON_CFG, val);
+	mutex_lock(&regs_lock);
+	rv = i2c_regcache_read8(&regs, I2C_PORT_CHARGER, BQ24192_ADDR,
+				BQ24192_REG_POWER_ON_CFG, &val);
+	/* The reset bit clears itself, so write it past the cache */
+	if (!rv) {
+		val |= (1 << 6);
+		rv = bq24192_write(BQ24192_REG_POWER_ON_CFG, val) ||
+		     bq24192_write(BQ24192_REG_POWER_ON_CFG, val);
+	}
+	mutex_unlock(&regs_lock);
+
+	return rv;
 }
 
 static int bq24192_set_terminate_current(int current)
 {
-	int reg_val, rv;
 	int val = (current - 128) / 128;
 
-	rv = bq24192_read(BQ24192_REG_PRE_CHG_CURRENT, &reg_val);
-	if (rv)
-		return rv;
-	reg_val = (reg_val & ~0xf) | (val & 0xf);
-	return bq24192_write(BQ24192_REG_PRE_CHG_CURRENT, reg_val);
+	return bq24192_update(BQ24192_REG_PRE_CHG_CURRENT, 0xf, val);
 }
 
 int charger_enable_otg_power(int enabled)
 {
-	int val, rv;
-
 	gpio_set_level(GPIO_BCHGR_OTG, enabled);
-	rv = bq24192_read(BQ24192_REG_POWER_ON_CFG, &val);
-	if (rv)
-		return rv;
-	val = (val & ~0x30) | (enabled ? 0x20 : 0x10);
-	return bq24192_write(BQ24192_REG_POWER_ON_CFG, val);
+	return bq24192_update(BQ24192_REG_POWER_ON_CFG, 0x30,
+			      enabled ? 0x20 : 0x10);
 }
 
 int charger_set_input_current(int input_current)
 {
-	int i, value, rv;
+	int i;
 
 	for (i = 1; i < ARRAY_SIZE(input_current_steps); ++i)
 		if (input_current_steps[i] > input_current) {
@@ -94,12 +124,7 @@ int charger_set_input_current(int input_current)
 	if (i == ARRAY_SIZE(input_current_steps))
 		--i;
 
-	rv = bq24192_read(BQ24192_REG_INPUT_CTRL, &value);
-	if (rv)
-		return rv;
-	value = value & ~(0x7);
-	value |= (i & 0x7);
-	return bq24192_write(BQ24192_REG_INPUT_CTRL, value);
+	return bq24192_update(BQ24192_REG_INPUT_CTRL, 0x7, i);
 }
 
 int charger_get_input_current(int *input_current)
@@ -163,16 +188,11 @@ int charger_get_current(int *current)
 
 int charger_set_current(int current)
 {
-	int rv, val;
 	const struct charger_info * const info = charger_get_info();
 
 	current = charger_closest_current(current);
-	rv = bq24192_read(BQ24192_REG_CHG_CURRENT, &val);
-	if (rv)
-		return rv;
-	val = val & 0x3;
-	val |= ((current - info->current_min) / info->current_step) << 2;
-	return bq24192_write(BQ24192_REG_CHG_CURRENT, val);
+	return bq24192_update(BQ24192_REG_CHG_CURRENT, 0xfc,
+		((current - info->current_min) / info->current_step) << 2);
 }
 
 int charger_get_voltage(int *voltage)
@@ -190,15 +210,10 @@ int charger_get_voltage(int *voltage)
 
 int charger_set_voltage(int voltage)
 {
-	int rv, val;
 	const struct charger_info * const info = charger_get_info();
 
-	rv = bq24192_read(BQ24192_REG_CHG_VOLTAGE, &val);
-	if (rv)
-		return rv;
-	val = val & 0x3;
-	val |= ((voltage - info->voltage_min) / info->voltage_step) << 2;
-	return bq24192_write(BQ24192_REG_CHG_VOLTAGE, val);
+	return bq24192_update(BQ24192_REG_CHG_VOLTAGE, 0xfc,
+		((voltage - info->voltage_min) / info->voltage_step) << 2);
 }
 
 /* Charging power state initialization */
@@ -227,13 +242,13 @@ static void bq24192_init(void)
 	 * TODO(crosbug.com/p/22238): Re-enable watchdog timer and kick it
 	 * periodically in charger task.
 	 */
-	if (bq24192_read(BQ24192_REG_CHG_TERM_TMR, &val))
+	if (bq24192_update(BQ24192_REG_CHG_TERM_TMR, 0x30, 0))
 		return;
 
-	val &= ~0x30;
-
-	if (bq24192_write(BQ24192_REG_CHG_TERM_TMR, val))
-		return;
+	/* Registers now only change when we write them, so start caching */
+	mutex_lock(&regs_lock);
+	i2c_regcache_init(&regs, cached_regs, ARRAY_SIZE(cached_regs));
+	mutex_unlock(&regs_lock);
 
 	if (bq24192_set_terminate_current(128))
 		return;
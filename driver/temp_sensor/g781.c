@@ -13,9 +13,6 @@
 #include "hooks.h"
 #include "util.h"
 
-static int temp_val_local;
-static int temp_val_remote;
-
 /**
  * Determine whether the sensor is powered.
  *
@@ -61,6 +58,36 @@ static int set_temp(const int offset, int temp)
 	return raw_write8(offset, (uint8_t)temp);
 }
 
+#ifdef CONFIG_TEMP_SENSOR_POLL
+/*
+ * The common temp sensor poller spaces out the reads of each channel, so
+ * read just the channel asked for.
+ */
+int g781_get_val(int idx, int *temp_ptr)
+{
+	static const uint8_t temp_reg[] = {
+		[G781_IDX_INTERNAL] = G781_TEMP_LOCAL,
+		[G781_IDX_EXTERNAL] = G781_TEMP_REMOTE,
+	};
+	int temp_c, rv;
+
+	if (!has_power())
+		return EC_ERROR_NOT_POWERED;
+
+	if (idx < 0 || idx >= ARRAY_SIZE(temp_reg))
+		return EC_ERROR_UNKNOWN;
+
+	rv = get_temp(temp_reg[idx], &temp_c);
+	if (rv)
+		return rv;
+
+	*temp_ptr = C_TO_K(temp_c);
+	return EC_SUCCESS;
+}
+#else
+static int temp_val_local;
+static int temp_val_remote;
+
 int g781_get_val(int idx, int *temp_ptr)
 {
 	if (!has_power())
@@ -92,6 +119,7 @@ static void temp_sensor_poll(void)
 	temp_val_remote = C_TO_K(temp_val_remote);
 }
 DECLARE_HOOK(HOOK_SECOND, temp_sensor_poll, HOOK_PRIO_TEMP_SENSOR);
+#endif
 
 static int print_status(void)
 {
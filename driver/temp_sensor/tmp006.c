@@ -14,6 +14,7 @@
 #include "math.h"
 #include "task.h"
 #include "temp_sensor.h"
+#include "timer.h"
 #include "tmp006.h"
 #include "util.h"
 
@@ -45,6 +46,9 @@ struct tmp006_data_t {
 	int fail;  /* Fail flags; non-zero if last read failed */
 	float s0;  /* Sensitivity factor */
 	float b0, b1, b2;  /* Coefficients for self-heating correction */
+#ifdef CONFIG_TEMP_SENSOR_POLL
+	timestamp_t next_poll;  /* When the chip is next due to be read */
+#endif
 };
 
 static struct tmp006_data_t tmp006_data[TMP006_COUNT];
@@ -226,8 +230,20 @@ int tmp006_get_val(int idx, int *temp_ptr)
 	 * TMP006 index and the bottom bit is (0=die, 1=remote).
 	 */
 	int tidx = idx >> 1;
-	const struct tmp006_data_t *tdata = tmp006_data + tidx;
+	struct tmp006_data_t *tdata = tmp006_data + tidx;
 
+#ifdef CONFIG_TEMP_SENSOR_POLL
+	/*
+	 * The die and object entries share one chip, which must still be read
+	 * once a second for the temporal correction.  Read it for whichever
+	 * entry the common poller reaches first each second.
+	 */
+	if (timestamp_expired(tdata->next_poll, NULL)) {
+		tdata->next_poll.val = get_time().val + SECOND * 3 / 4;
+		tmp006_poll_sensor(tidx);
+	}
+
+#endif
 	if (tdata->fail & FAIL_POWER) {
 		/*
 		 * Sensor isn't powered, or hasn't successfully provided data
@@ -249,6 +265,7 @@ int tmp006_get_val(int idx, int *temp_ptr)
 /*****************************************************************************/
 /* Hooks */
 
+#ifndef CONFIG_TEMP_SENSOR_POLL
 static void tmp006_poll(void)
 {
 	int i;
@@ -257,6 +274,7 @@ static void tmp006_poll(void)
 		tmp006_poll_sensor(i);
 }
 DECLARE_HOOK(HOOK_SECOND, tmp006_poll, HOOK_PRIO_TEMP_SENSOR);
+#endif
 
 static void tmp006_init(void)
 {
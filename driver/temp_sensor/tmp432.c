@@ -13,10 +13,6 @@
 #include "hooks.h"
 #include "util.h"
 
-static int temp_val_local;
-static int temp_val_remote1;
-static int temp_val_remote2;
-
 /**
  * Determine whether the sensor is powered.
  *
@@ -62,6 +58,38 @@ static int tmp432_set_temp(const int offset, int temp)
 	return raw_write8(offset, (uint8_t)temp);
 }
 
+#ifdef CONFIG_TEMP_SENSOR_POLL
+/*
+ * The common temp sensor poller spaces out the reads of each channel, so
+ * read just the channel asked for.
+ */
+int tmp432_get_val(int idx, int *temp_ptr)
+{
+	static const uint8_t temp_reg[] = {
+		[TMP432_IDX_LOCAL] = TMP432_LOCAL,
+		[TMP432_IDX_REMOTE1] = TMP432_REMOTE1,
+		[TMP432_IDX_REMOTE2] = TMP432_REMOTE2,
+	};
+	int temp_c, rv;
+
+	if (!has_power())
+		return EC_ERROR_NOT_POWERED;
+
+	if (idx < 0 || idx >= ARRAY_SIZE(temp_reg))
+		return EC_ERROR_UNKNOWN;
+
+	rv = get_temp(temp_reg[idx], &temp_c);
+	if (rv)
+		return rv;
+
+	*temp_ptr = C_TO_K(temp_c);
+	return EC_SUCCESS;
+}
+#else
+static int temp_val_local;
+static int temp_val_remote1;
+static int temp_val_remote2;
+
 int tmp432_get_val(int idx, int *temp_ptr)
 {
 	if (!has_power())
@@ -101,6 +129,7 @@ static void temp_sensor_poll(void)
 		temp_val_remote2 = C_TO_K(temp_c);
 }
 DECLARE_HOOK(HOOK_SECOND, temp_sensor_poll, HOOK_PRIO_TEMP_SENSOR);
+#endif
 
 static void print_temps(
 		const char *name,
@@ -6,82 +6,136 @@
 #ifndef __CROS_EC_ACCELEROMETER_H
 #define __CROS_EC_ACCELEROMETER_H
 
-/* Header file for accelerometer drivers. */
+/* Header file for accelerometer and gyro drivers. */
 
-/* This array must be defined in board.c. */
-extern const int accel_addr[];
+#include "common.h"
+#include "math_util.h"
 
-/* This enum must be defined in board.h. */
-enum accel_id;
+struct motion_sensor_t;
 
 /* Number of counts from accelerometer that represents 1G acceleration. */
 #define ACCEL_G  1024
 
-/**
- * Read all three accelerations of an accelerometer. Note that all three
- * accelerations come back in counts, where ACCEL_G can be used to convert
- * counts to engineering units.
- *
- * @param id Target accelerometer
- * @param x_acc Pointer to store X-axis acceleration (in counts).
- * @param y_acc Pointer to store Y-axis acceleration (in counts).
- * @param z_acc Pointer to store Z-axis acceleration (in counts).
- *
- * @return EC_SUCCESS if successful, non-zero if error.
- */
-int accel_read(const enum accel_id id, int * const x_acc, int * const y_acc,
-		int * const z_acc);
+/* Most samples read_fifo() is asked for in one burst. */
+#define ACCEL_HW_FIFO_MAX 32
 
-/**
- * Initialize accelerometers.
- *
- * @param id Target accelerometer
- *
- * @return EC_SUCCESS if successful, non-zero if error.
+/*
+ * Driver operations for a motion sensor. Each entry in the board's
+ * motion_sensors[] table points at one of these, so a board may mix
+ * sensors from several drivers.
  */
-int accel_init(const enum accel_id id);
+struct accelgyro_drv {
+	/**
+	 * Initialize the sensor.
+	 *
+	 * @param s Target sensor
+	 *
+	 * @return EC_SUCCESS if successful, non-zero if error.
+	 */
+	int (*init)(const struct motion_sensor_t *s);
 
-/**
- * Setter and getter methods for the sensor range. The sensor range defines
- * the maximum value that can be returned from accel_read(). As the range
- * increases, the resolution gets worse.
- *
- * @param id Target accelerometer
- * @param range Range (Units are +/- G's for accel, +/- deg/s for gyro)
- * @param rnd Rounding flag. If true, it rounds up to nearest valid value.
- *                Otherwise, it rounds down.
- *
- * @return EC_SUCCESS if successful, non-zero if error.
- */
-int accel_set_range(const enum accel_id id, const int range, const int rnd);
-int accel_get_range(const enum accel_id id, int * const range);
+	/**
+	 * Read all three axes of a sensor. For accelerometers the values
+	 * come back in counts, where ACCEL_G can be used to convert counts
+	 * to engineering units.
+	 *
+	 * @param s Target sensor
+	 * @param x Pointer to store X-axis reading (in counts).
+	 * @param y Pointer to store Y-axis reading (in counts).
+	 * @param z Pointer to store Z-axis reading (in counts).
+	 *
+	 * @return EC_SUCCESS if successful, non-zero if error.
+	 */
+	int (*read)(const struct motion_sensor_t *s, int *x, int *y, int *z);
 
+	/**
+	 * Setter and getter methods for the sensor range. The sensor range
+	 * defines the maximum value that can be returned from read(). As the
+	 * range increases, the resolution gets worse.
+	 *
+	 * @param s Target sensor
+	 * @param range Range (Units are +/- G's for accel, +/- deg/s for gyro)
+	 * @param rnd Rounding flag. If true, it rounds up to nearest valid
+	 *            value. Otherwise, it rounds down.
+	 *
+	 * @return EC_SUCCESS if successful, non-zero if error.
+	 */
+	int (*set_range)(const struct motion_sensor_t *s, int range, int rnd);
+	int (*get_range)(const struct motion_sensor_t *s, int *range);
 
-/**
- * Setter and getter methods for the sensor resolution.
- *
- * @param id Target accelerometer
- * @param range Resolution (Units are number of bits)
- * param rnd Rounding flag. If true, it rounds up to nearest valid value.
- *                Otherwise, it rounds down.
- *
- * @return EC_SUCCESS if successful, non-zero if error.
- */
-int accel_set_resolution(const enum accel_id id, const int res, const int rnd);
-int accel_get_resolution(const enum accel_id id, int * const res);
+	/**
+	 * Setter and getter methods for the sensor resolution.
+	 *
+	 * @param s Target sensor
+	 * @param res Resolution (Units are number of bits)
+	 * @param rnd Rounding flag. If true, it rounds up to nearest valid
+	 *            value. Otherwise, it rounds down.
+	 *
+	 * @return EC_SUCCESS if successful, non-zero if error.
+	 */
+	int (*set_resolution)(const struct motion_sensor_t *s, int res,
+			      int rnd);
+	int (*get_resolution)(const struct motion_sensor_t *s, int *res);
 
-/**
- * Setter and getter methods for the sensor output data range. As the ODR
- * increases, the LPF roll-off frequency also increases.
- *
- * @param id Target accelerometer
- * @param rate Output data rate (units are mHz)
- * @param rnd Rounding flag. If true, it rounds up to nearest valid value.
- *                Otherwise, it rounds down.
- *
- * @return EC_SUCCESS if successful, non-zero if error.
- */
-int accel_set_datarate(const enum accel_id id, const int rate, const int rnd);
-int accel_get_datarate(const enum accel_id id, int * const rate);
+	/**
+	 * Setter and getter methods for the sensor output data rate. As the
+	 * ODR increases, the LPF roll-off frequency also increases.
+	 *
+	 * @param s Target sensor
+	 * @param rate Output data rate (units are mHz)
+	 * @param rnd Rounding flag. If true, it rounds up to nearest valid
+	 *            value. Otherwise, it rounds down.
+	 *
+	 * @return EC_SUCCESS if successful, non-zero if error.
+	 */
+	int (*set_data_rate)(const struct motion_sensor_t *s, int rate,
+			     int rnd);
+	int (*get_data_rate)(const struct motion_sensor_t *s, int *rate);
+
+#ifdef CONFIG_ACCEL_INTERRUPTS
+	/**
+	 * Setup a one-time interrupt. If the threshold is low enough, the
+	 * interrupt may trigger due simply to noise and not any real motion.
+	 * If the threshold is 0, the interrupt will fire immediately.
+	 *
+	 * @param s Target sensor
+	 * @param threshold Threshold for interrupt in units of counts.
+	 *
+	 * @return EC_SUCCESS if successful, non-zero if error.
+	 */
+	int (*set_interrupt)(const struct motion_sensor_t *s,
+			     unsigned int threshold);
+#endif
+
+#ifdef CONFIG_ACCEL_HW_FIFO
+	/**
+	 * Set up the sensor's hardware FIFO to interrupt once it holds a
+	 * number of samples. A sensor with a shallower FIFO uses all of it.
+	 * May be NULL if the sensor has no FIFO.
+	 *
+	 * @param s Target sensor
+	 * @param watermark Samples to collect before interrupting, or 0 to
+	 *                  turn the FIFO off and go back to single reads.
+	 *
+	 * @return EC_SUCCESS if successful, non-zero if error.
+	 */
+	int (*set_fifo_watermark)(const struct motion_sensor_t *s,
+				  int watermark);
+
+	/**
+	 * Read the samples waiting in the hardware FIFO, oldest first, in the
+	 * same units as read().
+	 *
+	 * @param s Target sensor
+	 * @param v Array to store the samples in
+	 * @param max Size of v, in samples
+	 * @param count Pointer to store the number of samples read
+	 *
+	 * @return EC_SUCCESS if successful, non-zero if error.
+	 */
+	int (*read_fifo)(const struct motion_sensor_t *s, vector_3_t *v,
+			 int max, int *count);
+#endif
+};
 
 #endif /* __CROS_EC_ACCELEROMETER_H */
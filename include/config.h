@@ -42,8 +42,24 @@
 /* Enable accelerometer interrupts. */
 #undef CONFIG_ACCEL_INTERRUPTS
 
+/*
+ * Number of motion sensor samples the EC queues for the host to read with
+ * MOTIONSENSE_CMD_FIFO_READ.  If undefined, the host only sees the latest
+ * sample.
+ */
+#undef CONFIG_ACCEL_FIFO
+
+/*
+ * Let motion sensors collect samples in their own hardware FIFOs and drain
+ * them in one burst when the watermark interrupt fires, instead of polling
+ * one sample at a time. Sensors opt in through hw_fifo_watermark in the
+ * board's motion_sensors[] table.
+ */
+#undef CONFIG_ACCEL_HW_FIFO
+
 /* Specify type of accelerometers attached. */
 #undef CONFIG_ACCEL_KXCJ9
+#undef CONFIG_ACCELGYRO_LSM6DS0
 
 /* Compile chip support for analog-to-digital convertor */
 #undef CONFIG_ADC
@@ -468,6 +484,13 @@
  */
 #undef CONFIG_FAN_RPM_CUSTOM
 
+/*
+ * Drive each fan from a PID loop on a weighted average of temperature
+ * sensors, using the per-fan profiles in fan_pid_params[] in board.c.
+ * Fans whose profile has no target keep following thermal_params[].
+ */
+#undef CONFIG_FAN_PID
+
 /*****************************************************************************/
 /* Flash configuration */
 
@@ -484,6 +507,14 @@
 #undef CONFIG_FLASH_WRITE_IDEAL_SIZE
 #undef CONFIG_FLASH_WRITE_SIZE
 
+/*
+ * Combine small adjacent flash_write() calls in RAM and commit them to flash
+ * in CONFIG_FLASH_WRITE_IDEAL_SIZE blocks.  Buffered data is written when a
+ * block fills, when flash_write_flush() is called, before reboot/sysjump, or
+ * after a short idle timeout.
+ */
+#undef CONFIG_FLASH_WRITE_COMBINE
+
 /*****************************************************************************/
 
 /* Include a flashmap in the compiled firmware image */
@@ -492,7 +523,10 @@
 /* Allow EC serial console input to wake up the EC from STOP mode */
 #undef CONFIG_FORCE_CONSOLE_RESUME
 
-/* Enable support for floating point unit */
+/*
+ * Enable support for floating point unit. Without it, math_util works in
+ * Q16.16 fixed point instead.
+ */
 #undef CONFIG_FPU
 
 /*****************************************************************************/
@@ -543,11 +577,31 @@
 
 #undef CONFIG_I2C
 #undef CONFIG_I2C_ARBITRATION
+
+/*
+ * Queue I2C transactions with i2c_submit() and run them from the I2CASYNC
+ * task, so the submitting task does not wait for the bus. Boards which define
+ * this must add i2c_async_task() to their task list.
+ */
+#undef CONFIG_I2C_ASYNC
+
 #undef CONFIG_I2C_DEBUG
 #undef CONFIG_I2C_DEBUG_PASSTHRU
 #undef CONFIG_I2C_PASSTHROUGH
 #undef CONFIG_I2C_PASSTHRU_RESTRICTED
 
+/*
+ * Cache I2C device configuration registers for drivers which use the
+ * i2c_regcache_*() helpers. Selected automatically by drivers which need it.
+ */
+#undef CONFIG_I2C_REGCACHE
+
+/*
+ * Keep per-port transfer and lock statistics and per-task lock wait times,
+ * for the i2cstats console command and EC_CMD_I2C_STATS.
+ */
+#undef CONFIG_I2C_STATS
+
 /*****************************************************************************/
 
 /* Number of IRQs supported on the EC chip */
@@ -570,6 +624,12 @@
 /* The board uses a negative edge-triggered GPIO for keyboard interrupts. */
 #undef CONFIG_KEYBOARD_IRQ_GPIO
 
+/*
+ * Record how long key events take to get through each stage from the scanner
+ * to the host, and report the histograms via EC_CMD_KEYBOARD_LATENCY.
+ */
+#undef CONFIG_KEYBOARD_LATENCY
+
 /* Compile code for 8042 keyboard protocol */
 #undef CONFIG_KEYBOARD_PROTOCOL_8042
 
@@ -823,6 +883,14 @@
 #undef CONFIG_TEMP_SENSOR_TMP006	/* TI TMP006 sensor, on I2C bus */
 #undef CONFIG_TEMP_SENSOR_TMP432	/* TI TMP432 sensor, on I2C bus */
 
+/*
+ * Poll temperature sensors from a common scheduler which spreads the reads
+ * across the hook ticks of each second, instead of every driver reading its
+ * chips in the same HOOK_SECOND.  temp_sensor_read() then returns the latest
+ * cached reading.
+ */
+#undef CONFIG_TEMP_SENSOR_POLL
+
 /*
  * If defined, active-high GPIO which indicates temperature sensor chips are
  * powered.  If not defined, temperature sensors are assumed to be always
@@ -1017,6 +1085,15 @@
 #undef CONFIG_ACCEL_CALIBRATE
 #endif
 
+/*****************************************************************************/
+/*
+ * Handle configs selected by drivers.
+ */
+
+#if defined(CONFIG_ACCEL_KXCJ9) || defined(CONFIG_CHARGER_BQ24192)
+#define CONFIG_I2C_REGCACHE
+#endif
+
 /*****************************************************************************/
 /*
  * Apply test config overrides last, since tests need to override some of the
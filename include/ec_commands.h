@@ -271,6 +271,9 @@ enum host_event_code {
 	/* Hang detect logic detected a hang and warm rebooted the AP */
 	EC_HOST_EVENT_HANG_REBOOT = 21,
 
+	/* Motion sensor FIFO reached its watermark */
+	EC_HOST_EVENT_MOTION_SENSE_FIFO = 22,
+
 	/*
 	 * The high bit of the event mask is not used as a host event code.  If
 	 * it reads back as set, then the entire event mask should be
@@ -1269,6 +1272,20 @@ enum motionsense_command {
 	 */
 	MOTIONSENSE_CMD_KB_WAKE_ANGLE = 5,
 
+	/*
+	 * FIFO info command returns the state of the EC's queue of motion
+	 * sensor samples, and is a setter/getter for the number of queued
+	 * samples at which the EC notifies the host. Reading it clears the
+	 * count of lost samples.
+	 */
+	MOTIONSENSE_CMD_FIFO_INFO = 6,
+
+	/*
+	 * FIFO read command removes queued samples, oldest first, and returns
+	 * as many as fit in the response.
+	 */
+	MOTIONSENSE_CMD_FIFO_READ = 7,
+
 	/* Number of motionsense sub-commands. */
 	MOTIONSENSE_NUM_CMDS
 };
@@ -1300,6 +1317,7 @@ enum motionsensor_location {
 /* List of motion sensor chips. */
 enum motionsensor_chip {
 	MOTIONSENSE_CHIP_KXCJ9 = 0,
+	MOTIONSENSE_CHIP_LSM6DS0 = 1,
 };
 
 /* Module flag masks used for the dump sub-command. */
@@ -1315,6 +1333,17 @@ enum motionsensor_chip {
  */
 #define EC_MOTION_SENSE_NO_VALUE -1
 
+/* One queued sample, as returned by MOTIONSENSE_CMD_FIFO_READ. */
+struct ec_response_motion_sensor_data {
+	/* Should be element of enum motionsensor_id. */
+	uint8_t sensor_num;
+	uint8_t reserved;
+	/* EC time in us when the sample was taken. */
+	uint32_t timestamp;
+	/* Sample in the same units and frame as MOTIONSENSE_CMD_DUMP. */
+	int16_t data[3];
+} __packed;
+
 struct ec_params_motion_sense {
 	uint8_t cmd;
 	union {
@@ -1332,6 +1361,18 @@ struct ec_params_motion_sense {
 			int16_t data;
 		} ec_rate, kb_wake_angle;
 
+		/* Used for MOTIONSENSE_CMD_FIFO_INFO. */
+		struct {
+			/* Watermark to set or EC_MOTION_SENSE_NO_VALUE. */
+			int16_t watermark;
+		} fifo_info;
+
+		/* Used for MOTIONSENSE_CMD_FIFO_READ. */
+		struct {
+			/* Maximum number of samples to return. */
+			uint32_t max_samples;
+		} fifo_read;
+
 		/* Used for MOTIONSENSE_CMD_INFO. */
 		struct {
 			/* Should be element of enum motionsensor_id. */
@@ -1392,6 +1433,28 @@ struct ec_response_motion_sense {
 			/* Current value of the parameter queried. */
 			int32_t ret;
 		} ec_rate, sensor_odr, sensor_range, kb_wake_angle;
+
+		/* Used for MOTIONSENSE_CMD_FIFO_INFO. */
+		struct {
+			/* Number of samples the FIFO can hold. */
+			uint16_t size;
+			/* Number of samples queued. */
+			uint16_t count;
+			/* Queued samples at which the host is notified. */
+			uint16_t watermark;
+			/*
+			 * Samples dropped because the FIFO was full, since the
+			 * last FIFO_INFO command; saturates at 0xffff.
+			 */
+			uint16_t lost;
+		} fifo_info;
+
+		/* Used for MOTIONSENSE_CMD_FIFO_READ. */
+		struct {
+			/* Number of samples which follow. */
+			uint8_t count;
+			struct ec_response_motion_sensor_data data[0];
+		} fifo_read;
 	};
 } __packed;
 
@@ -1612,6 +1675,47 @@ struct ec_response_tmp006_get_raw {
 	int32_t v;  /* In nV */
 };
 
+/*
+ * Closed-loop fan control. Each fan with a non-zero temp_target runs a PID
+ * loop on the weighted average of its temperature sensors, instead of
+ * following the temp_fan_off/temp_fan_max ramps of struct ec_thermal_config.
+ */
+#define EC_CMD_FAN_PID_GET_CONFIG 0x56
+#define EC_CMD_FAN_PID_SET_CONFIG 0x57
+
+/* Number of sensor weights in each profile */
+#define EC_FAN_PID_SENSORS (EC_TEMP_SENSOR_ENTRIES + EC_TEMP_SENSOR_B_ENTRIES)
+
+struct ec_fan_pid_config {
+	uint16_t temp_target;	/* Degrees K to hold; 0 disables the loop */
+	uint16_t hysteresis;	/* Fan stops this many K below temp_target */
+	uint16_t period_ms;	/* Loop period, rounded to hook ticks */
+	int16_t kp;		/* Gains; in 1/100 % per K, ... */
+	int16_t ki;		/* ...per K*s... */
+	int16_t kd;		/* ...and per K/s */
+	uint8_t weight[EC_FAN_PID_SENSORS];	/* Per sensor; 0 to ignore */
+} __packed;
+
+struct ec_params_fan_pid_get_config {
+	uint8_t fan;
+} __packed;
+
+/* Fan is running; it has reached temp_target and not yet cooled off */
+#define EC_FAN_PID_FLAG_ON (1 << 0)
+
+struct ec_response_fan_pid_get_config {
+	struct ec_fan_pid_config cfg;
+	uint16_t temp;		/* Last weighted temperature, degrees K */
+	uint8_t percent;	/* Last output, percent of cooling needed */
+	uint8_t flags;		/* EC_FAN_PID_FLAG_* */
+} __packed;
+
+/* Use read-modify-write; the controller restarts from its new settings */
+struct ec_params_fan_pid_set_config {
+	uint8_t fan;
+	struct ec_fan_pid_config cfg;
+} __packed;
+
 /*****************************************************************************/
 /* MKBP - Matrix KeyBoard Protocol */
 
@@ -1648,6 +1752,11 @@ struct ec_params_mkbp_simulate_key {
 /* flags */
 enum mkbp_config_flags {
 	EC_MKBP_FLAGS_ENABLE = 1,	/* Enable keyboard scanning */
+	/*
+	 * Back off the scan period while keys aren't changing, up to the key
+	 * down debounce time.
+	 */
+	EC_MKBP_FLAGS_ADAPTIVE_SCAN = 2,
 };
 
 enum mkbp_config_valid {
@@ -1747,6 +1856,94 @@ struct ec_result_keyscan_seq_ctrl {
 	};
 } __packed;
 
+/*
+ * Read key event latency statistics.  Each stage has a histogram of
+ * latencies in power-of-two buckets: bucket 0 counts latencies under 2 us,
+ * and bucket n counts [2^n, 2^(n+1)) us.  The last bucket also counts
+ * everything longer.
+ */
+#define EC_CMD_KEYBOARD_LATENCY 0x67
+
+enum ec_keyboard_latency_stage {
+	/* Time since the previous scan, when a scan sees a key change */
+	EC_KEYBOARD_LATENCY_SCAN = 0,
+	/* First edge of a key to the key finishing debouncing */
+	EC_KEYBOARD_LATENCY_DEBOUNCE = 1,
+	/* Debounced to queued for the host by the keyboard protocol */
+	EC_KEYBOARD_LATENCY_ENCODE = 2,
+	/* Queued for the host to handed to the host */
+	EC_KEYBOARD_LATENCY_HOST = 3,
+
+	/* Number of stages */
+	EC_KEYBOARD_LATENCY_STAGE_COUNT
+};
+
+#define EC_KEYBOARD_LATENCY_BUCKETS 16
+
+/* Clear statistics after reading them */
+#define EC_KEYBOARD_LATENCY_FLAG_CLEAR (1 << 0)
+
+struct ec_params_keyboard_latency {
+	uint8_t flags;		/* EC_KEYBOARD_LATENCY_FLAG_* */
+} __packed;
+
+struct ec_keyboard_latency_stage_stats {
+	uint32_t count;		/* Number of samples */
+	uint32_t total_us;	/* Sum of samples; saturates */
+	uint32_t max_us;	/* Largest sample */
+	uint16_t buckets[EC_KEYBOARD_LATENCY_BUCKETS];	/* Saturate */
+} __packed;
+
+struct ec_response_keyboard_latency {
+	struct ec_keyboard_latency_stage_stats
+		stage[EC_KEYBOARD_LATENCY_STAGE_COUNT];
+} __packed;
+
+/*
+ * Read queued MKBP events
+ *
+ * Pops events from the MKBP FIFO, oldest first, and returns as many as fit
+ * in the response.  EC_INT stays asserted until the FIFO is empty.  Unlike
+ * EC_CMD_MKBP_STATE, this returns every event type, and returns no events
+ * when the FIFO is empty.
+ */
+#define EC_CMD_MKBP_GET_EVENTS 0x68
+
+enum ec_mkbp_event {
+	/* Key matrix changed; data is the new key state */
+	EC_MKBP_EVENT_KEY_MATRIX = 0,
+	/* A button changed; data is the mask of pressed buttons */
+	EC_MKBP_EVENT_BUTTON = 1,
+	/* A switch changed; data is the mask of EC_MKBP_SWITCH_* */
+	EC_MKBP_EVENT_SWITCH = 2,
+	/* Motion sensor data is ready; data is the mask of sensors */
+	EC_MKBP_EVENT_SENSOR = 3,
+
+	/* Number of event types */
+	EC_MKBP_EVENT_COUNT
+};
+
+/* Switches for EC_MKBP_EVENT_SWITCH */
+#define EC_MKBP_SWITCH_LID_OPEN (1 << 0)
+
+union ec_mkbp_event_data {
+	uint8_t key_matrix[13];
+	uint32_t buttons;	/* Bit n set if enum keyboard_button_type n */
+	uint32_t switches;
+	uint32_t sensors;
+} __packed;
+
+struct ec_mkbp_event_entry {
+	uint8_t event_type;	/* enum ec_mkbp_event */
+	uint32_t timestamp;	/* EC time in us when the event was queued */
+	union ec_mkbp_event_data data;
+} __packed;
+
+struct ec_response_mkbp_get_events {
+	uint8_t count;		/* Number of events which follow */
+	struct ec_mkbp_event_entry events[0];
+} __packed;
+
 /*****************************************************************************/
 /* Temperature sensor commands */
 
@@ -2043,11 +2240,20 @@ struct ec_response_power_info {
 /*****************************************************************************/
 /* I2C passthru command */
 
+/*
+ * Run a sequence of messages with the port locked throughout.  In version 0
+ * the messages form a single transaction, joined by repeated starts.
+ * Version 1 also honors EC_I2C_FLAG_STOP, so that one command can carry a
+ * batch of transactions.
+ */
 #define EC_CMD_I2C_PASSTHRU 0x9e
 
 /* Read data; if not present, message is a write */
 #define EC_I2C_FLAG_READ	(1 << 15)
 
+/* End the transaction with a stop after this message (version 1) */
+#define EC_I2C_FLAG_STOP	(1 << 14)
+
 /* Mask for address */
 #define EC_I2C_ADDR_MASK	0x3ff
 
@@ -2223,6 +2429,53 @@ struct ec_params_ext_power_current_limit {
 	uint32_t limit; /* in mA */
 } __packed;
 
+/*****************************************************************************/
+/* I2C bus statistics */
+
+/*
+ * Read I2C statistics, either for one port or for one task.  Lock wait
+ * times are histograms in power-of-two buckets: bucket 0 counts waits under
+ * 2 us, and bucket n counts [2^n, 2^(n+1)) us.  The last bucket also counts
+ * everything longer.
+ */
+#define EC_CMD_I2C_STATS 0xa3
+
+enum ec_i2c_stats_type {
+	/* Bus statistics for the port given by index */
+	EC_I2C_STATS_PORT = 0,
+	/* Lock statistics for the task given by index */
+	EC_I2C_STATS_TASK = 1,
+};
+
+#define EC_I2C_STATS_BUCKETS 16
+
+/* Clear the statistics for this port or task after reading them */
+#define EC_I2C_STATS_FLAG_CLEAR (1 << 0)
+
+struct ec_params_i2c_stats {
+	uint8_t type;		/* enum ec_i2c_stats_type */
+	uint8_t index;		/* Port or task number */
+	uint8_t flags;		/* EC_I2C_STATS_FLAG_* */
+} __packed;
+
+struct ec_response_i2c_stats_port {
+	uint32_t xfers;		/* Transfers */
+	uint32_t bytes;		/* Bytes written and read */
+	uint32_t naks;		/* Failed transfers, other than timeouts */
+	uint32_t timeouts;	/* Transfers which timed out */
+	uint32_t locks;		/* Times the port was locked */
+	uint32_t busy_us;	/* Time the port was locked; saturates */
+	uint32_t hold_max_us;	/* Longest time the port was locked */
+} __packed;
+
+struct ec_response_i2c_stats_task {
+	uint32_t locks;		/* Times the task locked a port */
+	uint32_t wait_us;	/* Time spent waiting for ports; saturates */
+	uint32_t wait_max_us;	/* Longest wait for a port */
+	uint32_t hold_us;	/* Time spent holding ports; saturates */
+	uint16_t buckets[EC_I2C_STATS_BUCKETS];	/* Wait times; saturate */
+} __packed;
+
 /*****************************************************************************/
 /* Smart battery pass-through */
 
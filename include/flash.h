@@ -102,7 +102,7 @@ int flash_physical_force_reload(void);
 /**
  * Check if a region of flash is erased
  *
- * It is assumed that an erased region has all bits set to 1.
+ * An erased region holds CONFIG_FLASH_ERASED_VALUE32 in every word.
  *
  * @param offset	Flash offset to check
  * @param size		Number of bytes to check (word-aligned)
@@ -171,10 +171,22 @@ int flash_dataptr(int offset, int size_req, int align, const char **ptrp);
  */
 int flash_write(int offset, int size, const char *data);
 
+/**
+ * Commit any data held in the flash write-combining buffer.
+ *
+ * @return EC_SUCCESS, or nonzero if the physical write failed.
+ */
+#ifdef CONFIG_FLASH_WRITE_COMBINE
+int flash_write_flush(void);
+#else
+static inline int flash_write_flush(void) { return EC_SUCCESS; }
+#endif
+
 /**
  * Erase flash.
  *
- * Offset and size must be a multiple of CONFIG_FLASH_ERASE_SIZE.
+ * Offset and size must be a multiple of CONFIG_FLASH_ERASE_SIZE.  Blocks
+ * which are already erased are skipped.
  *
  * @param offset	Flash offset to erase.
  * @param size	        Number of bytes to erase.
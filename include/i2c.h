@@ -126,6 +126,63 @@ int i2c_raw_mode(int port, int enable);
  */
 void i2c_lock(int port, int lock);
 
+#ifdef CONFIG_I2C_ASYNC
+/* One message of a transaction; the fields are as for i2c_xfer(). */
+struct i2c_msg {
+	int slave_addr;
+	const uint8_t *out;
+	int out_size;
+	uint8_t *in;
+	int in_size;
+	int flags;
+};
+
+/*
+ * A transaction queued with i2c_submit(). The request and the buffers of its
+ * messages belong to the I2C code until it completes.
+ */
+struct i2c_request {
+	int port;
+	const struct i2c_msg *msgs;
+	int msg_count;
+
+	/*
+	 * On completion, done() is called from the I2CASYNC task if it is set,
+	 * and event is set on task if it is non-zero. done() must not block.
+	 */
+	void (*done)(struct i2c_request *req);
+	int task;
+	uint32_t event;
+
+	/* Set by the I2C code. rv is only valid once busy is clear. */
+	volatile int busy;
+	int rv;
+	struct i2c_request *next;
+};
+
+/**
+ * Run the messages of a transaction in order, holding the port for all of
+ * them. Stops at the first message which fails.
+ *
+ * @param port		Port to access
+ * @param msgs		Messages to run
+ * @param count		Number of messages
+ * @return EC_SUCCESS, or non-zero if error.
+ */
+int i2c_transfer(int port, const struct i2c_msg *msgs, int count);
+
+/**
+ * Queue a transaction to run as i2c_transfer() would, without waiting for
+ * it. Requests on a port run in the order they were submitted. May be called
+ * from interrupt context.
+ *
+ * @param req		Request to queue
+ * @return EC_SUCCESS if queued, EC_ERROR_BUSY if req is still queued from an
+ *	   earlier submission, or EC_ERROR_INVAL if the port is invalid.
+ */
+int i2c_submit(struct i2c_request *req);
+#endif
+
 /* Read a 16-bit register from the slave at 8-bit slave address <slaveaddr>, at
  * the specified 8-bit <offset> in the slave's address space. */
 int i2c_read16(int port, int slave_addr, int offset, int *data);
@@ -163,4 +220,100 @@ int i2c_unwedge(int port);
 int i2c_read_string(int port, int slave_addr, int offset, uint8_t *data,
 			int len);
 
+#ifdef CONFIG_I2C_STATS
+
+/**
+ * Note that the current task is about to lock a port.
+ *
+ * @return the current time, for passing to i2c_stats_locked().
+ */
+uint32_t i2c_stats_lock_begin(void);
+
+/**
+ * Note that the current task has locked a port.
+ *
+ * @param port		Port which was locked
+ * @param begin		Time returned by i2c_stats_lock_begin()
+ */
+void i2c_stats_locked(int port, uint32_t begin);
+
+/**
+ * Note that the current task is about to unlock a port.
+ */
+void i2c_stats_unlocking(int port);
+
+/**
+ * Record a transfer.  Called by the chip's i2c_xfer().
+ *
+ * @param port		Port the transfer was on
+ * @param bytes		Number of bytes written and read
+ * @param rv		Result of the transfer
+ */
+void i2c_stats_xfer(int port, int bytes, int rv);
+
+#else
+
+static inline uint32_t i2c_stats_lock_begin(void) { return 0; }
+static inline void i2c_stats_locked(int port, uint32_t begin) { }
+static inline void i2c_stats_unlocking(int port) { }
+static inline void i2c_stats_xfer(int port, int bytes, int rv) { }
+
+#endif
+
+/*
+ * Cache of the registers of one I2C device which hold their value until the
+ * EC writes them, so that read-modify-write of configuration registers does
+ * not have to read them back over the bus. Registers not in the list (status,
+ * data, self-clearing bits) always go to the device.
+ *
+ * The driver owns one of these per device and must serialize access to it,
+ * the same as for the device itself.
+ */
+#define I2C_REGCACHE_MAX 8
+
+struct i2c_regcache {
+	const uint8_t *regs;  /* Cacheable registers; set by i2c_regcache_init */
+	int count;            /* Number of entries in regs, <= I2C_REGCACHE_MAX */
+	uint32_t valid;       /* Bit n set if val[n] matches the device */
+	uint16_t val[I2C_REGCACHE_MAX];
+};
+
+/**
+ * Set the list of cacheable registers and start with an empty cache.
+ *
+ * @param cache		Cache to initialize
+ * @param regs		Offsets of the cacheable registers
+ * @param count		Number of entries in regs
+ */
+void i2c_regcache_init(struct i2c_regcache *cache, const uint8_t *regs,
+		       int count);
+
+/**
+ * Forget every cached value, e.g. after the device has been reset.
+ */
+static inline void i2c_regcache_invalidate(struct i2c_regcache *cache)
+{
+	cache->valid = 0;
+}
+
+/*
+ * Same as i2c_read8/i2c_write8/i2c_read16/i2c_write16, but served from and
+ * kept in sync with <cache> for cacheable registers.
+ */
+int i2c_regcache_read8(struct i2c_regcache *cache, int port, int slave_addr,
+		       int offset, int *data);
+int i2c_regcache_write8(struct i2c_regcache *cache, int port, int slave_addr,
+			int offset, int data);
+int i2c_regcache_read16(struct i2c_regcache *cache, int port, int slave_addr,
+			int offset, int *data);
+int i2c_regcache_write16(struct i2c_regcache *cache, int port, int slave_addr,
+			 int offset, int data);
+
+/**
+ * Read-modify-write an 8-bit register: replace the bits in <mask> with the
+ * same bits of <data>. The write is skipped if it would not change the value.
+ */
+int i2c_regcache_update8(struct i2c_regcache *cache, int port, int slave_addr,
+			 int offset, int mask, int data);
+
 #endif  /* __CROS_EC_I2C_H */
@@ -35,4 +35,14 @@ void keyboard_host_write(int data, int is_cmd);
  */
 void keyboard_state_changed(int row, int col, int is_pressed);
 
+/**
+ * Called by keyboard scan code with every key that changed in one scan.
+ *
+ * The scan codes for all of them are sent to the host in one write.
+ *
+ * @param changed	Mask of changed keys for each column
+ * @param state		New key state; set bits are pressed keys
+ */
+void keyboard_matrix_changed(const uint8_t *changed, const uint8_t *state);
+
 #endif  /* __CROS_EC_KEYBOARD_8042_H */
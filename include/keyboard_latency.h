@@ -0,0 +1,61 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Key event latency tracing for Chrome EC */
+
+#ifndef __CROS_EC_KEYBOARD_LATENCY_H
+#define __CROS_EC_KEYBOARD_LATENCY_H
+
+#include "common.h"
+#include "ec_commands.h"
+
+#ifdef CONFIG_KEYBOARD_LATENCY
+
+/**
+ * Record a latency sample.
+ *
+ * @param stage		Stage the sample is for
+ * @param us		Latency in microseconds
+ */
+void keylat_record(enum ec_keyboard_latency_stage stage, uint32_t us);
+
+/**
+ * Note that a key change finished debouncing.
+ *
+ * Called by the scanner just before it hands the change to the keyboard
+ * protocol.
+ *
+ * @param t		Time the change finished debouncing
+ */
+void keylat_debounced(uint32_t t);
+
+/**
+ * Note that the keyboard protocol queued a key change for the host.
+ *
+ * Records the encode stage if the change came from the scanner.  Events
+ * which didn't (typematic repeats, synthetic keys) are ignored.
+ *
+ * @return the current time, for passing to keylat_host_pickup().
+ */
+uint32_t keylat_queued(void);
+
+/**
+ * Note that the host picked up a key event.
+ *
+ * @param queued	Time returned by keylat_queued() for the event
+ */
+void keylat_host_pickup(uint32_t queued);
+
+#else
+
+static inline void keylat_record(enum ec_keyboard_latency_stage stage,
+				 uint32_t us) { }
+static inline void keylat_debounced(uint32_t t) { }
+static inline uint32_t keylat_queued(void) { return 0; }
+static inline void keylat_host_pickup(uint32_t queued) { }
+
+#endif
+
+#endif  /* __CROS_EC_KEYBOARD_LATENCY_H */
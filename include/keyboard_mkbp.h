@@ -9,6 +9,20 @@
 #define __CROS_EC_KEYBOARD_MKBP_H
 
 #include "common.h"
+#include "ec_commands.h"
+
+/**
+ * Add an event into the MKBP FIFO
+ *
+ * The event is timestamped and the host is interrupted.  Nothing is added
+ * while the host has the protocol disabled (EC_MKBP_FLAGS_ENABLE clear).
+ *
+ * @param event_type	Type of event
+ * @param data		Event data; see union ec_mkbp_event_data
+ * @param size		Size of data in bytes; the rest is zero-filled
+ * @return EC_SUCCESS if entry added, EC_ERROR_OVERFLOW if FIFO is full
+ */
+int mkbp_fifo_add(enum ec_mkbp_event event_type, const void *data, int size);
 
 /**
  * Add keyboard state into FIFO
@@ -19,6 +19,12 @@ struct keyboard_scan_config {
 	uint16_t debounce_up_us;
 	/* Time between start of scans when in polling mode */
 	uint16_t scan_period_us;
+	/*
+	 * If non-zero, back off the scan period geometrically while no keys
+	 * are changing, up to this long (but no longer than debounce_down_us).
+	 * Any edge drops back to scan_period_us.
+	 */
+	uint16_t max_scan_period_us;
 	/*
 	 * Minimum time between end of one scan and start of the next one.
 	 * This ensures keyboard scanning doesn't starve the rest of the system
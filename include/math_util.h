@@ -8,7 +8,55 @@
 #ifndef __CROS_MATH_UTIL_H
 #define __CROS_MATH_UTIL_H
 
-typedef float matrix_3x3_t[3][3];
+#include "common.h"
+
+#ifdef CONFIG_FPU
+
+/* Fractional values are floats when there is hardware to handle them. */
+typedef float fp_t;
+
+#define INT_TO_FP(x)	((float)(x))
+#define FP_TO_INT(x)	((int32_t)(x))
+#define FLOAT_TO_FP(x)	((float)(x))
+#define FP_TO_FLOAT(x)	((float)(x))
+
+static inline fp_t fp_mul(fp_t a, fp_t b)
+{
+	return a * b;
+}
+
+static inline fp_t fp_div(fp_t a, fp_t b)
+{
+	return a / b;
+}
+
+#else
+
+/*
+ * Without an FPU, fractional values are Q16.16 fixed point, which covers the
+ * lid angle range in degrees and keeps 1.5e-5 resolution on cosines.
+ */
+typedef int32_t fp_t;
+
+#define FP_BITS		16
+#define INT_TO_FP(x)	((fp_t)(x) * (1 << FP_BITS))
+#define FP_TO_INT(x)	((int32_t)((x) >> FP_BITS))
+#define FLOAT_TO_FP(x)	((fp_t)((x) * (float)(1 << FP_BITS)))
+#define FP_TO_FLOAT(x)	((float)(x) / (float)(1 << FP_BITS))
+
+static inline fp_t fp_mul(fp_t a, fp_t b)
+{
+	return (fp_t)(((int64_t)a * b) >> FP_BITS);
+}
+
+static inline fp_t fp_div(fp_t a, fp_t b)
+{
+	return (fp_t)(((int64_t)a * (1 << FP_BITS)) / b);
+}
+
+#endif
+
+typedef fp_t matrix_3x3_t[3][3];
 typedef int vector_3_t[3];
 
 
@@ -24,7 +72,35 @@ typedef int vector_3_t[3];
  *
  * @return acos(x) in degrees.
  */
-float arc_cos(float x);
+fp_t arc_cos(fp_t x);
+
+/**
+ * Integer square root.
+ *
+ * @param x
+ *
+ * @return floor(sqrt(x)).
+ */
+uint32_t int_sqrt(uint64_t x);
+
+/**
+ * Calculate magnitude of a vector.
+ *
+ * @param v Vector to be measured.
+ *
+ * @return Magnitude of vector v, rounded down.
+ */
+int vector_magnitude(const vector_3_t v);
+
+/**
+ * Find the cosine of an angle from a dot product.
+ *
+ * @param dotproduct Dot product of two vectors.
+ * @param sq_mag Product of the squared magnitudes of the two vectors.
+ *
+ * @return dotproduct / sqrt(sq_mag), or 0 if sq_mag is 0.
+ */
+fp_t cosine_of_dot_product(int64_t dotproduct, uint64_t sq_mag);
 
 /**
  * Find the cosine of the angle between two vectors.
@@ -34,7 +110,7 @@ float arc_cos(float x);
  *
  * @return Cosine of the angle between v1 and v2.
  */
-float cosine_of_angle_diff(const vector_3_t v1, const vector_3_t v2);
+fp_t cosine_of_angle_diff(const vector_3_t v1, const vector_3_t v2);
 
 /**
  * Rotate vector v by rotation matrix R.
@@ -78,15 +154,6 @@ void matrix_multiply(matrix_3x3_t *m1, matrix_3x3_t *m2, matrix_3x3_t *res);
  */
 int solve_rotation_matrix(matrix_3x3_t *in, matrix_3x3_t *out, matrix_3x3_t *R);
 
-/**
- * Calculate magnitude of a vector.
- *
- * @param v Vector to be measured.
- *
- * @return Magnitued of vector v.
- */
-int vector_magnitude(const vector_3_t v);
-
 #endif
 
 
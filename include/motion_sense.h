@@ -8,11 +8,16 @@
 #ifndef __CROS_EC_MOTION_SENSE_H
 #define __CROS_EC_MOTION_SENSE_H
 
+#include "accelerometer.h"
+#include "common.h"
+#include "ec_commands.h"
 #include "gpio.h"
 #include "math_util.h"
+#include "task.h"
+#include "timer.h"
 
 /* Anything outside of lid angle range [-180, 180] should work. */
-#define LID_ANGLE_UNRELIABLE 500.0F
+#define LID_ANGLE_UNRELIABLE 500
 
 /**
  * This structure defines all of the data needed to specify the orientation
@@ -52,6 +57,61 @@ const
 struct accel_orientation acc_orient;
 
 
+/* One entry of the board's table of motion sensors. */
+struct motion_sensor_t {
+	/* Fixed data, set by the board. */
+	const char *name;
+	enum motionsensor_chip chip;
+	enum motionsensor_type type;
+	enum motionsensor_location location;
+	const struct accelgyro_drv *drv;
+	/* Shared by all sensors in the same physical device. */
+	struct mutex *mutex;
+	/* Driver private state for this sensor. */
+	void *drv_data;
+	uint8_t i2c_addr;
+
+	/*
+	 * Rotation matrix to rotate this sensor into the same reference frame
+	 * as the base accelerometer, or NULL if the two are already aligned.
+	 */
+	const matrix_3x3_t *rot;
+
+	/* Settings applied when the sensor is initialized. */
+	int default_range;
+	int default_odr;	/* mHz */
+
+	/*
+	 * Polling interval while the AP is on, in ms. If 0, the sensor is
+	 * polled at the module rate set by MOTIONSENSE_CMD_EC_RATE.
+	 */
+	int poll_ms;
+
+#ifdef CONFIG_ACCEL_HW_FIFO
+	/*
+	 * Samples for the sensor to collect in its own FIFO before it
+	 * interrupts on int_signal to have them drained. If 0, the sensor is
+	 * polled.
+	 */
+	int hw_fifo_watermark;
+	enum gpio_signal int_signal;
+#endif
+
+	/* Run-time state, owned by the motion sense task. */
+	int present;
+#ifdef CONFIG_ACCEL_HW_FIFO
+	int hw_fifo;		/* Drained from its FIFO, not polled */
+#endif
+	timestamp_t next_poll;
+	vector_3_t raw_xyz;	/* As read from the sensor */
+	vector_3_t xyz;		/* Rotated into the base frame */
+	vector_3_t host_xyz;	/* Rotated into the standard frame */
+};
+
+/* Table of motion sensors. These must be defined in board.c. */
+extern struct motion_sensor_t motion_sensors[];
+extern const unsigned int motion_sensor_count;
+
 /**
  * Get last calculated lid angle. Note, the lid angle calculated by the EC
  * is un-calibrated and is an approximate angle.
@@ -60,6 +120,11 @@ struct accel_orientation acc_orient;
  */
 int motion_get_lid_angle(void);
 
+/**
+ * Recompute the constants the lid angle calculation derives from acc_orient.
+ * Call after changing the hinge axis or the hinge rotation matrices.
+ */
+void motion_orientation_changed(void);
 
 #ifdef CONFIG_ACCEL_CALIBRATE
 /**
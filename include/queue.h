@@ -33,8 +33,24 @@ int queue_is_empty(const struct queue *q);
 /* Return TRUE if the queue has at least one unit space. */
 int queue_has_space(const struct queue *q, int unit_count);
 
+/* Return the number of units in the queue. */
+int queue_count(const struct queue *q);
+
 /* Add multiple units into queue. */
 void queue_add_units(struct queue *q, const void *src, int unit_count);
 
 /* Remove one unit from the begin of the queue. */
 int queue_remove_unit(struct queue *q, void *dest);
+
+/*
+ * Remove up to unit_count units from the begin of the queue.  Returns the
+ * number of units removed.
+ */
+int queue_remove_units(struct queue *q, void *dest, int unit_count);
+
+/*
+ * Copy up to unit_count units, starting offset units from the begin of the
+ * queue, without removing them.  Returns the number of units copied.
+ */
+int queue_peek_units(const struct queue *q, void *dest, int offset,
+		     int unit_count);
@@ -60,4 +60,25 @@ extern const struct temp_sensor_t temp_sensors[];
  */
 int temp_sensor_read(enum temp_sensor_id id, int *temp_ptr);
 
+#ifdef CONFIG_TEMP_SENSOR_POLL
+/*
+ * Readings older than this are reported as EC_ERROR_TIMEOUT, so a stuck
+ * sensor or poller can't leave a stale temperature in control.
+ */
+#define TEMP_SENSOR_MAX_AGE (3 * SECOND)
+
+/**
+ * Get the most recent reading for the sensor and how old it is.
+ *
+ * @param id		Sensor ID
+ * @param temp_ptr	Destination for temperature
+ * @param age_ptr	Destination for the age of the reading in us
+ *
+ * @return the result of reading the sensor, or EC_ERROR_TIMEOUT if the
+ * reading is older than TEMP_SENSOR_MAX_AGE.
+ */
+int temp_sensor_read_age(enum temp_sensor_id id, int *temp_ptr,
+			 uint32_t *age_ptr);
+#endif
+
 #endif  /* __CROS_EC_TEMP_SENSOR_H */
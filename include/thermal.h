@@ -16,4 +16,19 @@
  */
 extern struct ec_thermal_config thermal_params[];
 
+#ifdef CONFIG_FAN_PID
+/* Closed-loop control profile for each fan, also defined by the board. */
+extern struct ec_fan_pid_config fan_pid_params[];
+
+/**
+ * Check whether a fan is driven by its PID loop.
+ *
+ * @param fan	Fan number (index into fans[])
+ *
+ * @return non-zero if fan_pid_params[fan] is in use; otherwise the fan
+ * follows the thermal_params[] fan ramps.
+ */
+int fan_pid_enabled(int fan);
+#endif
+
 #endif  /* __CROS_EC_THERMAL_H */
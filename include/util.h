@@ -111,6 +111,18 @@ int uint64divmod(uint64_t *v, int by);
  */
 int get_next_bit(uint32_t *mask);
 
+/**
+ * Find the bucket of a histogram with power-of-two buckets for a value.
+ *
+ * Bucket n counts values in [2^n, 2^(n+1)); bucket 0 also counts 0, and the
+ * last bucket counts everything too big for the others.
+ *
+ * @param val		Value to count
+ * @param count		Number of buckets
+ * @return bucket index (0..count-1)
+ */
+int histogram_log2_bucket(uint32_t val, int count);
+
 
 /****************************************************************************/
 /* Conditional stuff.
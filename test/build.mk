@@ -24,6 +24,8 @@ test-list-host+=thermal flash queue kb_8042 extpwr_gpio console_edit system
 test-list-host+=sbs_charging adapter host_command thermal_falco led_spring
 test-list-host+=bklight_lid bklight_passthru interrupt timer_dos button
 test-list-host+=motion_sense math_util sbs_charging_v2 battery_get_params_smart
+test-list-host+=flash_write_combine kb_latency i2c_async i2c_regcache
+test-list-host+=i2c_stats i2c_emul temp_poll fan_pid
 
 adapter-y=adapter.o
 button-y=button.o
@@ -31,10 +33,17 @@ bklight_lid-y=bklight_lid.o
 bklight_passthru-y=bklight_passthru.o
 console_edit-y=console_edit.o
 extpwr_gpio-y=extpwr_gpio.o
+fan_pid-y=fan_pid.o
 flash-y=flash.o
+flash_write_combine-y=flash_write_combine.o
 hooks-y=hooks.o
+i2c_async-y=i2c_async.o
+i2c_emul-y=i2c_emul.o
+i2c_regcache-y=i2c_regcache.o
+i2c_stats-y=i2c_stats.o
 host_command-y=host_command.o
 kb_8042-y=kb_8042.o
+kb_latency-y=kb_latency.o
 interrupt-y=interrupt.o
 kb_mkbp-y=kb_mkbp.o
 kb_scan-y=kb_scan.o
@@ -51,6 +60,7 @@ sbs_charging-y=sbs_charging.o
 sbs_charging_v2-y=sbs_charging_v2.o
 stress-y=stress.o
 system-y=system.o
+temp_poll-y=temp_poll.o
 thermal-y=thermal.o
 thermal_falco-y=thermal_falco.o
 timer_calib-y=timer_calib.o
@@ -0,0 +1,340 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Test closed-loop PID fan control.
+ */
+
+#include "common.h"
+#include "console.h"
+#include "ec_commands.h"
+#include "fan.h"
+#include "hooks.h"
+#include "host_command.h"
+#include "temp_sensor.h"
+#include "test_util.h"
+#include "thermal.h"
+#include "timer.h"
+#include "util.h"
+
+/*****************************************************************************/
+/* Exported data */
+
+struct ec_thermal_config thermal_params[TEMP_SENSOR_COUNT];
+struct ec_fan_pid_config fan_pid_params[CONFIG_FANS];
+
+/* The tests below make some assumptions. */
+BUILD_ASSERT(TEMP_SENSOR_COUNT == 4);
+BUILD_ASSERT(CONFIG_FANS == 1);
+
+/*****************************************************************************/
+/* Mock functions */
+
+static int mock_temp[TEMP_SENSOR_COUNT];
+static int fan_pct;
+static int fan_updates;
+
+int dummy_temp_get_val(int idx, int *temp_ptr)
+{
+	if (mock_temp[idx] >= 0) {
+		*temp_ptr = mock_temp[idx];
+		return EC_SUCCESS;
+	}
+
+	return EC_ERROR_NOT_POWERED;
+}
+
+void chipset_force_shutdown(void)
+{
+}
+
+void chipset_throttle_cpu(int throttled)
+{
+}
+
+void host_throttle_cpu(int throttled)
+{
+}
+
+void fan_set_percent_needed(int fan, int pct)
+{
+	fan_pct = pct;
+	fan_updates++;
+}
+
+/*****************************************************************************/
+/* Test utilities */
+
+static void set_temps(int t0, int t1, int t2, int t3)
+{
+	mock_temp[0] = t0;
+	mock_temp[1] = t1;
+	mock_temp[2] = t2;
+	mock_temp[3] = t3;
+}
+
+static void all_temps(int t)
+{
+	set_temps(t, t, t, t);
+}
+
+static int set_profile(int target, int hysteresis, int kp, int ki, int kd)
+{
+	struct ec_params_fan_pid_set_config p;
+
+	memset(&p, 0, sizeof(p));
+	p.fan = 0;
+	p.cfg.temp_target = target;
+	p.cfg.hysteresis = hysteresis;
+	p.cfg.period_ms = HOOK_TICK_INTERVAL_MS;
+	p.cfg.kp = kp;
+	p.cfg.ki = ki;
+	p.cfg.kd = kd;
+	memset(p.cfg.weight, 1, TEMP_SENSOR_COUNT);
+
+	return test_send_host_command(EC_CMD_FAN_PID_SET_CONFIG, 0, &p,
+				      sizeof(p), NULL, 0);
+}
+
+/* Let the loop run a few times */
+static void settle(void)
+{
+	msleep(HOOK_TICK_INTERVAL_MS * 3);
+}
+
+/* Wait until the loop has just run */
+static void wait_for_update(void)
+{
+	int updates = fan_updates;
+
+	while (fan_updates == updates)
+		msleep(1);
+}
+
+static void reset_mocks(void)
+{
+	memset(thermal_params, 0, sizeof(thermal_params));
+	memset(fan_pid_params, 0, sizeof(fan_pid_params));
+	all_temps(300);
+	fan_pct = -1;
+	fan_updates = 0;
+}
+
+/*****************************************************************************/
+/* Tests */
+
+static int test_hysteresis(void)
+{
+	reset_mocks();
+	TEST_ASSERT(set_profile(330, 3, 100, 0, 0) == EC_RES_SUCCESS);
+
+	/* Off below the target */
+	all_temps(325);
+	settle();
+	TEST_ASSERT(fan_pct == 0);
+
+	/* On at the target, and at least turning */
+	all_temps(330);
+	settle();
+	TEST_ASSERT(fan_pct == 1);
+
+	all_temps(335);
+	settle();
+	TEST_ASSERT(fan_pct == 5);
+
+	/* Stays on until it's cooled past the hysteresis */
+	all_temps(328);
+	settle();
+	TEST_ASSERT(fan_pct == 1);
+	all_temps(327);
+	settle();
+	TEST_ASSERT(fan_pct == 1);
+	all_temps(326);
+	settle();
+	TEST_ASSERT(fan_pct == 0);
+
+	/* And off until it gets back to the target */
+	all_temps(329);
+	settle();
+	TEST_ASSERT(fan_pct == 0);
+
+	return EC_SUCCESS;
+}
+
+static int test_weights(void)
+{
+	struct ec_params_fan_pid_get_config p = { .fan = 0 };
+	struct ec_response_fan_pid_get_config r;
+
+	reset_mocks();
+	TEST_ASSERT(set_profile(320, 0, 100, 0, 0) == EC_RES_SUCCESS);
+
+	/* Sensor 1 is ignored; sensor 3 counts three times as much */
+	fan_pid_params[0].weight[1] = 0;
+	fan_pid_params[0].weight[2] = 0;
+	fan_pid_params[0].weight[3] = 3;
+	set_temps(300, 400, 400, 340);
+	settle();
+	TEST_ASSERT(fan_pct == 10);
+
+	TEST_ASSERT(test_send_host_command(EC_CMD_FAN_PID_GET_CONFIG, 0, &p,
+					   sizeof(p), &r, sizeof(r)) ==
+		    EC_RES_SUCCESS);
+	TEST_ASSERT(r.temp == 330);
+	TEST_ASSERT(r.percent == 10);
+	TEST_ASSERT(r.flags & EC_FAN_PID_FLAG_ON);
+	TEST_ASSERT(r.cfg.weight[3] == 3);
+
+	/* Sensors which can't be read don't count */
+	mock_temp[0] = -1;
+	settle();
+	TEST_ASSERT(fan_pct == 20);
+
+	/* Nor do they change anything when none can be read */
+	mock_temp[3] = -1;
+	settle();
+	TEST_ASSERT(fan_pct == 20);
+
+	return EC_SUCCESS;
+}
+
+static int test_integral(void)
+{
+	int pct;
+
+	reset_mocks();
+	TEST_ASSERT(set_profile(320, 5, 0, 200, 0) == EC_RES_SUCCESS);
+
+	/* 10 K over at 2 %/K*s winds up by about 20% a second */
+	all_temps(330);
+	sleep(1);
+	pct = fan_pct;
+	TEST_ASSERT(pct >= 10 && pct <= 30);
+	sleep(1);
+	TEST_ASSERT(fan_pct - pct >= 10 && fan_pct - pct <= 30);
+
+	/* It doesn't wind up past full speed... */
+	sleep(5);
+	TEST_ASSERT(fan_pct == 100);
+
+	/* ...so it starts to come down as soon as the error goes away */
+	all_temps(316);
+	sleep(1);
+	TEST_ASSERT(fan_pct > 1 && fan_pct < 100);
+
+	return EC_SUCCESS;
+}
+
+static int test_rate(void)
+{
+	reset_mocks();
+	TEST_ASSERT(set_profile(320, 0, 100, 0, 0) == EC_RES_SUCCESS);
+	all_temps(330);
+	settle();
+
+	/* Once a hook tick */
+	wait_for_update();
+	fan_updates = 0;
+	msleep(HOOK_TICK_INTERVAL_MS * 4 + HOOK_TICK_INTERVAL_MS / 2);
+	TEST_ASSERT(fan_updates == 4);
+
+	/* Once every other tick */
+	fan_pid_params[0].period_ms = HOOK_TICK_INTERVAL_MS * 2;
+	settle();
+	wait_for_update();
+	fan_updates = 0;
+	msleep(HOOK_TICK_INTERVAL_MS * 8 + HOOK_TICK_INTERVAL_MS / 2);
+	TEST_ASSERT(fan_updates == 4);
+
+	return EC_SUCCESS;
+}
+
+static int test_zero_period(void)
+{
+	reset_mocks();
+	TEST_ASSERT(set_profile(320, 0, 100, 0, 100) == EC_RES_SUCCESS);
+
+	/* Only a board table can leave the period 0; it runs every tick */
+	fan_pid_params[0].period_ms = 0;
+	all_temps(330);
+	wait_for_update();
+	TEST_ASSERT(fan_pct == 10);
+	fan_updates = 0;
+	msleep(HOOK_TICK_INTERVAL_MS * 4 + HOOK_TICK_INTERVAL_MS / 2);
+	TEST_ASSERT(fan_updates == 4);
+
+	return EC_SUCCESS;
+}
+
+static int test_thermal_ramp(void)
+{
+	reset_mocks();
+
+	/* Without a target, the fan follows the thermal_params[] ramp */
+	thermal_params[0].temp_fan_off = 300;
+	thermal_params[0].temp_fan_max = 400;
+	all_temps(350);
+	sleep(2);
+	TEST_ASSERT(fan_pct == 50);
+
+	/* ...and the thermal engine leaves it alone once it has one */
+	TEST_ASSERT(set_profile(360, 0, 100, 0, 0) == EC_RES_SUCCESS);
+	sleep(2);
+	TEST_ASSERT(fan_pct == 0);
+
+	return EC_SUCCESS;
+}
+
+static int test_host_commands(void)
+{
+	struct ec_params_fan_pid_get_config p = { .fan = CONFIG_FANS };
+	struct ec_response_fan_pid_get_config r;
+	struct ec_params_fan_pid_set_config s;
+
+	reset_mocks();
+
+	TEST_ASSERT(test_send_host_command(EC_CMD_FAN_PID_GET_CONFIG, 0, &p,
+					   sizeof(p), &r, sizeof(r)) ==
+		    EC_RES_INVALID_PARAM);
+
+	memset(&s, 0, sizeof(s));
+	s.fan = CONFIG_FANS;
+	s.cfg.period_ms = 1000;
+	TEST_ASSERT(test_send_host_command(EC_CMD_FAN_PID_SET_CONFIG, 0, &s,
+					   sizeof(s), NULL, 0) ==
+		    EC_RES_INVALID_PARAM);
+
+	/* The loop needs a period */
+	s.fan = 0;
+	s.cfg.period_ms = 0;
+	TEST_ASSERT(test_send_host_command(EC_CMD_FAN_PID_SET_CONFIG, 0, &s,
+					   sizeof(s), NULL, 0) ==
+		    EC_RES_INVALID_PARAM);
+
+	TEST_ASSERT(set_profile(340, 4, 150, -2, 30) == EC_RES_SUCCESS);
+	p.fan = 0;
+	TEST_ASSERT(test_send_host_command(EC_CMD_FAN_PID_GET_CONFIG, 0, &p,
+					   sizeof(p), &r, sizeof(r)) ==
+		    EC_RES_SUCCESS);
+	TEST_ASSERT(r.cfg.temp_target == 340);
+	TEST_ASSERT(r.cfg.hysteresis == 4);
+	TEST_ASSERT(r.cfg.period_ms == HOOK_TICK_INTERVAL_MS);
+	TEST_ASSERT(r.cfg.kp == 150);
+	TEST_ASSERT(r.cfg.ki == -2);
+	TEST_ASSERT(r.cfg.kd == 30);
+
+	return EC_SUCCESS;
+}
+
+void run_test(void)
+{
+	RUN_TEST(test_hysteresis);
+	RUN_TEST(test_weights);
+	RUN_TEST(test_integral);
+	RUN_TEST(test_rate);
+	RUN_TEST(test_zero_period);
+	RUN_TEST(test_thermal_ramp);
+	RUN_TEST(test_host_commands);
+
+	test_print_result();
+}
@@ -21,6 +21,8 @@ static int mock_wp = -1;
 
 static int mock_flash_op_fail = EC_SUCCESS;
 
+static int flash_op_count;
+
 const char *testdata = "TestData00000000"; /* 16 bytes excluding NULL end */
 
 char flash_recorded_data[128];
@@ -47,6 +49,7 @@ void host_send_response(struct host_cmd_handler_args *args)
 
 int flash_pre_op(void)
 {
+	flash_op_count++;
 	return mock_flash_op_fail;
 }
 
@@ -260,6 +263,80 @@ static int test_read(void)
 	return EC_SUCCESS;
 }
 
+static int test_is_erased(void)
+{
+	int offset = CONFIG_FW_RW_OFF;
+	int size = CONFIG_FLASH_ERASE_SIZE * 4;
+
+	TEST_ASSERT(flash_erase(offset, size) == EC_SUCCESS);
+	TEST_ASSERT(flash_is_erased(offset, size));
+
+	/* Dirty words anywhere in the range are found */
+	TEST_ASSERT(flash_write(offset + size - 4, 2, testdata) ==
+		    EC_SUCCESS);
+	TEST_ASSERT(!flash_is_erased(offset, size));
+	TEST_ASSERT(!flash_is_erased(offset + size - 4, 4));
+	TEST_ASSERT(flash_is_erased(offset, size - 4));
+
+	return EC_SUCCESS;
+}
+
+static int test_erase_skip(void)
+{
+	int offset = CONFIG_FW_RW_OFF;
+	int block = CONFIG_FLASH_ERASE_SIZE;
+	char data[CONFIG_FLASH_ERASE_SIZE * 2];
+
+	memset(data, 0, sizeof(data));
+	TEST_ASSERT(flash_erase(offset, block * 8) == EC_SUCCESS);
+
+	/* Erasing erased flash does nothing */
+	flash_op_count = 0;
+	TEST_ASSERT(flash_erase(offset, block * 8) == EC_SUCCESS);
+	TEST_ASSERT(flash_op_count == 0);
+
+	/* Dirty blocks 1, 2 and 5; adjacent dirty blocks are erased at once */
+	TEST_ASSERT(flash_write(offset + block, sizeof(data), data) ==
+		    EC_SUCCESS);
+	TEST_ASSERT(flash_write(offset + block * 5, 2, data) ==
+		    EC_SUCCESS);
+	flash_op_count = 0;
+	TEST_ASSERT(flash_erase(offset, block * 8) == EC_SUCCESS);
+	TEST_ASSERT(flash_op_count == 2);
+	TEST_ASSERT(verify_erase(offset, block * 8) == EC_SUCCESS);
+
+	return EC_SUCCESS;
+}
+
+static int test_pstate_compat(void)
+{
+	int off = CONFIG_FW_PSTATE_OFF;
+	const char v2_off[4] = {2, 0, 0, 0};
+	const char v2_on[4] = {2, 0x02, 0, 0};
+	int enable = 0;
+	int i;
+
+	/* Older images read a version 2 record at the start of the bank */
+	for (i = 0; i < 3; i++) {
+		enable = !enable;
+		TEST_ASSERT(flash_protect_ro_at_boot(enable) == EC_SUCCESS);
+		TEST_ASSERT(verify_write(off, 4, enable ? v2_on : v2_off) ==
+			    EC_SUCCESS);
+		TEST_ASSERT(!!(flash_get_protect() &
+			       EC_FLASH_PROTECT_RO_AT_BOOT) == enable);
+	}
+
+	/* Unchanged flags don't touch flash */
+	flash_op_count = 0;
+	TEST_ASSERT(flash_protect_ro_at_boot(enable) == EC_SUCCESS);
+	TEST_ASSERT(flash_op_count == 0);
+
+	SET_WP_FLAGS(EC_FLASH_PROTECT_RO_AT_BOOT, 0);
+	ASSERT_WP_NO_FLAGS(EC_FLASH_PROTECT_RO_AT_BOOT);
+
+	return EC_SUCCESS;
+}
+
 static int test_overwrite_current(void)
 {
 	uint32_t offset, size;
@@ -421,6 +498,9 @@ static void run_test_step1(void)
 	mock_wp = 0;
 
 	RUN_TEST(test_read);
+	RUN_TEST(test_is_erased);
+	RUN_TEST(test_erase_skip);
+	RUN_TEST(test_pstate_compat);
 	RUN_TEST(test_overwrite_current);
 	RUN_TEST(test_overwrite_other);
 	RUN_TEST(test_op_failure);
@@ -0,0 +1,214 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for flash write combining.
+ */
+
+#include "common.h"
+#include "console.h"
+#include "ec_commands.h"
+#include "flash.h"
+#include "test_util.h"
+#include "timer.h"
+#include "util.h"
+
+/* Offset of scratch area, inside RW so nothing we care about gets trashed */
+#define TEST_OFFSET CONFIG_FW_RW_OFF
+
+static int physical_ops;
+
+static const char testdata[CONFIG_FLASH_WRITE_IDEAL_SIZE * 4] = {
+	[0] = 0x12, [1] = 0x34, [CONFIG_FLASH_WRITE_IDEAL_SIZE] = 0x56,
+	[sizeof(testdata) - 1] = 0x78,
+};
+
+/*****************************************************************************/
+/* Mock functions */
+
+/* Called by the emulator flash model before every physical write/erase */
+int flash_pre_op(void)
+{
+	physical_ops++;
+	return EC_SUCCESS;
+}
+
+/*****************************************************************************/
+/* Test utilities */
+
+static int erase_scratch(void)
+{
+	int rv = flash_erase(TEST_OFFSET, CONFIG_FLASH_BANK_SIZE);
+
+	physical_ops = 0;
+	return rv;
+}
+
+static int flash_matches(int offset, const char *data, int size)
+{
+	return !memcmp(__host_flash + offset, data, size);
+}
+
+/**
+ * Write size bytes of testdata in chunk-sized pieces.
+ *
+ * @return number of physical flash operations required.
+ */
+static int write_in_chunks(int size, int chunk)
+{
+	int i;
+
+	physical_ops = 0;
+	for (i = 0; i < size; i += chunk)
+		if (flash_write(TEST_OFFSET + i, chunk, testdata + i))
+			return -1;
+	flash_write_flush();
+
+	ccprintf("%4d x %3d B writes -> %3d physical\n", size / chunk, chunk,
+		 physical_ops);
+
+	return physical_ops;
+}
+
+/*****************************************************************************/
+/* Tests */
+
+static int test_small_writes(void)
+{
+	const int ideal = CONFIG_FLASH_WRITE_IDEAL_SIZE;
+
+	/* Minimum-size writes are combined into ideal-size blocks */
+	TEST_ASSERT(erase_scratch() == EC_SUCCESS);
+	TEST_ASSERT(write_in_chunks(sizeof(testdata),
+				    CONFIG_FLASH_WRITE_SIZE) ==
+		    sizeof(testdata) / ideal);
+	TEST_ASSERT(flash_matches(TEST_OFFSET, testdata, sizeof(testdata)));
+
+	/* Chunks which straddle block boundaries still fill whole blocks */
+	TEST_ASSERT(erase_scratch() == EC_SUCCESS);
+	TEST_ASSERT(write_in_chunks(ideal * 3, ideal * 3 / 4) == 3);
+	TEST_ASSERT(flash_matches(TEST_OFFSET, testdata, ideal * 3));
+
+	/* Large aligned writes go straight through */
+	TEST_ASSERT(erase_scratch() == EC_SUCCESS);
+	TEST_ASSERT(write_in_chunks(sizeof(testdata), sizeof(testdata)) == 1);
+	TEST_ASSERT(flash_matches(TEST_OFFSET, testdata, sizeof(testdata)));
+
+	return EC_SUCCESS;
+}
+
+static int test_non_sequential(void)
+{
+	TEST_ASSERT(erase_scratch() == EC_SUCCESS);
+
+	/* A write which doesn't append to the buffer flushes it */
+	TEST_ASSERT(flash_write(TEST_OFFSET + 16, 16, testdata + 16) ==
+		    EC_SUCCESS);
+	TEST_ASSERT(physical_ops == 0);
+	TEST_ASSERT(flash_write(TEST_OFFSET, 16, testdata) == EC_SUCCESS);
+	TEST_ASSERT(physical_ops == 1);
+	TEST_ASSERT(flash_matches(TEST_OFFSET + 16, testdata + 16, 16));
+
+	TEST_ASSERT(flash_write_flush() == EC_SUCCESS);
+	TEST_ASSERT(physical_ops == 2);
+	TEST_ASSERT(flash_matches(TEST_OFFSET, testdata, 32));
+
+	/* Flushing an empty buffer does nothing */
+	TEST_ASSERT(flash_write_flush() == EC_SUCCESS);
+	TEST_ASSERT(physical_ops == 2);
+
+	return EC_SUCCESS;
+}
+
+static int test_read_flushes(void)
+{
+	const char *ptr;
+	char buf[16];
+	struct ec_params_flash_read params;
+
+	TEST_ASSERT(erase_scratch() == EC_SUCCESS);
+
+	/* Direct flash readers see buffered data */
+	TEST_ASSERT(flash_write(TEST_OFFSET, 16, testdata) == EC_SUCCESS);
+	TEST_ASSERT(!flash_matches(TEST_OFFSET, testdata, 16));
+	TEST_ASSERT(flash_dataptr(TEST_OFFSET, 16, 1, &ptr) > 0);
+	TEST_ASSERT_ARRAY_EQ(ptr, testdata, 16);
+
+	/* So do host readers */
+	TEST_ASSERT(flash_write(TEST_OFFSET + 16, 16, testdata + 16) ==
+		    EC_SUCCESS);
+	params.offset = TEST_OFFSET + 16;
+	params.size = sizeof(buf);
+	TEST_ASSERT(test_send_host_command(EC_CMD_FLASH_READ, 0, &params,
+					   sizeof(params), buf, sizeof(buf)) ==
+		    EC_RES_SUCCESS);
+	TEST_ASSERT_ARRAY_EQ(buf, testdata + 16, sizeof(buf));
+
+	/* And so does flash_is_erased() */
+	TEST_ASSERT(flash_write(TEST_OFFSET + 32, 16, testdata) == EC_SUCCESS);
+	TEST_ASSERT(!flash_is_erased(TEST_OFFSET + 32, 16));
+
+	return EC_SUCCESS;
+}
+
+static int test_timeout(void)
+{
+	TEST_ASSERT(erase_scratch() == EC_SUCCESS);
+
+	TEST_ASSERT(flash_write(TEST_OFFSET, 16, testdata) == EC_SUCCESS);
+	TEST_ASSERT(physical_ops == 0);
+
+	/* Buffer is committed by itself once writes go idle */
+	msleep(100);
+	TEST_ASSERT(physical_ops == 1);
+	TEST_ASSERT(flash_matches(TEST_OFFSET, testdata, 16));
+
+	return EC_SUCCESS;
+}
+
+static int test_erase_discards(void)
+{
+	TEST_ASSERT(erase_scratch() == EC_SUCCESS);
+
+	/*
+	 * No point writing buffered data which is about to be erased, and
+	 * since it never reached flash the erase has nothing to do either.
+	 */
+	TEST_ASSERT(flash_write(TEST_OFFSET, 16, testdata) == EC_SUCCESS);
+	TEST_ASSERT(flash_erase(TEST_OFFSET, CONFIG_FLASH_ERASE_SIZE * 2) ==
+		    EC_SUCCESS);
+	TEST_ASSERT(flash_write_flush() == EC_SUCCESS);
+	TEST_ASSERT(physical_ops == 0);
+	TEST_ASSERT(flash_is_erased(TEST_OFFSET, 16));
+
+	return EC_SUCCESS;
+}
+
+static int test_write_protect(void)
+{
+	TEST_ASSERT(erase_scratch() == EC_SUCCESS);
+
+	/* Writes to protected banks fail now, not when the buffer flushes */
+	TEST_ASSERT(flash_physical_protect_now(1) == EC_SUCCESS);
+	TEST_ASSERT(flash_write(TEST_OFFSET, 16, testdata) ==
+		    EC_ERROR_ACCESS_DENIED);
+	TEST_ASSERT(flash_write_flush() == EC_SUCCESS);
+	TEST_ASSERT(physical_ops == 0);
+	TEST_ASSERT(flash_is_erased(TEST_OFFSET, 16));
+
+	return EC_SUCCESS;
+}
+
+void run_test(void)
+{
+	test_reset();
+
+	RUN_TEST(test_small_writes);
+	RUN_TEST(test_non_sequential);
+	RUN_TEST(test_read_flushes);
+	RUN_TEST(test_timeout);
+	RUN_TEST(test_erase_discards);
+	RUN_TEST(test_write_protect);
+
+	test_print_result();
+}
@@ -0,0 +1,197 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Test queued I2C transactions.
+ */
+
+#include "common.h"
+#include "i2c.h"
+#include "task.h"
+#include "test_util.h"
+#include "timer.h"
+#include "util.h"
+
+#define PORT 0
+#define SLAVE_GOOD 0x10
+#define SLAVE_BAD 0x99
+
+/* Time each mock transfer holds the bus. */
+#define XFER_MS 5
+
+#define TASK_EVENT_DONE TASK_EVENT_CUSTOM(1)
+
+/* Slave addresses of the transfers seen, in order. */
+static int xfer_log[16];
+static int xfer_count;
+
+/* Transfers in progress, to catch two running at once. */
+static int xfers_running;
+static int xfers_overlapped;
+
+/*****************************************************************************/
+/* Mock functions */
+
+int i2c_xfer(int port, int slave_addr, const uint8_t *out, int out_size,
+	     uint8_t *in, int in_size, int flags)
+{
+	int i;
+
+	if (++xfers_running > 1)
+		xfers_overlapped = 1;
+
+	if (xfer_count < ARRAY_SIZE(xfer_log))
+		xfer_log[xfer_count] = slave_addr;
+	xfer_count++;
+
+	msleep(XFER_MS);
+
+	/* Reads return the first byte written, counting up. */
+	for (i = 0; i < in_size; i++)
+		in[i] = (out_size ? out[0] : 0) + i;
+
+	xfers_running--;
+	return slave_addr == SLAVE_BAD ? EC_ERROR_UNKNOWN : EC_SUCCESS;
+}
+
+/*****************************************************************************/
+/* Test utilities */
+
+static int done_calls;
+static struct i2c_request *done_req;
+
+static void request_done(struct i2c_request *req)
+{
+	done_calls++;
+	done_req = req;
+}
+
+static void reset_log(void)
+{
+	xfer_count = 0;
+	xfers_overlapped = 0;
+}
+
+static int test_transfer(void)
+{
+	const uint8_t reg = 0x40;
+	uint8_t in[2];
+	const struct i2c_msg msgs[] = {
+		{SLAVE_GOOD, &reg, 1, in, 2, I2C_XFER_START},
+		{SLAVE_GOOD, NULL, 0, NULL, 0, I2C_XFER_STOP},
+	};
+	const struct i2c_msg bad_msgs[] = {
+		{SLAVE_BAD, &reg, 1, NULL, 0, I2C_XFER_SINGLE},
+		{SLAVE_GOOD, &reg, 1, NULL, 0, I2C_XFER_SINGLE},
+	};
+
+	reset_log();
+	TEST_ASSERT(i2c_transfer(PORT, msgs, ARRAY_SIZE(msgs)) == EC_SUCCESS);
+	TEST_ASSERT(xfer_count == 2);
+	TEST_ASSERT(in[0] == 0x40 && in[1] == 0x41);
+
+	/* A failed message ends the transaction */
+	reset_log();
+	TEST_ASSERT(i2c_transfer(PORT, bad_msgs, ARRAY_SIZE(bad_msgs)) ==
+		    EC_ERROR_UNKNOWN);
+	TEST_ASSERT(xfer_count == 1);
+
+	return EC_SUCCESS;
+}
+
+static int test_submit(void)
+{
+	const uint8_t reg = 0x20;
+	uint8_t in[1];
+	const struct i2c_msg msg = {SLAVE_GOOD, &reg, 1, in, 1,
+				    I2C_XFER_SINGLE};
+	struct i2c_request req = {
+		.port = PORT,
+		.msgs = &msg,
+		.msg_count = 1,
+		.task = task_get_current(),
+		.event = TASK_EVENT_DONE,
+	};
+	timestamp_t t0;
+	uint32_t event;
+
+	/* Submitting does not wait for the bus */
+	reset_log();
+	t0 = get_time();
+	TEST_ASSERT(i2c_submit(&req) == EC_SUCCESS);
+	TEST_ASSERT(get_time().val - t0.val < XFER_MS * MSEC);
+	TEST_ASSERT(req.busy);
+
+	/* A request can't be queued twice */
+	TEST_ASSERT(i2c_submit(&req) == EC_ERROR_BUSY);
+
+	event = task_wait_event(100 * MSEC);
+	TEST_ASSERT(event & TASK_EVENT_DONE);
+	TEST_ASSERT(!req.busy);
+	TEST_ASSERT(req.rv == EC_SUCCESS);
+	TEST_ASSERT(in[0] == 0x20);
+	TEST_ASSERT(xfer_count == 1);
+
+	/* Bad ports are refused */
+	req.port = I2C_PORT_COUNT;
+	TEST_ASSERT(i2c_submit(&req) == EC_ERROR_INVAL);
+
+	return EC_SUCCESS;
+}
+
+static int test_queue_order(void)
+{
+	const uint8_t reg = 0;
+	struct i2c_msg msgs[3];
+	struct i2c_request reqs[3];
+	int i, j;
+
+	reset_log();
+	done_calls = 0;
+	memset(reqs, 0, sizeof(reqs));
+	for (i = 0; i < 3; i++) {
+		msgs[i].slave_addr = i == 1 ? SLAVE_BAD : SLAVE_GOOD + i;
+		msgs[i].out = &reg;
+		msgs[i].out_size = 1;
+		msgs[i].in = NULL;
+		msgs[i].in_size = 0;
+		msgs[i].flags = I2C_XFER_SINGLE;
+
+		reqs[i].port = PORT;
+		reqs[i].msgs = &msgs[i];
+		reqs[i].msg_count = 1;
+		reqs[i].done = request_done;
+		TEST_ASSERT(i2c_submit(&reqs[i]) == EC_SUCCESS);
+	}
+
+	/* A synchronous transfer meanwhile waits its turn for the port */
+	TEST_ASSERT(i2c_transfer(PORT, &msgs[0], 1) == EC_SUCCESS);
+
+	msleep(10 * XFER_MS);
+	TEST_ASSERT(done_calls == 3);
+	TEST_ASSERT(done_req == &reqs[2]);
+	TEST_ASSERT(!xfers_overlapped);
+
+	/* Requests ran in order, and each has its own result */
+	TEST_ASSERT(xfer_count == 4);
+	for (i = 0, j = 0; i < 3 && j < xfer_count; j++)
+		if (xfer_log[j] == msgs[i].slave_addr)
+			i++;
+	TEST_ASSERT(i == 3);
+	TEST_ASSERT(reqs[0].rv == EC_SUCCESS);
+	TEST_ASSERT(reqs[1].rv == EC_ERROR_UNKNOWN);
+	TEST_ASSERT(reqs[2].rv == EC_SUCCESS);
+
+	return EC_SUCCESS;
+}
+
+void run_test(void)
+{
+	test_reset();
+
+	RUN_TEST(test_transfer);
+	RUN_TEST(test_submit);
+	RUN_TEST(test_queue_order);
+
+	test_print_result();
+}
@@ -0,0 +1,213 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Test emulated I2C devices.
+ */
+
+#include "accelerometer.h"
+#include "battery_smart.h"
+#include "bq24715.h"
+#include "common.h"
+#include "driver/accel_kxcj9.h"
+#include "i2c.h"
+#include "i2c_emul.h"
+#include "motion_sense.h"
+#include "task.h"
+#include "test_util.h"
+#include "timer.h"
+#include "util.h"
+
+#define PORT 0
+#define TMP006_ADDR 0x80
+
+static struct i2c_emul_battery bat;
+static struct i2c_emul_tmp006 tmp006;
+static struct i2c_emul_bq24715 chg;
+static struct i2c_emul_kxcj9 acc;
+
+static int test_battery(void)
+{
+	uint8_t name[32];
+	int val;
+
+	i2c_emul_battery_init(&bat, PORT, BATTERY_ADDR);
+	i2c_emul_attach(&bat.emul);
+
+	TEST_ASSERT(i2c_read16(PORT, BATTERY_ADDR, SB_VOLTAGE, &val)
+		    == EC_SUCCESS);
+	TEST_ASSERT(val == 7600);
+	bat.regs[SB_RELATIVE_STATE_OF_CHARGE] = 99;
+	TEST_ASSERT(i2c_read16(PORT, BATTERY_ADDR,
+			       SB_RELATIVE_STATE_OF_CHARGE, &val)
+		    == EC_SUCCESS);
+	TEST_ASSERT(val == 99);
+
+	/* Only the host's own registers are writable */
+	TEST_ASSERT(i2c_write16(PORT, BATTERY_ADDR, SB_AT_RATE, 1000)
+		    == EC_SUCCESS);
+	TEST_ASSERT(bat.regs[SB_AT_RATE] == 1000);
+	TEST_ASSERT(i2c_write16(PORT, BATTERY_ADDR, SB_VOLTAGE, 1)
+		    != EC_SUCCESS);
+	TEST_ASSERT(bat.regs[SB_VOLTAGE] == 7600);
+
+	/* Strings are truncated to fit */
+	TEST_ASSERT(i2c_read_string(PORT, BATTERY_ADDR, SB_DEVICE_NAME, name,
+				    sizeof(name)) == EC_SUCCESS);
+	TEST_ASSERT(!strcasecmp((char *)name, "EMUL-2S"));
+	TEST_ASSERT(i2c_read_string(PORT, BATTERY_ADDR, SB_DEVICE_NAME, name,
+				    5) == EC_SUCCESS);
+	TEST_ASSERT(!strcasecmp((char *)name, "EMUL"));
+	name[0] = 'x';
+	TEST_ASSERT(i2c_read_string(PORT, BATTERY_ADDR, SB_DEVICE_NAME, name,
+				    0) == EC_ERROR_INVAL);
+	TEST_ASSERT(name[0] == 'x');
+
+	/* Gone once detached */
+	i2c_emul_detach(&bat.emul);
+	TEST_ASSERT(i2c_read16(PORT, BATTERY_ADDR, SB_VOLTAGE, &val)
+		    != EC_SUCCESS);
+
+	return EC_SUCCESS;
+}
+
+static int test_tmp006(void)
+{
+	int val;
+
+	i2c_emul_tmp006_init(&tmp006, PORT, TMP006_ADDR);
+	i2c_emul_attach(&tmp006.emul);
+
+	TEST_ASSERT(i2c_read16(PORT, TMP006_ADDR, 0xfe, &val) == EC_SUCCESS);
+	TEST_ASSERT(val == 0x5449);
+
+	/* Converting, so data is ready */
+	TEST_ASSERT(i2c_read16(PORT, TMP006_ADDR, 0x02, &val) == EC_SUCCESS);
+	TEST_ASSERT(val & (1 << 7));
+
+	/* 31.25 C die temperature; 1/32 C per LSB in bits 15:2 */
+	i2c_emul_tmp006_set(&tmp006, 3125, 1562500);
+	TEST_ASSERT(i2c_read16(PORT, TMP006_ADDR, 0x01, &val) == EC_SUCCESS);
+	TEST_ASSERT(val >> 2 == 1000);
+	TEST_ASSERT(i2c_read16(PORT, TMP006_ADDR, 0x00, &val) == EC_SUCCESS);
+	TEST_ASSERT(val == 10000);
+
+	/* Powered down, then reset back to converting */
+	TEST_ASSERT(i2c_write16(PORT, TMP006_ADDR, 0x02, 0) == EC_SUCCESS);
+	TEST_ASSERT(i2c_read16(PORT, TMP006_ADDR, 0x02, &val) == EC_SUCCESS);
+	TEST_ASSERT(!(val & (1 << 7)));
+	TEST_ASSERT(i2c_write16(PORT, TMP006_ADDR, 0x02, 1 << 15)
+		    == EC_SUCCESS);
+	TEST_ASSERT(i2c_read16(PORT, TMP006_ADDR, 0x02, &val) == EC_SUCCESS);
+	TEST_ASSERT(val == (0x7400 | (1 << 7)));
+
+	i2c_emul_detach(&tmp006.emul);
+
+	return EC_SUCCESS;
+}
+
+static int test_bq24715(void)
+{
+	int val;
+
+	i2c_emul_bq24715_init(&chg, PORT, CHARGER_ADDR);
+	i2c_emul_attach(&chg.emul);
+
+	TEST_ASSERT(i2c_read16(PORT, CHARGER_ADDR, BQ24715_DEVICE_ID, &val)
+		    == EC_SUCCESS);
+	TEST_ASSERT(val == 0x0010);
+
+	/* DAC registers drop the bits they don't implement */
+	TEST_ASSERT(i2c_write16(PORT, CHARGER_ADDR, BQ24715_CHARGE_CURRENT,
+				1000) == EC_SUCCESS);
+	TEST_ASSERT(i2c_read16(PORT, CHARGER_ADDR, BQ24715_CHARGE_CURRENT,
+			       &val) == EC_SUCCESS);
+	TEST_ASSERT(val == 960);
+	TEST_ASSERT(i2c_write16(PORT, CHARGER_ADDR, BQ24715_MAX_CHARGE_VOLTAGE,
+				8404) == EC_SUCCESS);
+	TEST_ASSERT(i2c_read16(PORT, CHARGER_ADDR, BQ24715_MAX_CHARGE_VOLTAGE,
+			       &val) == EC_SUCCESS);
+	TEST_ASSERT(val == 8400);
+
+	/* Unimplemented registers are not acknowledged */
+	TEST_ASSERT(i2c_read16(PORT, CHARGER_ADDR, 0x20, &val)
+		    != EC_SUCCESS);
+
+	i2c_emul_detach(&chg.emul);
+
+	return EC_SUCCESS;
+}
+
+static int test_kxcj9_driver(void)
+{
+	static struct mutex mutex;
+	static struct kxcj9_data data;
+	const struct motion_sensor_t s = {
+		.name = "emul",
+		.drv = &kxcj9_drv,
+		.mutex = &mutex,
+		.drv_data = &data,
+		.i2c_addr = KXCJ9_ADDR0,
+	};
+	int x, y, z, range;
+
+	i2c_emul_kxcj9_init(&acc, I2C_PORT_ACCEL, KXCJ9_ADDR0);
+	i2c_emul_attach(&acc.emul);
+
+	/* Run the real driver against the model */
+	TEST_ASSERT(s.drv->init(&s) == EC_SUCCESS);
+	TEST_ASSERT(acc.regs[KXCJ9_CTRL1] & KXCJ9_CTRL1_PC1);
+
+	acc.accel[0] = 0;
+	acc.accel[1] = -512;
+	acc.accel[2] = 1024;
+	TEST_ASSERT(s.drv->read(&s, &x, &y, &z) == EC_SUCCESS);
+	TEST_ASSERT(x == 0 && y == -512 && z == 1024);
+
+	/* At +/-8g the part has a quarter of the resolution */
+	TEST_ASSERT(s.drv->set_range(&s, 8, 0) == EC_SUCCESS);
+	TEST_ASSERT(s.drv->get_range(&s, &range) == EC_SUCCESS);
+	TEST_ASSERT(range == 8);
+	acc.accel[2] = 1027;
+	TEST_ASSERT(s.drv->read(&s, &x, &y, &z) == EC_SUCCESS);
+	TEST_ASSERT(z == 1024);
+
+	i2c_emul_detach(&acc.emul);
+
+	return EC_SUCCESS;
+}
+
+static int test_latency(void)
+{
+	timestamp_t t0;
+	int i, val;
+
+	i2c_emul_battery_init(&bat, PORT, BATTERY_ADDR);
+	bat.emul.latency_us = 500;
+	bat.emul.byte_us = 100;
+	i2c_emul_attach(&bat.emul);
+
+	/* Each word read moves three bytes after the address */
+	t0 = get_time();
+	for (i = 0; i < 10; i++)
+		TEST_ASSERT(i2c_read16(PORT, BATTERY_ADDR, SB_VOLTAGE, &val)
+			    == EC_SUCCESS);
+	TEST_ASSERT(get_time().val - t0.val >= 10 * (500 + 3 * 100));
+
+	i2c_emul_detach(&bat.emul);
+
+	return EC_SUCCESS;
+}
+
+void run_test(void)
+{
+	test_reset();
+
+	RUN_TEST(test_battery);
+	RUN_TEST(test_tmp006);
+	RUN_TEST(test_bq24715);
+	RUN_TEST(test_kxcj9_driver);
+	RUN_TEST(test_latency);
+
+	test_print_result();
+}
@@ -0,0 +1,203 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Test I2C register cache.
+ */
+
+#include "common.h"
+#include "i2c.h"
+#include "test_util.h"
+#include "util.h"
+
+#define PORT 0
+#define SLAVE 0x30
+
+#define REG_CTRL 0x10
+#define REG_CONFIG 0x11
+#define REG_DATA 0x20
+
+static const uint8_t cached_regs[] = { REG_CTRL, REG_CONFIG };
+
+static struct i2c_regcache cache;
+
+/*****************************************************************************/
+/* Mock device */
+
+static uint16_t dev_regs[256];
+static int dev_reads;
+static int dev_writes;
+
+static int mock_read(int port, int slave_addr, int offset, int *data)
+{
+	if (port != PORT || slave_addr != SLAVE)
+		return EC_ERROR_INVAL;
+	dev_reads++;
+	*data = dev_regs[offset];
+	return EC_SUCCESS;
+}
+
+static int mock_write(int port, int slave_addr, int offset, int data)
+{
+	if (port != PORT || slave_addr != SLAVE)
+		return EC_ERROR_INVAL;
+	dev_writes++;
+	dev_regs[offset] = data;
+	return EC_SUCCESS;
+}
+
+static int mock_read8(int port, int slave_addr, int offset, int *data)
+{
+	return mock_read(port, slave_addr, offset, data);
+}
+DECLARE_TEST_I2C_READ8(mock_read8);
+
+static int mock_write8(int port, int slave_addr, int offset, int data)
+{
+	return mock_write(port, slave_addr, offset, data & 0xff);
+}
+DECLARE_TEST_I2C_WRITE8(mock_write8);
+
+static int mock_read16(int port, int slave_addr, int offset, int *data)
+{
+	return mock_read(port, slave_addr, offset, data);
+}
+DECLARE_TEST_I2C_READ16(mock_read16);
+
+static int mock_write16(int port, int slave_addr, int offset, int data)
+{
+	return mock_write(port, slave_addr, offset, data & 0xffff);
+}
+DECLARE_TEST_I2C_WRITE16(mock_write16);
+
+/*****************************************************************************/
+/* Test utilities */
+
+static void reset_device(void)
+{
+	memset(dev_regs, 0, sizeof(dev_regs));
+	dev_regs[REG_CTRL] = 0x5a;
+	dev_regs[REG_DATA] = 0x01;
+	dev_reads = 0;
+	dev_writes = 0;
+	i2c_regcache_init(&cache, cached_regs, ARRAY_SIZE(cached_regs));
+}
+
+static int test_read_cached(void)
+{
+	int val;
+
+	reset_device();
+
+	/* The first read goes to the device, later ones do not */
+	TEST_ASSERT(i2c_regcache_read8(&cache, PORT, SLAVE, REG_CTRL, &val)
+		    == EC_SUCCESS);
+	TEST_ASSERT(val == 0x5a);
+	TEST_ASSERT(i2c_regcache_read8(&cache, PORT, SLAVE, REG_CTRL, &val)
+		    == EC_SUCCESS);
+	TEST_ASSERT(val == 0x5a);
+	TEST_ASSERT(dev_reads == 1);
+
+	/* Volatile registers are always read from the device */
+	TEST_ASSERT(i2c_regcache_read8(&cache, PORT, SLAVE, REG_DATA, &val)
+		    == EC_SUCCESS);
+	dev_regs[REG_DATA] = 0x02;
+	TEST_ASSERT(i2c_regcache_read8(&cache, PORT, SLAVE, REG_DATA, &val)
+		    == EC_SUCCESS);
+	TEST_ASSERT(val == 0x02);
+	TEST_ASSERT(dev_reads == 3);
+
+	return EC_SUCCESS;
+}
+
+static int test_write_through(void)
+{
+	int val;
+
+	reset_device();
+
+	/* Writes reach the device and fill the cache */
+	TEST_ASSERT(i2c_regcache_write8(&cache, PORT, SLAVE, REG_CONFIG, 0x33)
+		    == EC_SUCCESS);
+	TEST_ASSERT(dev_regs[REG_CONFIG] == 0x33);
+	TEST_ASSERT(i2c_regcache_read8(&cache, PORT, SLAVE, REG_CONFIG, &val)
+		    == EC_SUCCESS);
+	TEST_ASSERT(val == 0x33);
+	TEST_ASSERT(dev_reads == 0);
+	TEST_ASSERT(dev_writes == 1);
+
+	/* 16-bit registers share the same cache */
+	TEST_ASSERT(i2c_regcache_write16(&cache, PORT, SLAVE, REG_CONFIG,
+					 0x1234) == EC_SUCCESS);
+	TEST_ASSERT(i2c_regcache_read16(&cache, PORT, SLAVE, REG_CONFIG, &val)
+		    == EC_SUCCESS);
+	TEST_ASSERT(val == 0x1234);
+	TEST_ASSERT(dev_reads == 0);
+
+	return EC_SUCCESS;
+}
+
+static int test_update(void)
+{
+	reset_device();
+
+	/* Read-modify-write reads the device once */
+	TEST_ASSERT(i2c_regcache_update8(&cache, PORT, SLAVE, REG_CTRL, 0x0f,
+					 0x03) == EC_SUCCESS);
+	TEST_ASSERT(dev_regs[REG_CTRL] == 0x53);
+	TEST_ASSERT(i2c_regcache_update8(&cache, PORT, SLAVE, REG_CTRL, 0xf0,
+					 0x10) == EC_SUCCESS);
+	TEST_ASSERT(dev_regs[REG_CTRL] == 0x13);
+	TEST_ASSERT(dev_reads == 1);
+	TEST_ASSERT(dev_writes == 2);
+
+	/* Updates which change nothing are not written */
+	TEST_ASSERT(i2c_regcache_update8(&cache, PORT, SLAVE, REG_CTRL, 0x03,
+					 0x03) == EC_SUCCESS);
+	TEST_ASSERT(dev_writes == 2);
+
+	return EC_SUCCESS;
+}
+
+static int test_invalidate(void)
+{
+	int val;
+
+	reset_device();
+
+	TEST_ASSERT(i2c_regcache_write8(&cache, PORT, SLAVE, REG_CTRL, 0x77)
+		    == EC_SUCCESS);
+
+	/* Device resets behind the cache's back */
+	dev_regs[REG_CTRL] = 0x5a;
+	i2c_regcache_invalidate(&cache);
+	TEST_ASSERT(i2c_regcache_read8(&cache, PORT, SLAVE, REG_CTRL, &val)
+		    == EC_SUCCESS);
+	TEST_ASSERT(val == 0x5a);
+	TEST_ASSERT(dev_reads == 1);
+
+	/* A failed write leaves the register uncached */
+	test_detach_i2c(PORT, SLAVE);
+	TEST_ASSERT(i2c_regcache_write8(&cache, PORT, SLAVE, REG_CTRL, 0x66)
+		    != EC_SUCCESS);
+	TEST_ASSERT(i2c_regcache_read8(&cache, PORT, SLAVE, REG_CTRL, &val)
+		    != EC_SUCCESS);
+	test_attach_i2c(PORT, SLAVE);
+	TEST_ASSERT(i2c_regcache_read8(&cache, PORT, SLAVE, REG_CTRL, &val)
+		    == EC_SUCCESS);
+	TEST_ASSERT(val == 0x5a);
+
+	return EC_SUCCESS;
+}
+
+void run_test(void)
+{
+	test_reset();
+
+	RUN_TEST(test_read_cached);
+	RUN_TEST(test_write_through);
+	RUN_TEST(test_update);
+	RUN_TEST(test_invalidate);
+
+	test_print_result();
+}
@@ -0,0 +1,168 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Test I2C bus and lock statistics.
+ */
+
+#include "common.h"
+#include "ec_commands.h"
+#include "host_command.h"
+#include "i2c.h"
+#include "task.h"
+#include "test_util.h"
+#include "timer.h"
+#include "util.h"
+
+#define PORT 1
+
+/* Time the holder task keeps the port locked */
+#define HOLD_MS 20
+
+static int holder_locked;
+
+void holder_task(void)
+{
+	while (1) {
+		task_wait_event(-1);
+
+		i2c_lock(PORT, 1);
+		holder_locked = 1;
+		msleep(HOLD_MS);
+		holder_locked = 0;
+		i2c_lock(PORT, 0);
+	}
+}
+
+/*****************************************************************************/
+/* Test utilities */
+
+static int get_port_stats(int port, struct ec_response_i2c_stats_port *r,
+			  int flags)
+{
+	struct ec_params_i2c_stats p;
+
+	p.type = EC_I2C_STATS_PORT;
+	p.index = port;
+	p.flags = flags;
+	return test_send_host_command(EC_CMD_I2C_STATS, 0, &p, sizeof(p),
+				      r, sizeof(*r));
+}
+
+static int get_task_stats(int task, struct ec_response_i2c_stats_task *r,
+			  int flags)
+{
+	struct ec_params_i2c_stats p;
+
+	p.type = EC_I2C_STATS_TASK;
+	p.index = task;
+	p.flags = flags;
+	return test_send_host_command(EC_CMD_I2C_STATS, 0, &p, sizeof(p),
+				      r, sizeof(*r));
+}
+
+static int clear_stats(void)
+{
+	struct ec_response_i2c_stats_port rp;
+	struct ec_response_i2c_stats_task rt;
+
+	TEST_ASSERT(get_port_stats(PORT, &rp, EC_I2C_STATS_FLAG_CLEAR)
+		    == EC_RES_SUCCESS);
+	TEST_ASSERT(get_task_stats(TASK_ID_TEST_RUNNER, &rt,
+				   EC_I2C_STATS_FLAG_CLEAR) == EC_RES_SUCCESS);
+	TEST_ASSERT(get_task_stats(TASK_ID_HOLDER, &rt,
+				   EC_I2C_STATS_FLAG_CLEAR) == EC_RES_SUCCESS);
+
+	return EC_SUCCESS;
+}
+
+static int test_xfer_counts(void)
+{
+	struct ec_response_i2c_stats_port r;
+
+	TEST_ASSERT(clear_stats() == EC_SUCCESS);
+
+	i2c_stats_xfer(PORT, 3, EC_SUCCESS);
+	i2c_stats_xfer(PORT, 2, EC_ERROR_UNKNOWN);
+	i2c_stats_xfer(PORT, 1, EC_ERROR_TIMEOUT);
+
+	TEST_ASSERT(get_port_stats(PORT, &r, EC_I2C_STATS_FLAG_CLEAR)
+		    == EC_RES_SUCCESS);
+	TEST_ASSERT(r.xfers == 3);
+	TEST_ASSERT(r.bytes == 6);
+	TEST_ASSERT(r.naks == 1);
+	TEST_ASSERT(r.timeouts == 1);
+
+	/* Reading with the clear flag clears */
+	TEST_ASSERT(get_port_stats(PORT, &r, 0) == EC_RES_SUCCESS);
+	TEST_ASSERT(r.xfers == 0);
+
+	return EC_SUCCESS;
+}
+
+static int test_lock_contention(void)
+{
+	struct ec_response_i2c_stats_port rp;
+	struct ec_response_i2c_stats_task rt;
+	int i, waits;
+
+	TEST_ASSERT(clear_stats() == EC_SUCCESS);
+
+	/* Let the holder take the port, then wait for it */
+	task_wake(TASK_ID_HOLDER);
+	msleep(HOLD_MS / 4);
+	TEST_ASSERT(holder_locked);
+	i2c_lock(PORT, 1);
+	TEST_ASSERT(!holder_locked);
+	i2c_lock(PORT, 0);
+
+	/* Both locks counted against the port, which was busy while held */
+	TEST_ASSERT(get_port_stats(PORT, &rp, 0) == EC_RES_SUCCESS);
+	TEST_ASSERT(rp.locks == 2);
+	TEST_ASSERT(rp.busy_us >= HOLD_MS * 1000);
+	TEST_ASSERT(rp.hold_max_us >= HOLD_MS * 1000);
+
+	/* We waited for most of the hold, and never held it long */
+	TEST_ASSERT(get_task_stats(TASK_ID_TEST_RUNNER, &rt, 0)
+		    == EC_RES_SUCCESS);
+	TEST_ASSERT(rt.locks == 1);
+	TEST_ASSERT(rt.wait_max_us >= HOLD_MS * 1000 / 2);
+	TEST_ASSERT(rt.hold_us < HOLD_MS * 1000);
+	for (i = 0, waits = 0; i < EC_I2C_STATS_BUCKETS; i++)
+		waits += rt.buckets[i];
+	TEST_ASSERT(waits == 1);
+	TEST_ASSERT(rt.buckets[31 - __builtin_clz(rt.wait_max_us)] == 1);
+
+	/* The holder did not wait, and held the port for the full time */
+	TEST_ASSERT(get_task_stats(TASK_ID_HOLDER, &rt, 0) == EC_RES_SUCCESS);
+	TEST_ASSERT(rt.locks == 1);
+	TEST_ASSERT(rt.wait_max_us < HOLD_MS * 1000 / 2);
+	TEST_ASSERT(rt.hold_us >= HOLD_MS * 1000);
+
+	return EC_SUCCESS;
+}
+
+static int test_bad_index(void)
+{
+	struct ec_response_i2c_stats_port rp;
+	struct ec_response_i2c_stats_task rt;
+
+	TEST_ASSERT(get_port_stats(I2C_PORT_COUNT, &rp, 0)
+		    == EC_RES_INVALID_PARAM);
+	TEST_ASSERT(get_task_stats(TASK_ID_COUNT, &rt, 0)
+		    == EC_RES_INVALID_PARAM);
+
+	return EC_SUCCESS;
+}
+
+void run_test(void)
+{
+	test_reset();
+	msleep(30); /* Wait for TASK_ID_HOLDER to initialize */
+
+	RUN_TEST(test_xfer_counts);
+	RUN_TEST(test_lock_contention);
+	RUN_TEST(test_bad_index);
+
+	test_print_result();
+}
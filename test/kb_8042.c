@@ -16,6 +16,7 @@
 #include "lpc.h"
 #include "power_button.h"
 #include "system.h"
+#include "task.h"
 #include "test_util.h"
 #include "timer.h"
 #include "util.h"
@@ -25,6 +26,7 @@ static const char *action[2] = {"release", "press"};
 #define BUF_SIZE 16
 static char lpc_char_buf[BUF_SIZE];
 static unsigned int lpc_char_cnt;
+static int host_busy;
 
 /*****************************************************************************/
 /* Mock functions */
@@ -34,6 +36,11 @@ int lid_is_open(void)
 	return 1;
 }
 
+int lpc_keyboard_has_char(void)
+{
+	return host_busy;
+}
+
 void lpc_keyboard_put_char(uint8_t chr, int send_irq)
 {
 	lpc_char_buf[lpc_char_cnt++] = chr;
@@ -138,6 +145,70 @@ static int test_single_key_press(void)
 	return EC_SUCCESS;
 }
 
+static int test_matrix_batch(void)
+{
+	uint8_t changed[KEYBOARD_COLS] = {0};
+	uint8_t state[KEYBOARD_COLS] = {0};
+
+	enable_keystroke(1);
+	changed[1] = state[1] = 1 << 1;
+	changed[12] = state[12] = 1 << 6;
+	keyboard_matrix_changed(changed, state);
+	VERIFY_LPC_CHAR("\x01\xe0\x4d");
+
+	state[1] = state[12] = 0;
+	keyboard_matrix_changed(changed, state);
+	VERIFY_LPC_CHAR("\x81\xe0\xcd");
+
+	return EC_SUCCESS;
+}
+
+static int test_matrix_batch_full(void)
+{
+	uint8_t changed[KEYBOARD_COLS] = {0};
+	uint8_t state[KEYBOARD_COLS] = {0};
+	int i;
+
+	enable_keystroke(1);
+
+	/* Hold the host off and leave room for only two more bytes */
+	host_busy = 1;
+	for (i = 0; i < 13; i++)
+		press_key(1, 1, 0);
+
+	/*
+	 * The three byte batch doesn't fit, but the one byte release at the
+	 * front of it still does.
+	 */
+	changed[1] = 1 << 1;
+	changed[12] = 1 << 6;
+	keyboard_matrix_changed(changed, state);
+
+	host_busy = 0;
+	task_wake(TASK_ID_KEYPROTO);
+	VERIFY_LPC_CHAR("\x81\x81\x81\x81\x81\x81\x81"
+			"\x81\x81\x81\x81\x81\x81\x81");
+	TEST_ASSERT(lpc_char_cnt == 14);
+
+	return EC_SUCCESS;
+}
+
+static int test_host_batch_clear(void)
+{
+	/*
+	 * Host bytes queued together are replied to together.  ENABLE clears
+	 * the output buffer, so the reply to READ_CMD_BYTE before it is
+	 * dropped while the replies after it still go out.
+	 */
+	keyboard_host_write(I8042_READ_CMD_BYTE, 1);
+	keyboard_host_write(I8042_CMD_ENABLE, 0);
+	keyboard_host_write(I8042_CMD_DIAG_ECHO, 0);
+	VERIFY_LPC_CHAR("\xfa\xfa\xee");
+	TEST_ASSERT(lpc_char_cnt == 3);
+
+	return EC_SUCCESS;
+}
+
 static int test_disable_keystroke(void)
 {
 	enable_keystroke(0);
@@ -262,6 +333,9 @@ void run_test(void)
 
 	if (system_get_image_copy() == SYSTEM_IMAGE_RO) {
 		RUN_TEST(test_single_key_press);
+		RUN_TEST(test_matrix_batch);
+		RUN_TEST(test_matrix_batch_full);
+		RUN_TEST(test_host_batch_clear);
 		RUN_TEST(test_disable_keystroke);
 		RUN_TEST(test_typematic);
 		RUN_TEST(test_scancode_set2);
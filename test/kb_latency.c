@@ -0,0 +1,178 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for key event latency tracing
+ */
+
+#include "common.h"
+#include "console.h"
+#include "ec_commands.h"
+#include "gpio.h"
+#include "host_command.h"
+#include "keyboard_raw.h"
+#include "keyboard_scan.h"
+#include "task.h"
+#include "test_util.h"
+#include "timer.h"
+#include "util.h"
+
+#define KEYDOWN_TIMEOUT_MS	1000
+#define HOST_DELAY_MS		5
+
+static uint8_t mock_state[KEYBOARD_COLS];
+static int column_driven;
+static int ec_int_level = 1;
+
+/*****************************************************************************/
+/* Mock functions */
+
+int lid_is_open(void)
+{
+	return 1;
+}
+
+void gpio_set_level(enum gpio_signal signal, int level)
+{
+	if (signal != GPIO_EC_INT)
+		return;
+
+	ec_int_level = !!level;
+	if (!ec_int_level)
+		task_wake(TASK_ID_TEST_RUNNER);
+}
+
+void keyboard_raw_drive_column(int out)
+{
+	column_driven = out;
+}
+
+int keyboard_raw_read_rows(void)
+{
+	int i;
+	int r = 0;
+
+	if (column_driven == KEYBOARD_COLUMN_NONE) {
+		return 0;
+	} else if (column_driven == KEYBOARD_COLUMN_ALL) {
+		for (i = 0; i < KEYBOARD_COLS; ++i)
+			r |= mock_state[i];
+		return r;
+	} else {
+		return mock_state[column_driven];
+	}
+}
+
+/*****************************************************************************/
+/* Test utilities */
+
+static int mock_key(int r, int c, int keydown)
+{
+	ccprintf("%s (%d, %d)\n", keydown ? "Pressing" : "Releasing", r, c);
+	if (keydown)
+		mock_state[c] |= (1 << r);
+	else
+		mock_state[c] &= ~(1 << r);
+
+	/*
+	 * Wait for the change to reach the MKBP FIFO and assert EC_INT.  The
+	 * timeout is only there to fail the test if it never does.
+	 */
+	task_wake(TASK_ID_KEYSCAN);
+	while (ec_int_level) {
+		if (task_wait_event(KEYDOWN_TIMEOUT_MS * MSEC) ==
+		    TASK_EVENT_TIMER)
+			return EC_ERROR_UNKNOWN;
+	}
+	return EC_SUCCESS;
+}
+
+static int host_pickup(void)
+{
+	uint8_t state[KEYBOARD_COLS];
+
+	return test_send_host_command(EC_CMD_MKBP_STATE, 0, NULL, 0,
+				      state, sizeof(state));
+}
+
+static int get_latency(struct ec_response_keyboard_latency *r, int clear)
+{
+	struct ec_params_keyboard_latency p;
+
+	p.flags = clear ? EC_KEYBOARD_LATENCY_FLAG_CLEAR : 0;
+	return test_send_host_command(EC_CMD_KEYBOARD_LATENCY, 0,
+				      &p, sizeof(p), r, sizeof(*r));
+}
+
+static int bucket_total(const struct ec_keyboard_latency_stage_stats *s)
+{
+	int i, n = 0;
+
+	for (i = 0; i < EC_KEYBOARD_LATENCY_BUCKETS; i++)
+		n += s->buckets[i];
+	return n;
+}
+
+#define STAGE(r, n) (&(r).stage[EC_KEYBOARD_LATENCY_ ## n])
+
+/*****************************************************************************/
+/* Tests */
+
+static int test_key_latency(void)
+{
+	const struct keyboard_scan_config *ksc = keyboard_scan_get_config();
+	struct ec_response_keyboard_latency r;
+
+	TEST_ASSERT(get_latency(&r, 1) == EC_RES_SUCCESS);
+
+	/* Press, and make the host wait a while before reading it */
+	TEST_ASSERT(mock_key(0, 1, 1) == EC_SUCCESS);
+	msleep(HOST_DELAY_MS);
+	TEST_ASSERT(host_pickup() == EC_RES_SUCCESS);
+
+	TEST_ASSERT(get_latency(&r, 1) == EC_RES_SUCCESS);
+	TEST_ASSERT(STAGE(r, SCAN)->count >= 1);
+	TEST_ASSERT(STAGE(r, DEBOUNCE)->count == 1);
+	TEST_ASSERT(STAGE(r, DEBOUNCE)->max_us >= ksc->debounce_down_us);
+	TEST_ASSERT(STAGE(r, ENCODE)->count == 1);
+	TEST_ASSERT(STAGE(r, HOST)->count == 1);
+	TEST_ASSERT(STAGE(r, HOST)->max_us >= HOST_DELAY_MS * MSEC);
+	TEST_ASSERT(bucket_total(STAGE(r, DEBOUNCE)) == 1);
+
+	/* Releases take longer to debounce */
+	TEST_ASSERT(mock_key(0, 1, 0) == EC_SUCCESS);
+	TEST_ASSERT(host_pickup() == EC_RES_SUCCESS);
+
+	TEST_ASSERT(get_latency(&r, 0) == EC_RES_SUCCESS);
+	TEST_ASSERT(STAGE(r, DEBOUNCE)->count == 1);
+	TEST_ASSERT(STAGE(r, DEBOUNCE)->max_us >= ksc->debounce_up_us);
+	TEST_ASSERT(STAGE(r, DEBOUNCE)->total_us >= ksc->debounce_up_us);
+	TEST_ASSERT(STAGE(r, HOST)->count == 1);
+
+	return EC_SUCCESS;
+}
+
+static int test_clear(void)
+{
+	struct ec_response_keyboard_latency r;
+	int i;
+
+	TEST_ASSERT(get_latency(&r, 1) == EC_RES_SUCCESS);
+	TEST_ASSERT(get_latency(&r, 0) == EC_RES_SUCCESS);
+	for (i = 0; i < EC_KEYBOARD_LATENCY_STAGE_COUNT; i++) {
+		TEST_ASSERT(r.stage[i].count == 0);
+		TEST_ASSERT(bucket_total(r.stage + i) == 0);
+	}
+
+	return EC_SUCCESS;
+}
+
+void run_test(void)
+{
+	test_reset();
+
+	RUN_TEST(test_key_latency);
+	RUN_TEST(test_clear);
+
+	test_print_result();
+}
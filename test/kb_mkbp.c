@@ -99,6 +99,31 @@ int verify_key(int c, int r, int pressed)
 	return 1;
 }
 
+/**
+ * Fetch queued events with EC_CMD_MKBP_GET_EVENTS
+ *
+ * @return number of events returned, or -1 on error
+ */
+int get_events(struct ec_response_mkbp_get_events *r, int size)
+{
+	struct host_cmd_handler_args args;
+
+	args.version = 0;
+	args.command = EC_CMD_MKBP_GET_EVENTS;
+	args.params = NULL;
+	args.params_size = 0;
+	args.response = r;
+	args.response_max = size;
+	args.response_size = 0;
+
+	if (host_command_process(&args) != EC_RES_SUCCESS)
+		return -1;
+	if (args.response_size != sizeof(*r) + r->count * sizeof(r->events[0]))
+		return -1;
+
+	return r->count;
+}
+
 int mkbp_config(struct ec_params_mkbp_set_config params)
 {
 	struct host_cmd_handler_args args;
@@ -183,6 +208,11 @@ int test_enable(void)
 	TEST_ASSERT(press_key(0, 0, 1) == EC_SUCCESS);
 	TEST_ASSERT(FIFO_EMPTY());
 
+	/* Buttons don't interrupt the host either */
+	keyboard_update_button(KEYBOARD_BUTTON_POWER, 1);
+	TEST_ASSERT(FIFO_EMPTY());
+	keyboard_update_button(KEYBOARD_BUTTON_POWER, 0);
+
 	TEST_ASSERT(set_kb_scan_enabled(1));
 	TEST_ASSERT(press_key(0, 0, 1) == EC_SUCCESS);
 	TEST_ASSERT(FIFO_NOT_EMPTY());
@@ -206,6 +236,92 @@ int fifo_underrun(void)
 	return EC_SUCCESS;
 }
 
+int test_batch_fetch(void)
+{
+	uint8_t buf[sizeof(struct ec_response_mkbp_get_events) +
+		    3 * sizeof(struct ec_mkbp_event_entry)];
+	struct ec_response_mkbp_get_events *r = (void *)buf;
+	int i;
+
+	keyboard_clear_buffer();
+	clear_state();
+	for (i = 0; i < 5; i++)
+		TEST_ASSERT(press_key(i, 1, 1) == EC_SUCCESS);
+
+	/* Only as many events as fit in the response come back */
+	TEST_ASSERT(get_events(r, sizeof(buf)) == 3);
+	TEST_ASSERT(FIFO_NOT_EMPTY());
+	clear_state();
+	for (i = 0; i < 3; i++) {
+		set_state(i, 1, 1);
+		TEST_ASSERT(r->events[i].event_type ==
+			    EC_MKBP_EVENT_KEY_MATRIX);
+		TEST_ASSERT_ARRAY_EQ(r->events[i].data.key_matrix, state,
+				     KEYBOARD_COLS);
+	}
+	for (i = 1; i < 3; i++)
+		TEST_ASSERT(r->events[i].timestamp >=
+			    r->events[i - 1].timestamp);
+
+	TEST_ASSERT(get_events(r, sizeof(buf)) == 2);
+	TEST_ASSERT(FIFO_EMPTY());
+	TEST_ASSERT(get_events(r, sizeof(buf)) == 0);
+
+	return EC_SUCCESS;
+}
+
+int test_typed_events(void)
+{
+	uint8_t buf[sizeof(struct ec_response_mkbp_get_events) +
+		    4 * sizeof(struct ec_mkbp_event_entry)];
+	struct ec_response_mkbp_get_events *r = (void *)buf;
+
+	keyboard_clear_buffer();
+	clear_state();
+	keyboard_update_button(KEYBOARD_BUTTON_VOLUME_UP, 1);
+	TEST_ASSERT(FIFO_NOT_EMPTY());
+	TEST_ASSERT(press_key(2, 3, 1) == EC_SUCCESS);
+	keyboard_update_button(KEYBOARD_BUTTON_VOLUME_DOWN, 1);
+	keyboard_update_button(KEYBOARD_BUTTON_VOLUME_UP, 0);
+
+	TEST_ASSERT(get_events(r, sizeof(buf)) == 4);
+	TEST_ASSERT(r->events[0].event_type == EC_MKBP_EVENT_BUTTON);
+	TEST_ASSERT(r->events[0].data.buttons ==
+		    1 << KEYBOARD_BUTTON_VOLUME_UP);
+	TEST_ASSERT(r->events[1].event_type == EC_MKBP_EVENT_KEY_MATRIX);
+	TEST_ASSERT(r->events[2].event_type == EC_MKBP_EVENT_BUTTON);
+	TEST_ASSERT(r->events[2].data.buttons ==
+		    (1 << KEYBOARD_BUTTON_VOLUME_UP |
+		     1 << KEYBOARD_BUTTON_VOLUME_DOWN));
+	TEST_ASSERT(r->events[3].data.buttons ==
+		    1 << KEYBOARD_BUTTON_VOLUME_DOWN);
+	TEST_ASSERT(FIFO_EMPTY());
+
+	keyboard_update_button(KEYBOARD_BUTTON_VOLUME_DOWN, 0);
+	TEST_ASSERT(get_events(r, sizeof(buf)) == 1);
+	TEST_ASSERT(r->events[0].data.buttons == 0);
+
+	return EC_SUCCESS;
+}
+
+int test_legacy_skips_events(void)
+{
+	keyboard_clear_buffer();
+	clear_state();
+	keyboard_update_button(KEYBOARD_BUTTON_POWER, 1);
+	TEST_ASSERT(press_key(1, 1, 1) == EC_SUCCESS);
+	keyboard_update_button(KEYBOARD_BUTTON_POWER, 0);
+
+	/* EC_CMD_MKBP_STATE only ever returns key state */
+	clear_state();
+	TEST_ASSERT(verify_key(1, 1, 1));
+	TEST_ASSERT(FIFO_NOT_EMPTY());
+	TEST_ASSERT(verify_key(-1, -1, -1));
+	TEST_ASSERT(FIFO_EMPTY());
+
+	return EC_SUCCESS;
+}
+
 void run_test(void)
 {
 	ec_int_level = 1;
@@ -215,6 +331,9 @@ void run_test(void)
 	RUN_TEST(test_fifo_size);
 	RUN_TEST(test_enable);
 	RUN_TEST(fifo_underrun);
+	RUN_TEST(test_batch_fetch);
+	RUN_TEST(test_typed_events);
+	RUN_TEST(test_legacy_skips_events);
 
 	test_print_result();
 }
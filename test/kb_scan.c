@@ -23,6 +23,7 @@
 #define KEYDOWN_DELAY_MS     10
 #define KEYDOWN_RETRY        10
 #define NO_KEYDOWN_DELAY_MS  100
+#define KEY_HOLD_MS          300
 
 #define CHECK_KEY_COUNT(old, expected) \
 	do { \
@@ -33,6 +34,7 @@
 
 static uint8_t mock_state[KEYBOARD_COLS];
 static int column_driven;
+static int scan_count;
 static int fifo_add_count;
 static int lid_open;
 #ifdef EMU_BUILD
@@ -49,6 +51,9 @@ int lid_is_open(void)
 
 void keyboard_raw_drive_column(int out)
 {
+	/* Each scan ends by releasing all columns */
+	if (out == KEYBOARD_COLUMN_NONE)
+		scan_count++;
 	column_driven = out;
 }
 
@@ -192,6 +197,79 @@ static int deghost_test(void)
 	return EC_SUCCESS;
 }
 
+/* Exported by keyboard_scan.c for test builds */
+int has_ghosting(const uint8_t *state);
+
+/* Pairwise check of every column, as a reference for has_ghosting() */
+static int full_ghost_check(const uint8_t *state)
+{
+	int c, c2;
+
+	for (c = 0; c < KEYBOARD_COLS; c++) {
+		for (c2 = c + 1; c2 < KEYBOARD_COLS; c2++) {
+			uint8_t common = state[c] & state[c2];
+
+			if (common & (common - 1))
+				return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int ghosting_bench(void)
+{
+	uint8_t state[KEYBOARD_COLS];
+	uint32_t seed = 1;
+	timestamp_t t0, t1, t2;
+	int ghosts = 0;
+	int i, c;
+	const int iteration = 20000;
+
+	/* Keep the scan task out of the way, as a closed lid would */
+	keyboard_scan_enable(0, KB_SCAN_DISABLE_LID_CLOSED);
+	msleep(30);
+
+	/* Random changes must agree with the full check */
+	memset(state, 0, sizeof(state));
+	for (i = 0; i < iteration; i++) {
+		/* Release everything now and then so not every state ghosts */
+		if (!(i & 15))
+			memset(state, 0, sizeof(state));
+		seed = seed * 1103515245 + 12345;
+		c = (seed >> 16) % KEYBOARD_COLS;
+		state[c] ^= 1 << ((seed >> 24) & 7);
+		ghosts += full_ghost_check(state);
+		TEST_ASSERT(has_ghosting(state) == full_ghost_check(state));
+	}
+	ccprintf("%d of %d random states ghosted\n", ghosts, iteration);
+
+	/*
+	 * Rollover: a key held in every column, one in a different row each,
+	 * while another key taps.  Only one column changes per scan.
+	 */
+	for (c = 0; c < KEYBOARD_COLS; c++)
+		state[c] = 1 << (c & 7);
+
+	t0 = get_time();
+	for (i = 0; i < iteration; i++) {
+		state[0] ^= 1 << 3;
+		has_ghosting(state);
+	}
+	t1 = get_time();
+	for (i = 0; i < iteration; i++) {
+		state[0] ^= 1 << 3;
+		full_ghost_check(state);
+	}
+	t2 = get_time();
+	ccprintf("Ghost check %d scans: incremental %d us, full %d us\n",
+		 iteration, (int)(t1.val - t0.val), (int)(t2.val - t1.val));
+
+	keyboard_scan_enable(1, KB_SCAN_DISABLE_LID_CLOSED);
+
+	return EC_SUCCESS;
+}
+
 static int debounce_test(void)
 {
 	int old_count = fifo_add_count;
@@ -252,6 +330,109 @@ static int debounce_test(void)
 	return EC_SUCCESS;
 }
 
+static int debounce_mixed_test(void)
+{
+	struct keyboard_scan_config *ksc = keyboard_scan_get_config();
+	uint16_t old_down = ksc->debounce_down_us;
+	uint16_t old_up = ksc->debounce_up_us;
+	int old_count;
+
+	mock_key(1, 1, 1);
+	TEST_ASSERT(expect_keychange() == EC_SUCCESS);
+
+	/* Release debounces well before press */
+	ksc->debounce_down_us = 60 * MSEC;
+	ksc->debounce_up_us = 5 * MSEC;
+
+	/* A release and a press in the same column, seen in the same scan */
+	old_count = fifo_add_count;
+	mock_key(1, 1, 0);
+	mock_key(2, 1, 1);
+	task_wake(TASK_ID_KEYSCAN);
+
+	/* The release mustn't wait for the press to finish debouncing */
+	msleep(30);
+	TEST_ASSERT(fifo_add_count == old_count + 1);
+	msleep(60);
+	TEST_ASSERT(fifo_add_count == old_count + 2);
+
+	ksc->debounce_down_us = old_down;
+	ksc->debounce_up_us = old_up;
+
+	mock_key(2, 1, 0);
+	TEST_ASSERT(expect_keychange() == EC_SUCCESS);
+
+	return EC_SUCCESS;
+}
+
+static int set_adaptive_scan(int enable)
+{
+	struct ec_params_mkbp_set_config params;
+
+	params.config.valid_mask = 0;
+	params.config.valid_flags = EC_MKBP_FLAGS_ADAPTIVE_SCAN;
+	params.config.flags = enable ? EC_MKBP_FLAGS_ADAPTIVE_SCAN : 0;
+
+	return test_send_host_command(EC_CMD_MKBP_SET_CONFIG, 0, &params,
+				      sizeof(params), NULL, 0);
+}
+
+static int get_adaptive_scan(void)
+{
+	struct ec_response_mkbp_get_config resp;
+
+	if (test_send_host_command(EC_CMD_MKBP_GET_CONFIG, 0, NULL, 0,
+				   &resp, sizeof(resp)) != EC_RES_SUCCESS)
+		return -1;
+
+	return !!(resp.config.flags & EC_MKBP_FLAGS_ADAPTIVE_SCAN);
+}
+
+static int count_scans_while_held(void)
+{
+	int count;
+
+	mock_key(1, 1, 1);
+	if (expect_keychange() != EC_SUCCESS)
+		return -1;
+
+	scan_count = 0;
+	msleep(KEY_HOLD_MS);
+	count = scan_count;
+
+	mock_key(1, 1, 0);
+	if (expect_keychange() != EC_SUCCESS)
+		return -1;
+
+	return count;
+}
+
+static int adaptive_scan_test(void)
+{
+	int fixed, adaptive;
+
+	TEST_ASSERT(get_adaptive_scan() == 0);
+	fixed = count_scans_while_held();
+	TEST_ASSERT(fixed > 0);
+
+	TEST_ASSERT(set_adaptive_scan(1) == EC_RES_SUCCESS);
+	TEST_ASSERT(get_adaptive_scan() == 1);
+	adaptive = count_scans_while_held();
+	TEST_ASSERT(adaptive > 0);
+	ccprintf("Scans while held: fixed %d, adaptive %d\n", fixed, adaptive);
+
+	/* Scans back off to the debounce time, so there are far fewer */
+	TEST_ASSERT(adaptive * 2 < fixed);
+
+	/* Debouncing still works */
+	TEST_ASSERT(debounce_test() == EC_SUCCESS);
+
+	TEST_ASSERT(set_adaptive_scan(0) == EC_RES_SUCCESS);
+	TEST_ASSERT(get_adaptive_scan() == 0);
+
+	return EC_SUCCESS;
+}
+
 static int simulate_key_test(void)
 {
 	int old_count;
@@ -382,7 +563,10 @@ static void run_test_step1(void)
 	test_reset();
 
 	RUN_TEST(deghost_test);
+	RUN_TEST(ghosting_bench);
 	RUN_TEST(debounce_test);
+	RUN_TEST(debounce_mixed_test);
+	RUN_TEST(adaptive_scan_test);
 	RUN_TEST(simulate_key_test);
 #ifdef EMU_BUILD
 	RUN_TEST(runtime_key_test);
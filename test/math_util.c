@@ -10,44 +10,42 @@
 #include "math_util.h"
 #include "motion_sense.h"
 #include "test_util.h"
+#include "timer.h"
+#include "util.h"
 
 /*****************************************************************************/
 /* Mock functions */
 
-/* Need to define accelerometer functions just to compile. */
-int accel_init(enum accel_id id)
+/* Need to define an accelerometer driver just to compile. */
+static int accel_init(const struct motion_sensor_t *s)
 {
 	return EC_SUCCESS;
 }
-int accel_read(enum accel_id id, int *x_acc, int *y_acc, int *z_acc)
+static int accel_read(const struct motion_sensor_t *s, int *x_acc,
+		      int *y_acc, int *z_acc)
 {
 	return EC_SUCCESS;
 }
-int accel_set_range(const enum accel_id id, const int range, const int rnd)
+static int accel_set(const struct motion_sensor_t *s, int data, int rnd)
 {
 	return EC_SUCCESS;
 }
-int accel_get_range(const enum accel_id id, int * const range)
-{
-	return EC_SUCCESS;
-}
-int accel_set_resolution(const enum accel_id id, const int res, const int rnd)
-{
-	return EC_SUCCESS;
-}
-int accel_get_resolution(const enum accel_id id, int * const res)
-{
-	return EC_SUCCESS;
-}
-int accel_set_datarate(const enum accel_id id, const int rate, const int rnd)
-{
-	return EC_SUCCESS;
-}
-int accel_get_datarate(const enum accel_id id, int * const rate)
+static int accel_get(const struct motion_sensor_t *s, int *data)
 {
 	return EC_SUCCESS;
 }
 
+const struct accelgyro_drv test_motion_sense = {
+	.init = accel_init,
+	.read = accel_read,
+	.set_range = accel_set,
+	.get_range = accel_get,
+	.set_resolution = accel_set,
+	.get_resolution = accel_get,
+	.set_data_rate = accel_set,
+	.get_data_rate = accel_get,
+};
+
 /*****************************************************************************/
 /* Test utilities */
 
@@ -57,6 +55,75 @@ int accel_get_datarate(const enum accel_id id, int * const rate)
 #define ACOS_TOLERANCE_DEG 0.5f
 #define RAD_TO_DEG (180.0f / 3.1415926f)
 
+/* Float copies of the original algorithms, used as accuracy references. */
+static const float ref_cos_lut[] = {
+	 1.00000,  0.99619,  0.98481,  0.96593,  0.93969,  0.90631,  0.86603,
+	 0.81915,  0.76604,  0.70711,  0.64279,  0.57358,  0.50000,  0.42262,
+	 0.34202,  0.25882,  0.17365,  0.08716,  0.00000, -0.08716, -0.17365,
+	-0.25882, -0.34202, -0.42262, -0.50000, -0.57358, -0.64279, -0.70711,
+	-0.76604, -0.81915, -0.86603, -0.90631, -0.93969, -0.96593, -0.98481,
+	-0.99619, -1.00000,
+};
+
+static float ref_arc_cos(float x)
+{
+	int i;
+
+	if (x < -1.0f)
+		x = -1.0f;
+	else if (x > 1.0f)
+		x = 1.0f;
+
+	for (i = 0; i < ARRAY_SIZE(ref_cos_lut) - 1; i++) {
+		if (x >= ref_cos_lut[i + 1])
+			return 5 * i + 5 * (ref_cos_lut[i] - x) /
+				(ref_cos_lut[i] - ref_cos_lut[i + 1]);
+	}
+
+	return 180.0f;
+}
+
+static float ref_cosine_of_angle_diff(const vector_3_t v1,
+				      const vector_3_t v2)
+{
+	int dotproduct;
+	float denominator;
+
+	dotproduct = v1[0] * v2[0] + v1[1] * v2[1] + v1[2] * v2[2];
+	denominator = sqrtf(SQ(v1[0]) + SQ(v1[1]) + SQ(v1[2])) *
+		      sqrtf(SQ(v2[0]) + SQ(v2[1]) + SQ(v2[2]));
+
+	if (denominator == 0.0f)
+		return 0.0f;
+
+	return (float)dotproduct / denominator;
+}
+
+static void ref_rotate(const vector_3_t v, const float R[3][3],
+		       float res[3])
+{
+	int i;
+
+	for (i = 0; i < 3; i++)
+		res[i] = v[0] * R[0][i] + v[1] * R[1][i] + v[2] * R[2][i];
+}
+
+/* Simple deterministic generator for accelerometer-sized test vectors. */
+static uint32_t seed = 0x12345678;
+
+static int rand_axis(void)
+{
+	seed = seed * 1664525 + 1013904223;
+	return (int)(seed >> 16) % 2048 - 1024;
+}
+
+static void rand_vector(vector_3_t v)
+{
+	v[0] = rand_axis();
+	v[1] = rand_axis();
+	v[2] = rand_axis();
+}
+
 static int test_acos(void)
 {
 	float a, b;
@@ -64,20 +131,136 @@ static int test_acos(void)
 
 	/* Test a handful of values. */
 	for (test = -1.0; test <= 1.0; test += 0.01) {
-		a = arc_cos(test);
+		a = FP_TO_FLOAT(arc_cos(FLOAT_TO_FP(test)));
 		b = acos(test) * RAD_TO_DEG;
 		TEST_ASSERT(IS_FLOAT_EQUAL(a, b, ACOS_TOLERANCE_DEG));
 	}
 
+	/* Out of range inputs are capped. */
+	TEST_ASSERT(FP_TO_INT(arc_cos(FLOAT_TO_FP(1.5))) == 0);
+	TEST_ASSERT(FP_TO_INT(arc_cos(FLOAT_TO_FP(-1.5))) == 180);
+
+	return EC_SUCCESS;
+}
+
+static int test_int_sqrt(void)
+{
+	uint64_t x;
+	uint32_t r;
+	int i;
+
+	TEST_ASSERT(int_sqrt(0) == 0);
+	TEST_ASSERT(int_sqrt(1) == 1);
+	TEST_ASSERT(int_sqrt(15) == 3);
+	TEST_ASSERT(int_sqrt(16) == 4);
+	TEST_ASSERT(int_sqrt(0xffffffffffffffffULL) == 0xffffffff);
+
+	/* Result is always floor(sqrt(x)). */
+	for (i = 0; i < 1000; i++) {
+		x = ((uint64_t)rand_axis() << 40) ^ ((uint64_t)seed << 8);
+		r = int_sqrt(x);
+		TEST_ASSERT((uint64_t)r * r <= x);
+		TEST_ASSERT(((uint64_t)r + 1) * (r + 1) > x);
+	}
+
+	return EC_SUCCESS;
+}
+
+#define COSINE_TOLERANCE 0.0001f
+
+static int test_cosine_of_angle_diff(void)
+{
+	vector_3_t v1, v2;
+	vector_3_t zero = {0, 0, 0};
+	float a, b;
+	int i;
+
+	for (i = 0; i < 1000; i++) {
+		rand_vector(v1);
+		rand_vector(v2);
+		a = FP_TO_FLOAT(cosine_of_angle_diff(v1, v2));
+		b = ref_cosine_of_angle_diff(v1, v2);
+		TEST_ASSERT(IS_FLOAT_EQUAL(a, b, COSINE_TOLERANCE));
+	}
+
+	TEST_ASSERT(cosine_of_angle_diff(v1, zero) == 0);
+
 	return EC_SUCCESS;
 }
 
+static int test_rotate(void)
+{
+	vector_3_t v, res;
+	matrix_3x3_t R;
+	float ref_R[3][3];
+	float ref_res[3];
+	int i, j, k;
+
+	for (i = 0; i < 100; i++) {
+		for (j = 0; j < 3; j++)
+			for (k = 0; k < 3; k++) {
+				ref_R[j][k] = rand_axis() / 1024.0f;
+				R[j][k] = FLOAT_TO_FP(ref_R[j][k]);
+			}
+		rand_vector(v);
+
+		rotate(v, &R, &res);
+		ref_rotate(v, ref_R, ref_res);
+
+		/* Within one count, allowing for truncation of the result. */
+		for (j = 0; j < 3; j++)
+			TEST_ASSERT(IS_FLOAT_EQUAL(res[j], ref_res[j], 1.5f));
+
+		/* Rotating in place gives the same answer. */
+		rotate(v, &R, &v);
+		for (j = 0; j < 3; j++)
+			TEST_ASSERT(v[j] == res[j]);
+	}
+
+	return EC_SUCCESS;
+}
+
+#define BENCHMARK_LOOPS 100000
+
+static int test_benchmark(void)
+{
+	vector_3_t v1 = {100, -900, 250}, v2 = {-30, 800, 600};
+	volatile float ref_sink;
+	volatile fp_t sink;
+	timestamp_t t0, t1, t2;
+	int i;
+
+	/*
+	 * Informational only: on host the float reference runs on hardware
+	 * floating point, so this shows the cost of the fixed-point path
+	 * rather than the saving on a part without an FPU.
+	 */
+	t0 = get_time();
+	for (i = 0; i < BENCHMARK_LOOPS; i++)
+		ref_sink = ref_arc_cos(ref_cosine_of_angle_diff(v1, v2));
+	t1 = get_time();
+	for (i = 0; i < BENCHMARK_LOOPS; i++)
+		sink = arc_cos(cosine_of_angle_diff(v1, v2));
+	t2 = get_time();
+
+	ccprintf("acos(cosine) x %d: reference %ld us, math_util %ld us\n",
+		 BENCHMARK_LOOPS, t1.val - t0.val, t2.val - t1.val);
+
+	TEST_ASSERT(IS_FLOAT_EQUAL(FP_TO_FLOAT(sink), ref_sink,
+				   ACOS_TOLERANCE_DEG));
+
+	return EC_SUCCESS;
+}
 
 void run_test(void)
 {
 	test_reset();
 
 	RUN_TEST(test_acos);
+	RUN_TEST(test_int_sqrt);
+	RUN_TEST(test_cosine_of_angle_diff);
+	RUN_TEST(test_rotate);
+	RUN_TEST(test_benchmark);
 
 	test_print_result();
 }
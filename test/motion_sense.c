@@ -8,57 +8,108 @@
 #include <math.h>
 
 #include "common.h"
+#include "ec_commands.h"
+#include "host_command.h"
 #include "motion_sense.h"
 #include "task.h"
 #include "test_util.h"
 #include "timer.h"
+#include "util.h"
 
 /* Mock acceleration values for motion sense task to read in. */
-int mock_x_acc[ACCEL_COUNT], mock_y_acc[ACCEL_COUNT], mock_z_acc[ACCEL_COUNT];
+int mock_x_acc[MOTION_SENSOR_COUNT], mock_y_acc[MOTION_SENSOR_COUNT],
+	mock_z_acc[MOTION_SENSOR_COUNT];
+
+/* Number of times each sensor has been read. */
+static int mock_reads[MOTION_SENSOR_COUNT];
+
+/* Watermark each sensor's mock hardware FIFO was set up with. */
+static int mock_watermark[MOTION_SENSOR_COUNT];
+
+/* Samples waiting in each sensor's mock hardware FIFO. */
+static int mock_fifo_count[MOTION_SENSOR_COUNT];
 
 /*****************************************************************************/
 /* Mock functions */
 
-int accel_init(enum accel_id id)
+static int accel_init(const struct motion_sensor_t *s)
 {
 	return EC_SUCCESS;
 }
 
-int accel_read(enum accel_id id, int *x_acc, int *y_acc, int *z_acc)
+static int accel_read(const struct motion_sensor_t *s, int *x_acc,
+		      int *y_acc, int *z_acc)
 {
+	int id = s - motion_sensors;
+
 	/* Return the mock values. */
 	*x_acc = mock_x_acc[id];
 	*y_acc = mock_y_acc[id];
 	*z_acc = mock_z_acc[id];
+	mock_reads[id]++;
 
 	return EC_SUCCESS;
 }
 
-int accel_set_range(const enum accel_id id, const int range, const int rnd)
-{
-	return EC_SUCCESS;
-}
-int accel_get_range(const enum accel_id id, int * const range)
+static int accel_set(const struct motion_sensor_t *s, int data, int rnd)
 {
 	return EC_SUCCESS;
 }
-int accel_set_resolution(const enum accel_id id, const int res, const int rnd)
+
+static int accel_get(const struct motion_sensor_t *s, int *data)
 {
 	return EC_SUCCESS;
 }
-int accel_get_resolution(const enum accel_id id, int * const res)
+
+static int accel_get_data_rate(const struct motion_sensor_t *s, int *rate)
 {
+	*rate = 100000;
 	return EC_SUCCESS;
 }
-int accel_set_datarate(const enum accel_id id, const int rate, const int rnd)
+
+static int accel_set_fifo_watermark(const struct motion_sensor_t *s,
+				    int watermark)
 {
+	mock_watermark[s - motion_sensors] = watermark;
 	return EC_SUCCESS;
 }
-int accel_get_datarate(const enum accel_id id, int * const rate)
+
+static int accel_read_fifo(const struct motion_sensor_t *s, vector_3_t *v,
+			   int max, int *count)
 {
+	int id = s - motion_sensors;
+	int i, n;
+
+	/*
+	 * Return the queued samples, whose X counts up to the mock value, or
+	 * just the mock values if nothing is queued.
+	 */
+	n = MIN(MAX(mock_fifo_count[id], 1), max);
+	for (i = 0; i < n; i++) {
+		v[i][0] = mock_x_acc[id] - (n - 1 - i);
+		v[i][1] = mock_y_acc[id];
+		v[i][2] = mock_z_acc[id];
+	}
+	mock_fifo_count[id] = 0;
+	mock_reads[id]++;
+
+	*count = n;
 	return EC_SUCCESS;
 }
 
+const struct accelgyro_drv test_motion_sense = {
+	.init = accel_init,
+	.read = accel_read,
+	.set_range = accel_set,
+	.get_range = accel_get,
+	.set_resolution = accel_set,
+	.get_resolution = accel_get,
+	.set_data_rate = accel_set,
+	.get_data_rate = accel_get_data_rate,
+	.set_fifo_watermark = accel_set_fifo_watermark,
+	.read_fifo = accel_read_fifo,
+};
+
 
 /*****************************************************************************/
 /* Test utilities */
@@ -122,12 +173,282 @@ static int test_lid_angle(void)
 	return EC_SUCCESS;
 }
 
+static void set_lid_and_sample(int x, int y, int z, int samples)
+{
+	mock_x_acc[ACCEL_LID] = x;
+	mock_y_acc[ACCEL_LID] = y;
+	mock_z_acc[ACCEL_LID] = z;
+	while (samples--) {
+		task_wake(TASK_ID_MOTIONSENSE);
+		msleep(5);
+	}
+}
+
+static int test_lid_angle_filter(void)
+{
+	int angle;
+
+	/* Base flat on a desk, lid settled at 90 degrees. */
+	mock_x_acc[ACCEL_BASE] = 0;
+	mock_y_acc[ACCEL_BASE] = 0;
+	mock_z_acc[ACCEL_BASE] = 1000;
+	set_lid_and_sample(-1000, 0, 0, 3);
+	TEST_ASSERT(motion_get_lid_angle() == 90);
+
+	/* A small change, to 100 degrees, is smoothed... */
+	set_lid_and_sample(-985, 0, -174, 1);
+	angle = motion_get_lid_angle();
+	TEST_ASSERT(angle > 90 && angle < 100);
+
+	/* ...and settles. */
+	set_lid_and_sample(-985, 0, -174, 20);
+	TEST_ASSERT(motion_get_lid_angle() == 100);
+
+	/* A large change is followed at once. */
+	set_lid_and_sample(0, 0, 1000, 1);
+	TEST_ASSERT(motion_get_lid_angle() == 0);
+
+	/* Smoothing takes the short way round, from 0 to 350 degrees. */
+	set_lid_and_sample(174, 0, 985, 1);
+	angle = motion_get_lid_angle();
+	TEST_ASSERT(angle > 350 && angle < 360);
+
+	return EC_SUCCESS;
+}
+
+static int fifo_info(int watermark, struct ec_response_motion_sense *r)
+{
+	struct ec_params_motion_sense p;
+
+	p.cmd = MOTIONSENSE_CMD_FIFO_INFO;
+	p.fifo_info.watermark = watermark;
+	return test_send_host_command(EC_CMD_MOTION_SENSE_CMD, 0, &p,
+				      sizeof(p), r, sizeof(*r));
+}
+
+static int fifo_read(int max, uint8_t *buf, int size)
+{
+	struct ec_params_motion_sense p;
+	struct ec_response_motion_sense *r = (void *)buf;
+
+	p.cmd = MOTIONSENSE_CMD_FIFO_READ;
+	p.fifo_read.max_samples = max;
+	if (test_send_host_command(EC_CMD_MOTION_SENSE_CMD, 0, &p,
+				   sizeof(p), buf, size) != EC_RES_SUCCESS)
+		return -1;
+	return r->fifo_read.count;
+}
+
+static int test_fifo(void)
+{
+	uint8_t buf[sizeof(struct ec_response_motion_sense) +
+		    8 * sizeof(struct ec_response_motion_sensor_data)];
+	struct ec_response_motion_sense *r = (void *)buf;
+	struct ec_response_motion_sensor_data *d = r->fifo_read.data;
+	struct ec_params_motion_sense p;
+	uint32_t events;
+	int i;
+
+	mock_x_acc[ACCEL_BASE] = 0;
+	mock_y_acc[ACCEL_BASE] = 0;
+	mock_z_acc[ACCEL_BASE] = 1000;
+
+	/* Slow the task down so it only runs when woken */
+	p.cmd = MOTIONSENSE_CMD_EC_RATE;
+	p.ec_rate.data = 1000;
+	TEST_ASSERT(test_send_host_command(EC_CMD_MOTION_SENSE_CMD, 0, &p,
+					   sizeof(p), r, sizeof(*r)) ==
+		    EC_RES_SUCCESS);
+	task_wake(TASK_ID_MOTIONSENSE);
+	msleep(5);
+
+	/* Drain whatever the task has queued so far */
+	while (fifo_read(8, buf, sizeof(buf)) > 0)
+		;
+	TEST_ASSERT(fifo_info(EC_MOTION_SENSE_NO_VALUE, r) == EC_RES_SUCCESS);
+	TEST_ASSERT(r->fifo_info.size == 8);
+	TEST_ASSERT(r->fifo_info.count == 0);
+
+	/* Watermark must be in range */
+	TEST_ASSERT(fifo_info(0, r) == EC_RES_INVALID_PARAM);
+	TEST_ASSERT(fifo_info(9, r) == EC_RES_INVALID_PARAM);
+	TEST_ASSERT(fifo_info(4, r) == EC_RES_SUCCESS);
+	TEST_ASSERT(r->fifo_info.watermark == 4);
+
+	/* Each pass queues a base, a lid and a gyro sample */
+	host_clear_events(0xffffffff);
+	task_wake(TASK_ID_MOTIONSENSE);
+	msleep(5);
+	events = host_get_events();
+	TEST_ASSERT(!(events &
+		      EC_HOST_EVENT_MASK(EC_HOST_EVENT_MOTION_SENSE_FIFO)));
+	task_wake(TASK_ID_MOTIONSENSE);
+	msleep(5);
+	events = host_get_events();
+	TEST_ASSERT(events &
+		    EC_HOST_EVENT_MASK(EC_HOST_EVENT_MOTION_SENSE_FIFO));
+
+	/* Only as many samples as asked for come back, oldest first */
+	TEST_ASSERT(fifo_read(4, buf, sizeof(buf)) == 4);
+	TEST_ASSERT(d[0].sensor_num == EC_MOTION_SENSOR_ACCEL_BASE);
+	TEST_ASSERT(d[1].sensor_num == EC_MOTION_SENSOR_ACCEL_LID);
+	TEST_ASSERT(d[2].sensor_num == EC_MOTION_SENSOR_GYRO);
+	TEST_ASSERT(d[3].sensor_num == EC_MOTION_SENSOR_ACCEL_BASE);
+	TEST_ASSERT(d[0].timestamp == d[1].timestamp);
+	TEST_ASSERT(d[0].timestamp == d[2].timestamp);
+	TEST_ASSERT(d[3].timestamp > d[0].timestamp);
+	TEST_ASSERT(d[0].data[2] != 0);
+	TEST_ASSERT(fifo_read(8, buf, sizeof(buf)) == 2);
+
+	/* Overflow drops the oldest samples and counts them */
+	for (i = 0; i < 5; i++) {
+		task_wake(TASK_ID_MOTIONSENSE);
+		msleep(5);
+	}
+	TEST_ASSERT(fifo_info(EC_MOTION_SENSE_NO_VALUE, r) == EC_RES_SUCCESS);
+	TEST_ASSERT(r->fifo_info.count == 8);
+	TEST_ASSERT(r->fifo_info.lost == 7);
+	TEST_ASSERT(fifo_read(8, buf, sizeof(buf)) == 8);
+	for (i = 1; i < 8; i++)
+		TEST_ASSERT(d[i].timestamp >= d[i - 1].timestamp);
+
+	return EC_SUCCESS;
+}
+
+static int test_sensor_table(void)
+{
+	struct ec_params_motion_sense p;
+	struct ec_response_motion_sense r;
+
+	p.cmd = MOTIONSENSE_CMD_INFO;
+	p.info.sensor_num = EC_MOTION_SENSOR_GYRO;
+	TEST_ASSERT(test_send_host_command(EC_CMD_MOTION_SENSE_CMD, 0, &p,
+					   sizeof(p), &r, sizeof(r)) ==
+		    EC_RES_SUCCESS);
+	TEST_ASSERT(r.info.type == MOTIONSENSE_TYPE_GYRO);
+	TEST_ASSERT(r.info.location == MOTIONSENSE_LOC_BASE);
+	TEST_ASSERT(r.info.chip == MOTIONSENSE_CHIP_LSM6DS0);
+
+	mock_x_acc[GYRO_BASE] = 12;
+	mock_y_acc[GYRO_BASE] = 34;
+	mock_z_acc[GYRO_BASE] = 56;
+	task_wake(TASK_ID_MOTIONSENSE);
+	msleep(5);
+
+	p.cmd = MOTIONSENSE_CMD_DUMP;
+	TEST_ASSERT(test_send_host_command(EC_CMD_MOTION_SENSE_CMD, 0, &p,
+					   sizeof(p), &r, sizeof(r)) ==
+		    EC_RES_SUCCESS);
+	TEST_ASSERT(r.dump.sensor_flags[EC_MOTION_SENSOR_GYRO] ==
+		    MOTIONSENSE_SENSOR_FLAG_PRESENT);
+	TEST_ASSERT(r.dump.data[3 * EC_MOTION_SENSOR_GYRO] == 12);
+	TEST_ASSERT(r.dump.data[3 * EC_MOTION_SENSOR_GYRO + 1] == 34);
+	TEST_ASSERT(r.dump.data[3 * EC_MOTION_SENSOR_GYRO + 2] == 56);
+
+	return EC_SUCCESS;
+}
+
+static int test_sensor_rates(void)
+{
+	struct ec_params_motion_sense p;
+	struct ec_response_motion_sense r;
+	int reads[MOTION_SENSOR_COUNT];
+	int n;
+
+	/* Accelerometers follow the module rate, the gyro its own */
+	p.cmd = MOTIONSENSE_CMD_EC_RATE;
+	p.ec_rate.data = 1000;
+	TEST_ASSERT(test_send_host_command(EC_CMD_MOTION_SENSE_CMD, 0, &p,
+					   sizeof(p), &r, sizeof(r)) ==
+		    EC_RES_SUCCESS);
+	motion_sensors[GYRO_BASE].poll_ms = 10;
+	task_wake(TASK_ID_MOTIONSENSE);
+	msleep(5);
+
+	memcpy(reads, mock_reads, sizeof(reads));
+	msleep(100);
+	TEST_ASSERT(mock_reads[ACCEL_BASE] == reads[ACCEL_BASE]);
+	TEST_ASSERT(mock_reads[ACCEL_LID] == reads[ACCEL_LID]);
+	n = mock_reads[GYRO_BASE] - reads[GYRO_BASE];
+	TEST_ASSERT(n >= 5 && n <= 11);
+
+	/* A wake still reads every sensor */
+	memcpy(reads, mock_reads, sizeof(reads));
+	task_wake(TASK_ID_MOTIONSENSE);
+	msleep(5);
+	TEST_ASSERT(mock_reads[ACCEL_BASE] == reads[ACCEL_BASE] + 1);
+	TEST_ASSERT(mock_reads[ACCEL_LID] == reads[ACCEL_LID] + 1);
+
+	motion_sensors[GYRO_BASE].poll_ms = 0;
+
+	return EC_SUCCESS;
+}
+
+static int test_hw_fifo(void)
+{
+	uint8_t buf[sizeof(struct ec_response_motion_sense) +
+		    8 * sizeof(struct ec_response_motion_sensor_data)];
+	struct ec_response_motion_sense *r = (void *)buf;
+	struct ec_response_motion_sensor_data *d = r->fifo_read.data;
+	struct ec_params_motion_sense p;
+	int reads[MOTION_SENSOR_COUNT];
+	int i;
+
+	/* Only the lid accelerometer uses its hardware FIFO */
+	TEST_ASSERT(mock_watermark[ACCEL_BASE] == 0);
+	TEST_ASSERT(mock_watermark[ACCEL_LID] == 4);
+	TEST_ASSERT(mock_watermark[GYRO_BASE] == 0);
+
+	/* Run the task only on wakes and interrupts, and start empty */
+	p.cmd = MOTIONSENSE_CMD_EC_RATE;
+	p.ec_rate.data = 1000;
+	TEST_ASSERT(test_send_host_command(EC_CMD_MOTION_SENSE_CMD, 0, &p,
+					   sizeof(p), r, sizeof(*r)) ==
+		    EC_RES_SUCCESS);
+	task_wake(TASK_ID_MOTIONSENSE);
+	msleep(5);
+	while (fifo_read(8, buf, sizeof(buf)) > 0)
+		;
+
+	/* The watermark interrupt drains all five samples in one read */
+	mock_x_acc[ACCEL_LID] = 100;
+	mock_fifo_count[ACCEL_LID] = 5;
+	memcpy(reads, mock_reads, sizeof(reads));
+	accel_int_lid(GPIO_ACCEL_INT_LID);
+	msleep(5);
+	TEST_ASSERT(mock_reads[ACCEL_BASE] == reads[ACCEL_BASE]);
+	TEST_ASSERT(mock_reads[ACCEL_LID] == reads[ACCEL_LID] + 1);
+	TEST_ASSERT(mock_reads[GYRO_BASE] == reads[GYRO_BASE]);
+
+	/* They reach the host oldest first, one 100 Hz period apart */
+	TEST_ASSERT(fifo_read(8, buf, sizeof(buf)) == 5);
+	for (i = 0; i < 5; i++) {
+		TEST_ASSERT(d[i].sensor_num == EC_MOTION_SENSOR_ACCEL_LID);
+		TEST_ASSERT(d[i].data[0] == 96 + i);
+	}
+	for (i = 1; i < 5; i++)
+		TEST_ASSERT(d[i].timestamp - d[i - 1].timestamp == 10000);
+
+	/* An interrupt on a line no FIFO uses reads nothing */
+	memcpy(reads, mock_reads, sizeof(reads));
+	accel_int_base(GPIO_EC_INT);
+	msleep(5);
+	TEST_ASSERT(mock_reads[ACCEL_LID] == reads[ACCEL_LID]);
+	TEST_ASSERT(fifo_read(8, buf, sizeof(buf)) == 0);
+
+	return EC_SUCCESS;
+}
 
 void run_test(void)
 {
 	test_reset();
 
 	RUN_TEST(test_lid_angle);
+	RUN_TEST(test_lid_angle_filter);
+	RUN_TEST(test_fifo);
+	RUN_TEST(test_sensor_table);
+	RUN_TEST(test_sensor_rates);
+	RUN_TEST(test_hw_fifo);
 
 	test_print_result();
 }
@@ -152,6 +152,50 @@ static int test_queue5_odd_even(void)
 	return EC_SUCCESS;
 }
 
+static int test_queue6_bulk(void)
+{
+	char buf1[5] = {1, 2, 3, 4, 5};
+	char buf2[5];
+
+	queue_reset(&test_queue6);
+	queue_add_units(&test_queue6, buf1, 4);
+	TEST_ASSERT(queue_count(&test_queue6) == 4);
+	TEST_ASSERT(queue_remove_units(&test_queue6, buf2, 3) == 3);
+	TEST_ASSERT_ARRAY_EQ(buf1, buf2, 3);
+	/* 4 */
+	queue_add_units(&test_queue6, buf1, 4);
+	/* 4, 1, 2, 3, 4; wraps around the end of the buffer */
+	TEST_ASSERT(queue_count(&test_queue6) == 5);
+	TEST_ASSERT(queue_peek_units(&test_queue6, buf2, 1, 5) == 4);
+	TEST_ASSERT_ARRAY_EQ(buf1, buf2, 4);
+	TEST_ASSERT(queue_peek_units(&test_queue6, buf2, 5, 1) == 0);
+	TEST_ASSERT(queue_count(&test_queue6) == 5);
+	TEST_ASSERT(queue_remove_units(&test_queue6, buf2, 5) == 5);
+	TEST_ASSERT(buf2[0] == 4);
+	TEST_ASSERT_ARRAY_EQ(buf1, buf2 + 1, 4);
+	TEST_ASSERT(queue_is_empty(&test_queue6));
+	TEST_ASSERT(queue_remove_units(&test_queue6, buf2, 5) == 0);
+
+	return EC_SUCCESS;
+}
+
+static int test_queue5_bulk(void)
+{
+	uint16_t buf1[2] = {0x0102, 0x0304};
+	uint16_t buf2[2];
+
+	queue_reset(&test_queue5);
+	queue_add_units(&test_queue5, buf1, 1);
+	LOOP_DEQUE(test_queue5, buf2, 1);
+	/* Second unit is split across the end of the buffer */
+	queue_add_units(&test_queue5, buf1, 2);
+	TEST_ASSERT(queue_count(&test_queue5) == 2);
+	TEST_ASSERT(queue_remove_units(&test_queue5, buf2, 2) == 2);
+	TEST_ASSERT_ARRAY_EQ(buf1, buf2, 2);
+
+	return EC_SUCCESS;
+}
+
 void run_test(void)
 {
 	test_reset();
@@ -162,6 +206,8 @@ void run_test(void)
 	RUN_TEST(test_queue6_multiple_units_add);
 	RUN_TEST(test_queue6_removal);
 	RUN_TEST(test_queue5_odd_even);
+	RUN_TEST(test_queue6_bulk);
+	RUN_TEST(test_queue5_bulk);
 
 	test_print_result();
 }
@@ -0,0 +1,189 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Test staggered temperature sensor polling.
+ */
+
+#include "common.h"
+#include "console.h"
+#include "hooks.h"
+#include "temp_sensor.h"
+#include "test_util.h"
+#include "thermal.h"
+#include "timer.h"
+#include "util.h"
+
+/*****************************************************************************/
+/* Exported data */
+
+struct ec_thermal_config thermal_params[TEMP_SENSOR_COUNT];
+
+/*****************************************************************************/
+/* Mock functions */
+
+static int mock_temp[TEMP_SENSOR_COUNT];
+static int read_count[TEMP_SENSOR_COUNT];
+static uint64_t read_time[TEMP_SENSOR_COUNT];
+static int no_temps_read;
+
+int dummy_temp_get_val(int idx, int *temp_ptr)
+{
+	read_count[idx]++;
+	read_time[idx] = get_time().val;
+
+	if (mock_temp[idx] >= 0) {
+		*temp_ptr = mock_temp[idx];
+		return EC_SUCCESS;
+	}
+
+	return EC_ERROR_NOT_POWERED;
+}
+
+void chipset_force_shutdown(void)
+{
+}
+
+void chipset_throttle_cpu(int throttled)
+{
+}
+
+void host_throttle_cpu(int throttled)
+{
+}
+
+void smi_sensor_failure_warning(void)
+{
+	no_temps_read = 1;
+}
+
+/*****************************************************************************/
+/* Test utilities */
+
+/* Wait until the poller has just read a sensor */
+static void wait_for_read(int id)
+{
+	int count = read_count[id];
+
+	while (read_count[id] == count)
+		msleep(1);
+}
+
+/*****************************************************************************/
+/* Tests */
+
+static int test_staggered(void)
+{
+	uint64_t first[TEMP_SENSOR_COUNT];
+	int i, j;
+
+	/* Each sensor gets its own tick, so start just after one of them */
+	wait_for_read(0);
+	memset(read_count, 0, sizeof(read_count));
+	usleep(SECOND + HOOK_TICK_INTERVAL / 2);
+
+	/* Every sensor is read once a second... */
+	for (i = 0; i < TEMP_SENSOR_COUNT; i++) {
+		TEST_ASSERT(read_count[i] == 1);
+		first[i] = read_time[i];
+	}
+
+	usleep(SECOND);
+	for (i = 0; i < TEMP_SENSOR_COUNT; i++) {
+		TEST_ASSERT(read_count[i] == 2);
+		TEST_ASSERT(read_time[i] - first[i] > SECOND - 50 * MSEC);
+		TEST_ASSERT(read_time[i] - first[i] < SECOND + 50 * MSEC);
+	}
+
+	/* ...and no two sensors are read in the same hook tick */
+	for (i = 0; i < TEMP_SENSOR_COUNT; i++)
+		for (j = i + 1; j < TEMP_SENSOR_COUNT; j++) {
+			int64_t apart = read_time[i] - read_time[j];
+
+			TEST_ASSERT(apart > HOOK_TICK_INTERVAL / 2 ||
+				    apart < -HOOK_TICK_INTERVAL / 2);
+		}
+
+	return EC_SUCCESS;
+}
+
+static int test_cached(void)
+{
+	int count, t;
+
+	mock_temp[0] = 300;
+	wait_for_read(0);
+
+	/* Reading the temperature doesn't touch the sensor */
+	count = read_count[0];
+	TEST_ASSERT(temp_sensor_read(0, &t) == EC_SUCCESS);
+	TEST_ASSERT(t == 300);
+	TEST_ASSERT(read_count[0] == count);
+
+	/* A new temperature shows up on the next poll */
+	mock_temp[0] = 310;
+	TEST_ASSERT(temp_sensor_read(0, &t) == EC_SUCCESS);
+	TEST_ASSERT(t == 300);
+	wait_for_read(0);
+	TEST_ASSERT(temp_sensor_read(0, &t) == EC_SUCCESS);
+	TEST_ASSERT(t == 310);
+
+	/* Errors are cached too */
+	mock_temp[0] = -1;
+	wait_for_read(0);
+	TEST_ASSERT(temp_sensor_read(0, &t) == EC_ERROR_NOT_POWERED);
+	mock_temp[0] = 300;
+
+	return EC_SUCCESS;
+}
+
+static int test_age(void)
+{
+	uint32_t age;
+	int t;
+
+	wait_for_read(1);
+	TEST_ASSERT(temp_sensor_read_age(1, &t, &age) == EC_SUCCESS);
+	TEST_ASSERT(age < 10 * MSEC);
+
+	/* The reading gets older until the sensor's next turn */
+	usleep(HOOK_TICK_INTERVAL * 2);
+	TEST_ASSERT(temp_sensor_read_age(1, &t, &age) == EC_SUCCESS);
+	TEST_ASSERT(age >= HOOK_TICK_INTERVAL * 2);
+	TEST_ASSERT(age <= get_time().val - read_time[1]);
+
+	TEST_ASSERT(temp_sensor_read_age(TEMP_SENSOR_COUNT, &t, &age) ==
+		    EC_ERROR_INVAL);
+
+	return EC_SUCCESS;
+}
+
+static int test_thermal_uses_cache(void)
+{
+	int i;
+
+	/* Thermal control sees the readings without reading sensors itself */
+	for (i = 0; i < TEMP_SENSOR_COUNT; i++)
+		mock_temp[i] = 300;
+	sleep(2);
+	no_temps_read = 0;
+	wait_for_read(0);
+	memset(read_count, 0, sizeof(read_count));
+	usleep(SECOND + HOOK_TICK_INTERVAL / 2);
+
+	TEST_ASSERT(no_temps_read == 0);
+	for (i = 0; i < TEMP_SENSOR_COUNT; i++)
+		TEST_ASSERT(read_count[i] == 1);
+
+	return EC_SUCCESS;
+}
+
+void run_test(void)
+{
+	RUN_TEST(test_staggered);
+	RUN_TEST(test_cached);
+	RUN_TEST(test_age);
+	RUN_TEST(test_thermal_uses_cache);
+
+	test_print_result();
+}
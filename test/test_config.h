@@ -28,6 +28,10 @@
 #define CONFIG_BACKLIGHT_REQ_GPIO GPIO_PCH_BKLTEN
 #endif
 
+#ifdef TEST_FLASH_WRITE_COMBINE
+#define CONFIG_FLASH_WRITE_COMBINE
+#endif
+
 #ifdef TEST_KB_8042
 #define CONFIG_KEYBOARD_PROTOCOL_8042
 #endif
@@ -36,6 +40,11 @@
 #define CONFIG_KEYBOARD_PROTOCOL_MKBP
 #endif
 
+#ifdef TEST_KB_LATENCY
+#define CONFIG_KEYBOARD_LATENCY
+#define CONFIG_KEYBOARD_PROTOCOL_MKBP
+#endif
+
 #ifdef TEST_KB_SCAN
 #define CONFIG_KEYBOARD_PROTOCOL_MKBP
 #endif
@@ -50,6 +59,29 @@
 #define I2C_PORT_CHARGER 1
 #endif
 
+#ifdef TEST_I2C_ASYNC
+#define CONFIG_I2C_ASYNC
+#endif
+
+#ifdef TEST_I2C_EMUL
+#define CONFIG_ACCEL_KXCJ9
+#define CONFIG_I2C_REGCACHE
+#define I2C_PORT_ACCEL 1
+#endif
+
+#ifdef TEST_I2C_REGCACHE
+#define CONFIG_I2C_REGCACHE
+#endif
+
+#ifdef TEST_I2C_STATS
+#define CONFIG_I2C_STATS
+#endif
+
+#ifdef TEST_MOTION_SENSE
+#define CONFIG_ACCEL_FIFO 8
+#define CONFIG_ACCEL_HW_FIFO
+#endif
+
 #ifdef TEST_SBS_CHARGING
 #define CONFIG_BATTERY_MOCK
 #define CONFIG_BATTERY_SMART
@@ -83,6 +115,19 @@ int board_discharge_on_ac(int enabled);
 #define CONFIG_TEMP_SENSOR
 #endif
 
+#ifdef TEST_FAN_PID
+#define CONFIG_CHIPSET_CAN_THROTTLE
+#define CONFIG_FANS 1
+#define CONFIG_FAN_PID
+#define CONFIG_TEMP_SENSOR
+#endif
+
+#ifdef TEST_TEMP_POLL
+#define CONFIG_CHIPSET_CAN_THROTTLE
+#define CONFIG_TEMP_SENSOR
+#define CONFIG_TEMP_SENSOR_POLL
+#endif
+
 #ifdef TEST_THERMAL_FALCO
 #define CONFIG_BATTERY_MOCK
 #define CONFIG_BATTERY_SMART
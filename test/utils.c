@@ -316,6 +316,21 @@ static int test_get_next_bit(void)
 	return EC_SUCCESS;
 }
 
+static int test_histogram_log2_bucket(void)
+{
+	TEST_ASSERT(histogram_log2_bucket(0, 4) == 0);
+	TEST_ASSERT(histogram_log2_bucket(1, 4) == 0);
+	TEST_ASSERT(histogram_log2_bucket(3, 4) == 1);
+	TEST_ASSERT(histogram_log2_bucket(4, 4) == 2);
+	TEST_ASSERT(histogram_log2_bucket(7, 4) == 2);
+
+	/* Big values land in the last bucket */
+	TEST_ASSERT(histogram_log2_bucket(8, 4) == 3);
+	TEST_ASSERT(histogram_log2_bucket(0xffffffff, 4) == 3);
+
+	return EC_SUCCESS;
+}
+
 static int test_shared_mem(void)
 {
 	int i;
@@ -462,6 +477,7 @@ void run_test(void)
 	RUN_TEST(test_uint64divmod_1);
 	RUN_TEST(test_uint64divmod_2);
 	RUN_TEST(test_get_next_bit);
+	RUN_TEST(test_histogram_log2_bucket);
 	RUN_TEST(test_shared_mem);
 	RUN_TEST(test_scratchpad);
 	RUN_TEST(test_cond_t);
@@ -16,8 +16,9 @@ comm-objs+=comm-lpc.o
 else
 comm-objs+=comm-i2c.o
 endif
-ectool-objs=ectool.o ectool_keyscan.o misc_util.o ec_flash.o $(comm-objs)
+ectool-objs=ectool.o ectool_keyscan.o misc_util.o ec_flash.o sha256-host.o
+ectool-objs+=$(comm-objs)
 lbplay-objs=lbplay.o $(comm-objs)
-burn_my_ec-objs=ec_flash.o $(comm-objs) misc_util.o
+burn_my_ec-objs=ec_flash.o sha256-host.o $(comm-objs) misc_util.o
 
 build-util-bin=ec_uartd stm32mon iteflash
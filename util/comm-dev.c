@@ -78,6 +78,45 @@ static int ec_readmem_dev(int offset, int bytes, void *dest)
 			      dest, bytes);
 }
 
+/*
+ * Ask the EC for its maximum packet sizes.  This goes straight to the ioctl
+ * rather than through ec_command_dev(), so older ECs which don't know the
+ * command don't produce error messages.
+ */
+static void ec_get_packet_sizes_dev(void)
+{
+	struct ec_response_get_protocol_info info;
+	struct cros_ec_command s_cmd;
+	int outsize, insize;
+
+	s_cmd.command = EC_CMD_GET_PROTOCOL_INFO;
+	s_cmd.version = 0;
+	s_cmd.result = 0xff;
+	s_cmd.outsize = 0;
+	s_cmd.outdata = NULL;
+	s_cmd.insize = sizeof(info);
+	s_cmd.indata = (uint8_t *)&info;
+
+	if (ioctl(fd, CROS_EC_DEV_IOCXCMD, &s_cmd) < 0 ||
+	    s_cmd.result != EC_RES_SUCCESS ||
+	    !(info.protocol_versions & (1 << 3)))
+		return;
+
+	outsize = info.max_request_packet_size -
+		sizeof(struct ec_host_request);
+	insize = info.max_response_packet_size -
+		sizeof(struct ec_host_response);
+
+	/*
+	 * The defaults are also the most the cros_ec_dev driver can pass, so
+	 * never go above them; only shrink them to suit the EC.
+	 */
+	if (outsize < ec_max_outsize)
+		ec_max_outsize = outsize;
+	if (insize < ec_max_insize)
+		ec_max_insize = insize;
+}
+
 int comm_init_dev(void)
 {
 	char version[80];
@@ -108,8 +147,8 @@ int comm_init_dev(void)
 		ec_readmem = ec_readmem_dev;
 
 	/*
-	 * TODO(crosbug.com/p/23823): Need a way to get this from the driver
-	 * and EC.  For now, pick a magic lowest common denominator value. The
+	 * TODO(crosbug.com/p/23823): Need a way to get this from the driver.
+	 * Start from a magic lowest common denominator value. The
 	 * ec_max_outsize is set to handle v3 EC protocol. The ec_max_insize
 	 * needs to be set to the largest value that can be returned from the
 	 * EC, EC_PROTO2_MAX_PARAM_SIZE.
@@ -117,5 +156,8 @@ int comm_init_dev(void)
 	ec_max_outsize = EC_PROTO2_MAX_PARAM_SIZE - 8;
 	ec_max_insize = EC_PROTO2_MAX_PARAM_SIZE;
 
+	/* If the EC speaks protocol v3, don't exceed the packets it takes */
+	ec_get_packet_sizes_dev();
+
 	return 0;
 }
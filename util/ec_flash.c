@@ -8,33 +8,218 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
 
 #include "comm-host.h"
+#include "ec_flash.h"
 #include "misc_util.h"
+#include "sha256.h"
+
+/* Retry a hash request every HASH_RETRY_US while the EC is busy hashing */
+#define HASH_RETRIES 50
+#define HASH_RETRY_US 100000
+
+/**
+ * Print how fast a transfer went.
+ *
+ * @param what		Verb for the transfer ("Read", "Wrote")
+ * @param size		Number of bytes transferred
+ * @param start		Time the transfer started
+ */
+static void print_rate(const char *what, int size, const struct timeval *start)
+{
+	struct timeval now;
+	double secs;
+
+	gettimeofday(&now, NULL);
+	secs = (now.tv_sec - start->tv_sec) +
+		(now.tv_usec - start->tv_usec) / 1000000.0;
+	if (secs <= 0)
+		return;
+
+	printf("%s %d bytes in %.2f s (%.3f MB/s)\n",
+	       what, size, secs, size / secs / 1000000.0);
+}
 
 int ec_flash_read(uint8_t *buf, int offset, int size)
 {
 	struct ec_params_flash_read p;
+	struct timeval start;
 	int rv;
 	int i;
 
-	/* Read data in chunks */
+	gettimeofday(&start, NULL);
+
+	/* Read data in chunks, straight into the caller's buffer */
 	for (i = 0; i < size; i += ec_max_insize) {
 		p.offset = offset + i;
 		p.size = MIN(size - i, ec_max_insize);
 		rv = ec_command(EC_CMD_FLASH_READ, 0,
-				&p, sizeof(p), ec_inbuf, p.size);
+				&p, sizeof(p), buf + i, p.size);
 		if (rv < 0) {
-			fprintf(stderr, "Read error at offset %d\n", i);
+			fprintf(stderr, "Read error at offset %d\n",
+				offset + i);
 			return rv;
 		}
-		memcpy(buf + i, ec_inbuf, p.size);
 	}
 
+	print_rate("Read", size, &start);
 	return 0;
 }
 
-int ec_flash_verify(const uint8_t *buf, int offset, int size)
+/**
+ * Determine the write chunk size.
+ *
+ * This must be a multiple of the write block size, and must also fit into
+ * the host parameter buffer.
+ *
+ * @return chunk size in bytes, or negative if error.
+ */
+static int ec_flash_write_step(void)
+{
+	struct ec_response_flash_info info;
+	int pdata_max_size =
+		(int)(ec_max_outsize - sizeof(struct ec_params_flash_write));
+	int step;
+	int rv;
+
+	/*
+	 * Determine whether we can use version 1 of the command with more
+	 * data, or only version 0.
+	 */
+	if (!ec_cmd_version_supported(EC_CMD_FLASH_WRITE, EC_VER_FLASH_WRITE))
+		pdata_max_size = EC_FLASH_WRITE_VER0_SIZE;
+
+	rv = ec_command(EC_CMD_FLASH_INFO, 0, NULL, 0, &info, sizeof(info));
+	if (rv < 0)
+		return rv;
+
+	step = (pdata_max_size / info.write_block_size) * info.write_block_size;
+
+	if (!step) {
+		fprintf(stderr, "Write block size %d > max param size %d\n",
+			info.write_block_size, pdata_max_size);
+		return -1;
+	}
+
+	return step;
+}
+
+/**
+ * Write data to EC flash in chunks of at most step bytes.
+ */
+static int ec_flash_write_chunks(const uint8_t *buf, int offset, int size,
+				 int step)
+{
+	struct ec_params_flash_write *p =
+		(struct ec_params_flash_write *)ec_outbuf;
+	int rv;
+	int i;
+
+	for (i = 0; i < size; i += step) {
+		p->offset = offset + i;
+		p->size = MIN(size - i, step);
+		memcpy(p + 1, buf + i, p->size);
+		rv = ec_command(EC_CMD_FLASH_WRITE, 0, p, sizeof(*p) + p->size,
+				NULL, 0);
+		if (rv < 0) {
+			fprintf(stderr, "Write error at offset %d\n",
+				offset + i);
+			return rv;
+		}
+	}
+
+	return 0;
+}
+
+int ec_flash_write(const uint8_t *buf, int offset, int size)
+{
+	struct timeval start;
+	int step = ec_flash_write_step();
+	int rv;
+
+	if (step < 0)
+		return step;
+
+	/* Write data in chunks */
+	printf("Write size %d...\n", step);
+
+	gettimeofday(&start, NULL);
+	rv = ec_flash_write_chunks(buf, offset, size, step);
+	if (rv < 0)
+		return rv;
+
+	print_rate("Wrote", size, &start);
+	return 0;
+}
+
+int ec_flash_hash(uint8_t *digest, int offset, int size)
+{
+	struct ec_params_vboot_hash p;
+	struct ec_response_vboot_hash r;
+	int rv;
+	int i;
+
+	memset(&p, 0, sizeof(p));
+	p.cmd = EC_VBOOT_HASH_RECALC;
+	p.hash_type = EC_VBOOT_HASH_TYPE_SHA256;
+	p.offset = offset;
+	p.size = size;
+
+	for (i = 0; i < HASH_RETRIES; i++) {
+		rv = ec_command(EC_CMD_VBOOT_HASH, 0, &p, sizeof(p),
+				&r, sizeof(r));
+		if (rv != -EECRESULT - EC_RES_ERROR)
+			break;
+
+		/*
+		 * The EC refuses to start a hash while it's still working on
+		 * another one (for example, the RW hash it computes at boot).
+		 * Wait for that to finish rather than abort it, since the EC
+		 * may be relying on its result.
+		 */
+		usleep(HASH_RETRY_US);
+	}
+	if (rv < 0)
+		return rv;
+
+	if (r.status != EC_VBOOT_HASH_STATUS_DONE ||
+	    r.hash_type != EC_VBOOT_HASH_TYPE_SHA256 ||
+	    r.digest_size != SHA256_DIGEST_SIZE ||
+	    r.offset != offset || r.size != size) {
+		fprintf(stderr, "Bad hash response for offset %d\n", offset);
+		return -1;
+	}
+
+	memcpy(digest, r.hash_digest, SHA256_DIGEST_SIZE);
+	return 0;
+}
+
+/**
+ * Check whether a region of EC flash already matches the buffer.
+ *
+ * @return 1 if the EC's digest matches the buffer, 0 if it doesn't or the EC
+ * couldn't compute a digest.
+ */
+static int ec_flash_matches(const uint8_t *buf, int offset, int size)
+{
+	uint8_t digest[SHA256_DIGEST_SIZE];
+	struct sha256_ctx ctx;
+
+	if (ec_flash_hash(digest, offset, size))
+		return 0;
+
+	SHA256_init(&ctx);
+	SHA256_update(&ctx, buf, size);
+
+	return !memcmp(digest, SHA256_final(&ctx), SHA256_DIGEST_SIZE);
+}
+
+/**
+ * Verify EC flash by reading it back and comparing it byte by byte.
+ */
+static int ec_flash_verify_readback(const uint8_t *buf, int offset, int size)
 {
 	uint8_t *rbuf = malloc(size);
 	int rv;
@@ -55,7 +240,7 @@ int ec_flash_verify(const uint8_t *buf, int offset, int size)
 		if (buf[i] != rbuf[i]) {
 			fprintf(stderr, "Mismatch at offset 0x%x: "
 				"want 0x%02x, got 0x%02x\n",
-				i, buf[i], rbuf[i]);
+				offset + i, buf[i], rbuf[i]);
 			free(rbuf);
 			return -1;
 		}
@@ -65,54 +250,146 @@ int ec_flash_verify(const uint8_t *buf, int offset, int size)
 	return 0;
 }
 
-int ec_flash_write(const uint8_t *buf, int offset, int size)
+/**
+ * Find and report the first mismatch in a region whose digest didn't match.
+ *
+ * Bisects the region by hashing on the EC until it's down to a single bank,
+ * then reads that bank back.
+ */
+static int ec_flash_locate_mismatch(const uint8_t *buf, int offset, int size,
+				    int block)
+{
+	while (size > block) {
+		/* Split on a bank boundary */
+		int half = (size / block + 1) / 2 * block;
+
+		if (ec_flash_matches(buf, offset, half)) {
+			buf += half;
+			offset += half;
+			size -= half;
+		} else {
+			size = half;
+		}
+	}
+
+	/* The digest may have been wrong, so only believe the read-back */
+	if (!ec_flash_verify_readback(buf, offset, size))
+		return 0;
+
+	fprintf(stderr, "Bank at offset 0x%x doesn't match\n", offset);
+	return -1;
+}
+
+int ec_flash_verify(const uint8_t *buf, int offset, int size)
 {
-	struct ec_params_flash_write *p =
-		(struct ec_params_flash_write *)ec_outbuf;
 	struct ec_response_flash_info info;
-	int pdata_max_size = (int)(ec_max_outsize - sizeof(*p));
-	int step;
 	int rv;
-	int i;
 
-	/*
-	 * Determine whether we can use version 1 of the command with more
-	 * data, or only version 0.
-	 */
-	if (!ec_cmd_version_supported(EC_CMD_FLASH_WRITE, EC_VER_FLASH_WRITE))
-		pdata_max_size = EC_FLASH_WRITE_VER0_SIZE;
+	/* Fall back to reading everything if the EC can't hash flash */
+	if (!ec_cmd_version_supported(EC_CMD_VBOOT_HASH, 0))
+		return ec_flash_verify_readback(buf, offset, size);
+
+	if (ec_flash_matches(buf, offset, size))
+		return 0;
+
+	rv = ec_command(EC_CMD_FLASH_INFO, 0, NULL, 0, &info, sizeof(info));
+	if (rv < 0)
+		return rv;
+
+	rv = ec_flash_locate_mismatch(buf, offset, size,
+			MAX(info.protect_block_size, info.erase_block_size));
 
 	/*
-	 * Determine step size.  This must be a multiple of the write block
-	 * size, and must also fit into the host parameter buffer.
+	 * If the bisection didn't turn up a bad byte, the EC couldn't hash
+	 * the whole range (or flash changed under us), so check it all.
 	 */
+	if (!rv)
+		return ec_flash_verify_readback(buf, offset, size);
+
+	return rv;
+}
+
+/**
+ * Erase and rewrite a region of EC flash.
+ */
+static int ec_flash_rewrite(const uint8_t *buf, int offset, int size,
+			    int step)
+{
+	int rv = ec_flash_erase(offset, size);
+
+	if (rv < 0) {
+		fprintf(stderr, "Erase error at offset %d\n", offset);
+		return rv;
+	}
+
+	return ec_flash_write_chunks(buf, offset, size, step);
+}
+
+int ec_flash_write_delta(const uint8_t *buf, int offset, int size)
+{
+	struct ec_response_flash_info info;
+	struct timeval start;
+	int can_hash;
+	int block;
+	int step;
+	int run = 0;
+	int changed = 0;
+	int rv;
+	int i;
+
 	rv = ec_command(EC_CMD_FLASH_INFO, 0, NULL, 0, &info, sizeof(info));
 	if (rv < 0)
 		return rv;
 
-	step = (pdata_max_size / info.write_block_size) * info.write_block_size;
-
-	if (!step) {
-		fprintf(stderr, "Write block size %d > max param size %d\n",
-			info.write_block_size, pdata_max_size);
+	if ((offset | size) % info.erase_block_size) {
+		fprintf(stderr, "Offset and size must be multiples of the "
+			"erase block size (%d)\n", info.erase_block_size);
 		return -1;
 	}
 
-	/* Write data in chunks */
-	printf("Write size %d...\n", step);
+	step = ec_flash_write_step();
+	if (step < 0)
+		return step;
 
-	for (i = 0; i < size; i += step) {
-		p->offset = offset + i;
-		p->size = MIN(size - i, step);
-		memcpy(p + 1, buf + i, p->size);
-		rv = ec_command(EC_CMD_FLASH_WRITE, 0, p, sizeof(*p) + p->size,
-				NULL, 0);
-		if (rv < 0) {
-			fprintf(stderr, "Write error at offset %d\n", i);
-			return rv;
+	/*
+	 * Compare in units of protect banks, which are whole erase blocks.  If
+	 * the EC can't hash flash, every bank is treated as changed.
+	 */
+	block = MAX(info.protect_block_size, info.erase_block_size);
+	can_hash = ec_cmd_version_supported(EC_CMD_VBOOT_HASH, 0);
+	if (!can_hash)
+		printf("EC can't hash flash; rewriting everything.\n");
+
+	gettimeofday(&start, NULL);
+
+	/* Rewrite runs of adjacent changed banks together */
+	for (i = 0; i < size; i += block) {
+		int len = MIN(block, size - i);
+
+		if (!can_hash || !ec_flash_matches(buf + i, offset + i, len)) {
+			run += len;
+			changed++;
+			continue;
+		}
+
+		if (run) {
+			rv = ec_flash_rewrite(buf + i - run, offset + i - run,
+					      run, step);
+			if (rv < 0)
+				return rv;
+			run = 0;
 		}
 	}
+	if (run) {
+		rv = ec_flash_rewrite(buf + size - run, offset + size - run,
+				      run, step);
+		if (rv < 0)
+			return rv;
+	}
 
+	printf("Updated %d of %d banks.\n", changed,
+	       (size + block - 1) / block);
+	print_rate("Updated", size, &start);
 	return 0;
 }
 
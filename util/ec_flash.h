@@ -20,6 +20,10 @@ int ec_flash_read(uint8_t *buf, int offset, int size);
 /**
  * Verify EC flash memory
  *
+ * Compares the EC's SHA-256 digest of the region against the buffer.  On a
+ * mismatch, bisects the region by hash to find the bad bank and reads only
+ * that back.  Reads back the whole region if the EC can't hash flash.
+ *
  * @param buf		Source buffer to verify against EC flash
  * @param offset	Offset in EC flash to check
  * @param size		Number of bytes to check
@@ -39,6 +43,33 @@ int ec_flash_verify(const uint8_t *buf, int offset, int size);
  */
 int ec_flash_write(const uint8_t *buf, int offset, int size);
 
+/**
+ * Write EC flash memory, skipping banks which already hold the data
+ *
+ * Asks the EC for the SHA-256 digest of each flash bank in the range and
+ * only erases and writes banks whose digest differs from the new data.
+ *
+ * @param buf		Source buffer
+ * @param offset	Offset in EC flash to write; must be a multiple of
+ *			the erase block size
+ * @param size		Number of bytes to write; must be a multiple of the
+ *			erase block size
+ *
+ * @return 0 if success, negative if error.
+ */
+int ec_flash_write_delta(const uint8_t *buf, int offset, int size);
+
+/**
+ * Compute the SHA-256 digest of EC flash memory on the EC
+ *
+ * @param digest	Destination for SHA256_DIGEST_SIZE byte digest
+ * @param offset	Offset in EC flash to hash
+ * @param size		Number of bytes to hash
+ *
+ * @return 0 if success, negative if error.
+ */
+int ec_flash_hash(uint8_t *digest, int offset, int size);
+
 /**
  * Erase EC flash memory
  *
@@ -76,6 +76,8 @@ const char help_str[] =
 	"      Sets the wake mask for EC host events\n"
 	"  fanduty <percent>\n"
 	"      Forces the fan PWM to a constant duty cycle\n"
+	"  fanpid <fan> [<param> <value>...]\n"
+	"      Get or set closed-loop fan control parameters\n"
 	"  flasherase <offset> <size>\n"
 	"      Erases EC flash\n"
 	"  flashinfo\n"
@@ -84,6 +86,8 @@ const char help_str[] =
 	"      Prints or sets EC flash protection state\n"
 	"  flashread <offset> <size> <outfile>\n"
 	"      Reads from EC flash to a file\n"
+	"  flashupdate <offset> <infile>\n"
+	"      Writes to EC flash from a file, skipping unchanged banks\n"
 	"  flashwrite <offset> <infile>\n"
 	"      Writes to EC flash from a file\n"
 	"  gpioget <GPIO name>\n"
@@ -94,6 +98,8 @@ const char help_str[] =
 	"      Configure or start/stop the hang detect timer\n"
 	"  hello\n"
 	"      Checks for basic communication with EC\n"
+	"  kblatency [clear]\n"
+	"      Prints (and optionally clears) key event latency statistics\n"
 	"  kbpress\n"
 	"      Simulate key press\n"
 	"  i2cread\n"
@@ -102,6 +108,10 @@ const char help_str[] =
 	"      Write I2C bus\n"
 	"  i2cxfer <port> <slave_addr> <read_count> [write bytes...]\n"
 	"      Perform I2C transfer on EC's I2C bus\n"
+	"  i2cscript <port> [file]\n"
+	"      Run a script of I2C transfers, batched into few commands\n"
+	"  i2cstats [clear]\n"
+	"      Prints (and optionally clears) I2C bus and lock statistics\n"
 	"  keyscan <beat_us> <filename>\n"
 	"      Test low-level key scanning\n"
 	"  led <name> <query | auto | off | <color> | <color>=<value>...>\n"
@@ -655,6 +665,43 @@ int cmd_flash_write(int argc, char *argv[])
 	return 0;
 }
 
+int cmd_flash_update(int argc, char *argv[])
+{
+	int offset, size;
+	int rv;
+	char *e;
+	char *buf;
+
+	if (argc < 3) {
+		fprintf(stderr, "Usage: %s <offset> <filename>\n", argv[0]);
+		return -1;
+	}
+
+	offset = strtol(argv[1], &e, 0);
+	if ((e && *e) || offset < 0 || offset > 0x100000) {
+		fprintf(stderr, "Bad offset.\n");
+		return -1;
+	}
+
+	/* Read the input file */
+	buf = read_file(argv[2], &size);
+	if (!buf)
+		return -1;
+
+	printf("Updating offset %d...\n", offset);
+
+	/* Only rewrite the banks which have changed */
+	rv = ec_flash_write_delta((const uint8_t *)buf, offset, size);
+
+	free(buf);
+
+	if (rv < 0)
+		return rv;
+
+	printf("done.\n");
+	return 0;
+}
+
 int cmd_flash_erase(int argc, char *argv[])
 {
 	int offset, size;
@@ -1183,6 +1230,110 @@ int cmd_thermal_auto_fan_ctrl(int argc, char *argv[])
 	return 0;
 }
 
+int cmd_fan_pid(int argc, char *argv[])
+{
+	static const char * const names[] = {
+		"target", "hyst", "period", "kp", "ki", "kd"
+	};
+	struct ec_params_fan_pid_get_config p;
+	struct ec_response_fan_pid_get_config r;
+	struct ec_params_fan_pid_set_config s;
+	struct ec_fan_pid_config *cfg = &s.cfg;
+	int i, n, val, rv;
+	char *e;
+
+	if (argc < 2 || !(argc & 1)) {
+		fprintf(stderr, "Usage: %s <fan> [<param> <value>...]\n"
+			"  param is target, hyst, period, kp, ki, kd, or\n"
+			"  weight<N> for the weight of sensor N\n", argv[0]);
+		return -1;
+	}
+
+	p.fan = strtol(argv[1], &e, 0);
+	if (e && *e) {
+		fprintf(stderr, "Bad fan.\n");
+		return -1;
+	}
+
+	rv = ec_command(EC_CMD_FAN_PID_GET_CONFIG, 0, &p, sizeof(p),
+			&r, sizeof(r));
+	if (rv < 0)
+		return rv;
+
+	if (argc == 2) {
+		printf("Target:     %d K\n", r.cfg.temp_target);
+		printf("Hysteresis: %d K\n", r.cfg.hysteresis);
+		printf("Period:     %d ms\n", r.cfg.period_ms);
+		printf("Gains:      kp %d ki %d kd %d\n", r.cfg.kp, r.cfg.ki,
+		       r.cfg.kd);
+		printf("Weights:   ");
+		for (i = 0; i < EC_FAN_PID_SENSORS; i++)
+			if (r.cfg.weight[i])
+				printf(" %d:%d", i, r.cfg.weight[i]);
+		printf("\nTemp:       %d K\n", r.temp);
+		printf("Output:     %d%% (%s)\n", r.percent,
+		       r.flags & EC_FAN_PID_FLAG_ON ? "on" : "off");
+		return 0;
+	}
+
+	/* Change only the parameters given */
+	s.fan = p.fan;
+	s.cfg = r.cfg;
+	for (i = 2; i < argc; i += 2) {
+		val = strtol(argv[i + 1], &e, 0);
+		if (e && *e) {
+			fprintf(stderr, "Bad value for %s.\n", argv[i]);
+			return -1;
+		}
+
+		if (!strncmp(argv[i], "weight", 6)) {
+			n = strtol(argv[i] + 6, &e, 0);
+			if (!argv[i][6] || (e && *e) || n < 0 ||
+			    n >= EC_FAN_PID_SENSORS) {
+				fprintf(stderr, "Bad sensor in %s.\n", argv[i]);
+				return -1;
+			}
+			cfg->weight[n] = val;
+			continue;
+		}
+
+		for (n = 0; n < ARRAY_SIZE(names); n++)
+			if (!strcmp(argv[i], names[n]))
+				break;
+
+		switch (n) {
+		case 0:
+			cfg->temp_target = val;
+			break;
+		case 1:
+			cfg->hysteresis = val;
+			break;
+		case 2:
+			cfg->period_ms = val;
+			break;
+		case 3:
+			cfg->kp = val;
+			break;
+		case 4:
+			cfg->ki = val;
+			break;
+		case 5:
+			cfg->kd = val;
+			break;
+		default:
+			fprintf(stderr, "Unknown parameter %s.\n", argv[i]);
+			return -1;
+		}
+	}
+
+	rv = ec_command(EC_CMD_FAN_PID_SET_CONFIG, 0, &s, sizeof(s), NULL, 0);
+	if (rv < 0)
+		return rv;
+
+	printf("Fan %d PID profile updated.\n", p.fan);
+	return 0;
+}
+
 static int print_fan(int idx)
 {
 	int rv = read_mapped_mem16(EC_MEMMAP_FAN + 2 * idx);
@@ -1977,6 +2128,8 @@ static const struct {
 	MS_SIZES(sensor_odr),
 	MS_SIZES(sensor_range),
 	MS_SIZES(kb_wake_angle),
+	MS_SIZES(fifo_info),
+	MS_SIZES(fifo_read),
 };
 BUILD_ASSERT(ARRAY_SIZE(ms_command_sizes) == MOTIONSENSE_NUM_CMDS);
 #undef MS_SIZES
@@ -1991,6 +2144,8 @@ static int ms_help(const char *cmd)
 	printf("  %s odr NUM [ODR [ROUNDUP]]    - set/get sensor ODR\n", cmd);
 	printf("  %s range NUM [RANGE [ROUNDUP]]- set/get sensor range\n", cmd);
 	printf("  %s kb_wake NUM                - set/get KB wake ang\n", cmd);
+	printf("  %s fifo_info [WATERMARK]      - set/get sample FIFO\n", cmd);
+	printf("  %s fifo_read [MAX]            - read queued samples\n", cmd);
 
 	return 0;
 }
@@ -2105,6 +2260,9 @@ static int cmd_motionsense(int argc, char **argv)
 		case MOTIONSENSE_CHIP_KXCJ9:
 			printf("kxcj9\n");
 			break;
+		case MOTIONSENSE_CHIP_LSM6DS0:
+			printf("lsm6ds0\n");
+			break;
 		default:
 			printf("unknown\n");
 		}
@@ -2234,6 +2392,65 @@ static int cmd_motionsense(int argc, char **argv)
 		return 0;
 	}
 
+	if (argc < 4 && !strcasecmp(argv[1], "fifo_info")) {
+		param.cmd = MOTIONSENSE_CMD_FIFO_INFO;
+		param.fifo_info.watermark = EC_MOTION_SENSE_NO_VALUE;
+
+		if (argc == 3) {
+			param.fifo_info.watermark = strtol(argv[2], &e, 0);
+			if (e && *e) {
+				fprintf(stderr, "Bad %s arg.\n", argv[1]);
+				return -1;
+			}
+		}
+
+		rv = ec_command(EC_CMD_MOTION_SENSE_CMD, 0,
+				&param, ms_command_sizes[param.cmd].insize,
+				&resp, ms_command_sizes[param.cmd].outsize);
+
+		if (rv < 0)
+			return rv;
+
+		printf("Size:      %d\n", resp.fifo_info.size);
+		printf("Count:     %d\n", resp.fifo_info.count);
+		printf("Watermark: %d\n", resp.fifo_info.watermark);
+		printf("Lost:      %d\n", resp.fifo_info.lost);
+		return 0;
+	}
+
+	if (argc < 4 && !strcasecmp(argv[1], "fifo_read")) {
+		struct ec_response_motion_sense *r =
+			(struct ec_response_motion_sense *)ec_inbuf;
+
+		param.cmd = MOTIONSENSE_CMD_FIFO_READ;
+		param.fifo_read.max_samples = 255;
+
+		if (argc == 3) {
+			param.fifo_read.max_samples = strtol(argv[2], &e, 0);
+			if (e && *e) {
+				fprintf(stderr, "Bad %s arg.\n", argv[1]);
+				return -1;
+			}
+		}
+
+		rv = ec_command(EC_CMD_MOTION_SENSE_CMD, 0,
+				&param, ms_command_sizes[param.cmd].insize,
+				ec_inbuf, ec_max_insize);
+
+		if (rv < 0)
+			return rv;
+
+		for (i = 0; i < r->fifo_read.count; i++) {
+			struct ec_response_motion_sensor_data *d =
+				&r->fifo_read.data[i];
+
+			printf("%10u: sensor %d: %d %d %d\n", d->timestamp,
+			       d->sensor_num, d->data[0], d->data[1],
+			       d->data[2]);
+		}
+		return 0;
+	}
+
 	return ms_help(argv[0]);
 }
 
@@ -2441,6 +2658,55 @@ int cmd_kbpress(int argc, char *argv[])
 }
 
 
+int cmd_kblatency(int argc, char *argv[])
+{
+	static const char * const
+		stage_name[EC_KEYBOARD_LATENCY_STAGE_COUNT] = {
+		"scan", "debounce", "encode", "host"};
+	struct ec_params_keyboard_latency p;
+	struct ec_response_keyboard_latency r;
+	int rv;
+	int i, j;
+
+	p.flags = 0;
+	if (argc > 1) {
+		if (strcasecmp(argv[1], "clear")) {
+			fprintf(stderr, "Usage: %s [clear]\n", argv[0]);
+			return -1;
+		}
+		p.flags |= EC_KEYBOARD_LATENCY_FLAG_CLEAR;
+	}
+
+	rv = ec_command(EC_CMD_KEYBOARD_LATENCY, 0, &p, sizeof(p),
+			&r, sizeof(r));
+	if (rv < 0)
+		return rv;
+
+	for (i = 0; i < EC_KEYBOARD_LATENCY_STAGE_COUNT; i++) {
+		const struct ec_keyboard_latency_stage_stats *s = r.stage + i;
+
+		printf("%-9s count %u", stage_name[i], s->count);
+		if (s->count)
+			printf(", mean %u us, max %u us",
+			       s->total_us / s->count, s->max_us);
+		printf("\n");
+
+		for (j = 0; j < EC_KEYBOARD_LATENCY_BUCKETS; j++) {
+			if (!s->buckets[j])
+				continue;
+			if (j == EC_KEYBOARD_LATENCY_BUCKETS - 1)
+				printf("  >= %6u us: %u\n", 1 << j,
+				       s->buckets[j]);
+			else
+				printf("  <  %6u us: %u\n", 2 << j,
+				       s->buckets[j]);
+		}
+	}
+
+	return 0;
+}
+
+
 static void print_panic_reg(int regnum, const uint32_t *regs, int index)
 {
 	static const char * const regname[] = {
@@ -3191,6 +3457,295 @@ int cmd_i2c_xfer(int argc, char *argv[])
 	return 0;
 }
 
+/* One message of an I2C script */
+struct i2c_script_msg {
+	unsigned int addr_flags;	/* EC_I2C_FLAG_* and 7-bit address */
+	int len;
+	int offset;			/* Of write data in the data buffer */
+	int line;			/* Script line, for errors */
+};
+
+/**
+ * Send one batch of whole transactions as a single passthru command and
+ * print what each read message returned.
+ */
+static int i2c_script_batch(int port, int version,
+			    const struct i2c_script_msg *msgs, int count,
+			    const uint8_t *wdata)
+{
+	struct ec_params_i2c_passthru *p =
+		(struct ec_params_i2c_passthru *)ec_outbuf;
+	struct ec_response_i2c_passthru *r =
+		(struct ec_response_i2c_passthru *)ec_inbuf;
+	uint8_t *pdata = (uint8_t *)(p->msg + count);
+	int read_len = 0;
+	int rv, i, j;
+
+	p->port = port;
+	p->num_msgs = count;
+	for (i = 0; i < count; i++) {
+		p->msg[i].addr_flags = msgs[i].addr_flags;
+		if (!version)
+			p->msg[i].addr_flags &= ~EC_I2C_FLAG_STOP;
+		p->msg[i].len = msgs[i].len;
+
+		if (msgs[i].addr_flags & EC_I2C_FLAG_READ) {
+			read_len += msgs[i].len;
+		} else {
+			memcpy(pdata, wdata + msgs[i].offset, msgs[i].len);
+			pdata += msgs[i].len;
+		}
+	}
+
+	rv = ec_command(EC_CMD_I2C_PASSTHRU, version, p,
+			pdata - (uint8_t *)p, r, sizeof(*r) + read_len);
+	if (rv < 0)
+		return rv;
+
+	if (r->i2c_status & EC_I2C_STATUS_ERROR) {
+		fprintf(stderr, "Line %d: transfer failed with status=0x%x\n",
+			msgs[MIN(r->num_msgs, count - 1)].line,
+			r->i2c_status);
+		return -1;
+	}
+
+	if (rv < sizeof(*r) + read_len) {
+		fprintf(stderr, "Truncated read response\n");
+		return -1;
+	}
+
+	for (i = 0, pdata = r->data; i < count; i++) {
+		if (!(msgs[i].addr_flags & EC_I2C_FLAG_READ))
+			continue;
+
+		printf("Line %d read:", msgs[i].line);
+		for (j = 0; j < msgs[i].len; j++)
+			printf(" %#02x", *pdata++);
+		printf("\n");
+	}
+
+	return 0;
+}
+
+int cmd_i2c_script(int argc, char *argv[])
+{
+	struct i2c_script_msg *msgs = NULL, *m;
+	uint8_t *wdata = NULL, *w;
+	int count = 0, wsize = 0;
+	int first, next, end, out_size, in_size, size;
+	int port, version, lineno;
+	char line[1024];
+	char *tok, *e;
+	FILE *fp = stdin;
+	int rv = -1;
+
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr, "Usage: %s <port> [file]\n", argv[0]);
+		return -1;
+	}
+
+	port = strtol(argv[1], &e, 0);
+	if (e && *e) {
+		fprintf(stderr, "Bad port.\n");
+		return -1;
+	}
+
+	if (argc == 3 && strcmp(argv[2], "-")) {
+		fp = fopen(argv[2], "r");
+		if (!fp) {
+			fprintf(stderr, "Can't open %s: %s\n", argv[2],
+				strerror(errno));
+			return -1;
+		}
+	}
+
+	/*
+	 * Each line is "w <addr> <bytes...>", "r <addr> <len>" or "stop".
+	 * Messages up to a stop (or the end) form one transaction.
+	 */
+	for (lineno = 1; fgets(line, sizeof(line), fp); lineno++) {
+		tok = strtok(line, " \t\r\n");
+		if (!tok || tok[0] == '#')
+			continue;
+
+		if (!strcasecmp(tok, "stop")) {
+			if (count)
+				msgs[count - 1].addr_flags |= EC_I2C_FLAG_STOP;
+			continue;
+		}
+
+		if (strcasecmp(tok, "r") && strcasecmp(tok, "w")) {
+			fprintf(stderr, "Line %d: unknown command %s\n",
+				lineno, tok);
+			goto out;
+		}
+
+		m = realloc(msgs, (count + 1) * sizeof(*msgs));
+		if (!m) {
+			fprintf(stderr, "Out of memory\n");
+			goto out;
+		}
+		msgs = m;
+		m = msgs + count;
+		m->line = lineno;
+		m->offset = wsize;
+		m->len = 0;
+		m->addr_flags = 0;
+		if (!strcasecmp(tok, "r"))
+			m->addr_flags |= EC_I2C_FLAG_READ;
+
+		tok = strtok(NULL, " \t\r\n");
+		m->addr_flags |= (tok ? strtol(tok, &e, 0) : 0) & 0x7f;
+		if (!tok || (e && *e)) {
+			fprintf(stderr, "Line %d: bad slave address\n", lineno);
+			goto out;
+		}
+
+		while ((tok = strtok(NULL, " \t\r\n")) && tok[0] != '#') {
+			int val = strtol(tok, &e, 0);
+
+			if ((e && *e) || (m->addr_flags & EC_I2C_FLAG_READ &&
+					  m->len)) {
+				fprintf(stderr, "Line %d: bad argument %s\n",
+					lineno, tok);
+				goto out;
+			}
+
+			if (m->addr_flags & EC_I2C_FLAG_READ) {
+				m->len = val;
+				continue;
+			}
+
+			w = realloc(wdata, wsize + 1);
+			if (!w) {
+				fprintf(stderr, "Out of memory\n");
+				goto out;
+			}
+			wdata = w;
+			wdata[wsize++] = val;
+			m->len++;
+		}
+
+		count++;
+	}
+	if (count)
+		msgs[count - 1].addr_flags |= EC_I2C_FLAG_STOP;
+
+	/* Older ECs run each command as one transaction */
+	version = ec_cmd_version_supported(EC_CMD_I2C_PASSTHRU, 1) ? 1 : 0;
+
+	/* Send as many whole transactions in each command as will fit */
+	for (first = 0; first < count; first = next) {
+		out_size = sizeof(struct ec_params_i2c_passthru);
+		in_size = sizeof(struct ec_response_i2c_passthru);
+
+		for (next = first; next < count; next = end) {
+			int tx_out = 0, tx_in = 0;
+
+			end = next;
+			do {
+				m = msgs + end;
+				tx_out += sizeof(struct ec_params_i2c_passthru_msg);
+				if (m->addr_flags & EC_I2C_FLAG_READ)
+					tx_in += m->len;
+				else
+					tx_out += m->len;
+			} while (!(msgs[end++].addr_flags & EC_I2C_FLAG_STOP));
+
+			if (out_size + tx_out > ec_max_outsize ||
+			    in_size + tx_in > ec_max_insize || end - first > 255)
+				break;
+			out_size += tx_out;
+			in_size += tx_in;
+
+			if (!version) {
+				next = end;
+				break;
+			}
+		}
+
+		size = next - first;
+		if (!size) {
+			fprintf(stderr, "Line %d: transaction too large\n",
+				msgs[first].line);
+			goto out;
+		}
+
+		if (i2c_script_batch(port, version, msgs + first, size, wdata))
+			goto out;
+	}
+
+	rv = 0;
+out:
+	if (fp != stdin)
+		fclose(fp);
+	free(msgs);
+	free(wdata);
+	return rv;
+}
+
+int cmd_i2c_stats(int argc, char *argv[])
+{
+	struct ec_params_i2c_stats p;
+	struct ec_response_i2c_stats_port rp;
+	struct ec_response_i2c_stats_task rt;
+	int rv;
+	int i;
+
+	p.flags = 0;
+	if (argc > 1) {
+		if (strcasecmp(argv[1], "clear")) {
+			fprintf(stderr, "Usage: %s [clear]\n", argv[0]);
+			return -1;
+		}
+		p.flags |= EC_I2C_STATS_FLAG_CLEAR;
+	}
+
+	/* Read ports and tasks until the EC says there are no more */
+	p.type = EC_I2C_STATS_PORT;
+	for (p.index = 0; ; p.index++) {
+		rv = ec_command(EC_CMD_I2C_STATS, 0, &p, sizeof(p),
+				&rp, sizeof(rp));
+		if (rv == -EC_RES_INVALID_PARAM && p.index)
+			break;
+		if (rv < 0)
+			return rv;
+
+		printf("port %d: %u xfers, %u bytes, %u naks, %u timeouts\n",
+		       p.index, rp.xfers, rp.bytes, rp.naks, rp.timeouts);
+		printf("  locked %u times, busy %u us, longest %u us\n",
+		       rp.locks, rp.busy_us, rp.hold_max_us);
+	}
+
+	p.type = EC_I2C_STATS_TASK;
+	for (p.index = 0; ; p.index++) {
+		rv = ec_command(EC_CMD_I2C_STATS, 0, &p, sizeof(p),
+				&rt, sizeof(rt));
+		if (rv == -EC_RES_INVALID_PARAM && p.index)
+			break;
+		if (rv < 0)
+			return rv;
+		if (!rt.locks)
+			continue;
+
+		printf("task %d: %u locks, waited %u us (max %u us), "
+		       "held %u us\n", p.index, rt.locks, rt.wait_us,
+		       rt.wait_max_us, rt.hold_us);
+		for (i = 0; i < EC_I2C_STATS_BUCKETS; i++) {
+			if (!rt.buckets[i])
+				continue;
+			if (i == EC_I2C_STATS_BUCKETS - 1)
+				printf("  >= %6u us: %u\n", 1 << i,
+				       rt.buckets[i]);
+			else
+				printf("  <  %6u us: %u\n", 2 << i,
+				       rt.buckets[i]);
+		}
+	}
+
+	return 0;
+}
+
 int cmd_lcd_backlight(int argc, char *argv[])
 {
 	struct ec_params_switch_enable_backlight p;
@@ -4069,7 +4624,8 @@ static const struct param_info keyconfig_params[] = {
 	FIELD("debounce_up", debounce_up_us, "time for debounce on key up"),
 	FIELD("fifo_max_depth", fifo_max_depth,
 	      "maximum depth to allow for fifo (0 = disable)"),
-	FIELD("flags", flags, "0 to disable scanning, 1 to enable"),
+	FIELD("flags", flags, "0 to disable scanning, 1 to enable, "
+	      "+2 for adaptive scan period"),
 };
 
 static const struct param_info *find_field(const struct param_info *params,
@@ -4475,19 +5031,24 @@ const struct command commands[] = {
 	{"eventsetsmimask", cmd_host_event_set_smi_mask},
 	{"eventsetwakemask", cmd_host_event_set_wake_mask},
 	{"fanduty", cmd_fanduty},
+	{"fanpid", cmd_fan_pid},
 	{"flasherase", cmd_flash_erase},
 	{"flashprotect", cmd_flash_protect},
 	{"flashread", cmd_flash_read},
+	{"flashupdate", cmd_flash_update},
 	{"flashwrite", cmd_flash_write},
 	{"flashinfo", cmd_flash_info},
 	{"gpioget", cmd_gpio_get},
 	{"gpioset", cmd_gpio_set},
 	{"hangdetect", cmd_hang_detect},
 	{"hello", cmd_hello},
+	{"kblatency", cmd_kblatency},
 	{"kbpress", cmd_kbpress},
 	{"i2cread", cmd_i2c_read},
 	{"i2cwrite", cmd_i2c_write},
 	{"i2cxfer", cmd_i2c_xfer},
+	{"i2cscript", cmd_i2c_script},
+	{"i2cstats", cmd_i2c_stats},
 	{"led", cmd_led},
 	{"lightbar", cmd_lightbar},
 	{"keyconfig", cmd_keyconfig},
@@ -0,0 +1,18 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Build the EC's SHA-256 implementation for host tools, so they can check
+ * digests computed by the EC.
+ */
+
+#include <string.h>
+
+/*
+ * The EC's util.h declares its own string functions, with prototypes which
+ * conflict with the C library's.  SHA-256 only needs memcpy(), so keep
+ * util.h out and use the C library instead.
+ */
+#define __CROS_EC_UTIL_H
+
+#include "../common/sha256.c"